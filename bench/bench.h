@@ -0,0 +1,88 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+/*
+    minimal timing helpers for the rope benchmarks
+*/
+using bench_clock = std::chrono::steady_clock;
+
+template<typename F>
+double bench_ns(F &&run){
+    bench_clock::time_point start = bench_clock::now();
+    run();
+    bench_clock::time_point end = bench_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+/*
+    runs given function repeatedly, keeping the best time;
+        returns nanoseconds per operation
+*/
+template<typename F>
+double bench_best_ns(size_t repeats, size_t operations, F &&run){
+    double best = 0;
+    for(size_t r=0;r<repeats;r++){
+        double ns = bench_ns(run);
+        if(r == 0 || ns < best)
+            best = ns;
+    }
+    return operations > 0 ? best / operations : best;
+}
+
+struct BenchResult final{
+    std::string     name;
+    size_t          size;
+    double          value;
+    std::string     unit;
+};
+
+//every reported result, for bench_write_json
+inline std::vector<BenchResult> bench_results;
+
+inline void bench_report_value(const char *name, size_t size, double value, const char *unit){
+    printf("%-40s %12zu %12.2f %s\n", name, size, value, unit);
+    bench_results.push_back({name, size, value, unit});
+}
+
+inline void bench_report(const char *name, size_t size, double nsPerOp){
+    bench_report_value(name, size, nsPerOp, "ns/op");
+}
+
+/*
+    writes reported results as JSON, with given header fields;
+        one object per result so runs can be diffed between releases
+*/
+inline bool bench_write_json(const char *path, const std::vector<std::pair<std::string, size_t>> &header){
+    FILE *file = fopen(path, "w");
+    if(file == nullptr)
+        return false;
+    auto quoted = [](const std::string &text){
+        std::string out = "\"";
+        for(char c : text){
+            if(c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    };
+    fprintf(file, "{\n");
+    for(const auto &field : header)
+        fprintf(file, "  %s: %zu,\n", quoted(field.first).c_str(), field.second);
+    fprintf(file, "  \"results\": [\n");
+    for(size_t i=0;i<bench_results.size();i++){
+        const BenchResult &result = bench_results[i];
+        fprintf(file, "    {\"name\": %s, \"size\": %zu, \"value\": %.3f, \"unit\": %s}%s\n",
+                quoted(result.name).c_str(), result.size, result.value, quoted(result.unit).c_str(), i + 1 < bench_results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+#endif
@@ -0,0 +1,629 @@
+#include <rope.h>
+#include <brope.h>
+#include <prope.h>
+#include <utf8.h>
+#include <search.h>
+#include <termija.h>
+#include "bench.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+
+/*
+    builds balanced rope out of the given leaves
+*/
+std::unique_ptr<RopeNode> bench_build(std::vector<std::unique_ptr<RopeNode>> &leaves, size_t left, size_t right){
+    if(left == right)
+        return std::move(leaves[left]);
+    size_t mid = left + (right - left)/2;
+    return rope_concat(bench_build(leaves, left, mid), bench_build(leaves, mid+1, right));
+}
+
+std::unique_ptr<RopeNode> bench_rope_lines(size_t lines){
+    std::vector<std::unique_ptr<RopeNode>> leaves;
+    leaves.reserve(lines);
+    for(size_t i=0;i<lines;i++)
+        leaves.push_back(rope_create_node("some log line text", (i % 4 == 3) ? FLAG_NEW_LINE : 0));
+    return bench_build(leaves, 0, leaves.size()-1);
+}
+
+/*
+    node footprint
+*/
+void bench_node_size(){
+    printf("sizeof(RopeNode)  : %zu\n", sizeof(RopeNode));
+    printf("sizeof(RopeFlags) : %zu, inline\n\n", sizeof(RopeFlags));
+}
+
+/*
+    walks leaves checking the new line flag,
+        same access pattern as weight_until_next_new_line
+*/
+void bench_new_line_scan(size_t lines){
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    size_t found = 0;
+    double ns = bench_best_ns(5, lines, [&](){
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c;
+        found = 0;
+        while((c = litrope.pop()) != nullptr){
+            if(has_flags(&c->flags, FLAG_NEW_LINE))
+                found++;
+        }
+    });
+    bench_report("new line scan", lines, ns);
+    rope_destroy(std::move(rope));
+}
+
+/*
+    starts an iterator somewhere in the rope and walks a screen of leaves,
+        same pattern as drawing a text frame
+*/
+void bench_screen_walk(size_t lines){
+    const size_t screens = 10000, screen_leaves = 60;
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    size_t weight = rope_weight_total(*rope);
+    size_t sum = 0;
+    double ns = bench_best_ns(5, screens, [&](){
+        for(size_t i=0;i<screens;i++){
+            RopeLeafIterator litrope(rope.get(), (i * 7919) % weight);
+            RopeNode *c;
+            for(size_t l=0;l<screen_leaves && (c = litrope.pop()) != nullptr;l++)
+                sum += c->weight;
+        }
+    });
+    bench_report("leaf iterator screen walk", lines, ns);
+    rope_destroy(std::move(rope));
+}
+
+/*
+    whole rope to a string,
+        appending leaves against sizing once trough rope_copy_to
+*/
+void bench_copy_out(size_t lines){
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    size_t weight = rope_weight_total(*rope);
+    size_t sum = 0;
+    double ns = bench_best_ns(5, lines, [&](){
+        std::string text;
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr)
+            text += c->text.get();
+        sum += text.size();
+    });
+    bench_report("leaf append to string", lines, ns);
+    ns = bench_best_ns(5, lines, [&](){
+        std::string text;
+        rope_copy_to(*rope, 0, weight, text);
+        sum += text.size();
+    });
+    bench_report("rope_copy_to", lines, ns);
+    rope_destroy(std::move(rope));
+}
+
+/*
+    line to index and back for every line,
+        replaces the leaf walk above
+*/
+void bench_line_lookup(size_t lines){
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    size_t line_count = rope_line_count(*rope);
+    size_t sum = 0;
+    double ns = bench_best_ns(5, line_count, [&](){
+        for(size_t line=0;line<line_count;line++)
+            sum += rope_index_to_line(*rope, rope_line_to_index(*rope, line));
+    });
+    bench_report("rope_line_to_index/rope_index_to_line", lines, ns);
+    rope_destroy(std::move(rope));
+}
+
+std::unique_ptr<BRope> bench_brope_lines(size_t lines){
+    std::unique_ptr<BRope> rope = brope_create("");
+    for(size_t i=0;i<lines;i++)
+        rope_append(rope.get(), rope_create_node("some log line text", (i % 4 == 3) ? FLAG_NEW_LINE : 0));
+    return rope;
+}
+
+/*
+    index lookups spread over the whole rope and a full leaf walk,
+        binary rope against the B-tree rope
+*/
+void bench_binary_vs_btree(size_t lines){
+    const size_t lookups = 100000;
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    std::unique_ptr<BRope> brope = bench_brope_lines(lines);
+    size_t weight = rope_weight_total(*rope);
+    size_t local_index = 0, sum = 0;
+
+    double ns = bench_best_ns(5, lookups, [&](){
+        for(size_t i=0;i<lookups;i++)
+            sum += rope_node_at_index(*rope, (i * 7919) % weight, &local_index)->weight;
+    });
+    bench_report("binary rope_node_at_index", lines, ns);
+    ns = bench_best_ns(5, lookups, [&](){
+        for(size_t i=0;i<lookups;i++)
+            sum += rope_node_at_index(*brope, (i * 7919) % weight, &local_index)->weight;
+    });
+    bench_report("btree rope_node_at_index", lines, ns);
+
+    ns = bench_best_ns(5, lines, [&](){
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr)
+            sum += c->weight;
+    });
+    bench_report("binary leaf walk", lines, ns);
+    ns = bench_best_ns(5, lines, [&](){
+        BRopeLeafIterator litrope(brope.get());
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr)
+            sum += c->weight;
+    });
+    bench_report("btree leaf walk", lines, ns);
+
+    rope_destroy(std::move(rope));
+    rope_destroy(std::move(brope));
+}
+
+/*
+    every available UTF-8 kernel on mixed text,
+        scalar is the old byte at a time loop
+*/
+void bench_utf8_kernels(size_t bytes){
+    const char *pieces[] = {"some ", "čćž ", "漢字 ", "text "};
+    std::string text;
+    for(size_t i=0;text.size()<bytes;i++)
+        text += pieces[i % 4];
+    text.resize(bytes);
+    const size_t repeats = 1000000 / bytes + 1;
+    size_t sum = 0;
+    for(const UKernel &kernel : u_kernels_available()){
+        std::string name = std::string("u_count ") + kernel.name;
+        double ns = bench_best_ns(5, repeats, [&](){
+            for(size_t r=0;r<repeats;r++)
+                sum += kernel.count(text.c_str(), text.size() - (r & 1));
+        });
+        bench_report(name.c_str(), bytes, ns);
+        name = std::string("u_offset ") + kernel.name;
+        ns = bench_best_ns(5, repeats, [&](){
+            for(size_t r=0;r<repeats;r++)
+                sum += kernel.offset(text.c_str(), text.size(), bytes / 2 - (r & 1));
+        });
+        bench_report(name.c_str(), bytes, ns);
+    }
+    if(sum == 0)
+        printf("\n");
+}
+
+/*
+    builds a rope out of a log sized buffer,
+        ns per byte should stay flat as the buffer grows
+*/
+void bench_bulk_build(size_t bytes){
+    std::string text;
+    text.reserve(bytes);
+    for(size_t i=0;text.size()<bytes;i++)
+        text += (i % 16 == 0) ? "čćž log line " : "some log line text ";
+    text.resize(bytes);
+    size_t sum = 0;
+    double ns = bench_best_ns(3, bytes, [&](){
+        std::unique_ptr<RopeNode> rope = rope_build(text.c_str(), text.size(), 0);
+        sum += rope->weight;
+        rope_destroy(std::move(rope));
+    });
+    bench_report("rope_build per byte", bytes, ns);
+}
+
+/*
+    creates and destroys single leaf ropes
+*/
+void bench_create_destroy(size_t count){
+    double ns = bench_best_ns(5, count, [&](){
+        for(size_t i=0;i<count;i++){
+            std::unique_ptr<RopeNode> rope = rope_create("some log line text", FLAG_NEW_LINE);
+            rope_destroy(std::move(rope));
+        }
+    });
+    bench_report("rope_create/rope_destroy", count, ns);
+}
+
+/*
+    keeps every version while editing,
+        persistent edits against copying the mutable rope before each edit
+*/
+void bench_versions(size_t lines){
+    const size_t edits = 1000;
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    size_t weight = rope_weight_total(*rope);
+    std::string text;
+    rope_copy_to(*rope, 0, weight, text);
+    PRope base = prope_snapshot(*rope);
+    size_t sum = 0;
+    double ns = bench_best_ns(3, edits, [&](){
+        std::vector<PRope> versions = {base};
+        for(size_t i=0;i<edits;i++)
+            versions.push_back(rope_insert_at(versions.back(), (i * 7919) % weight, "typed"));
+        sum += versions.size();
+    });
+    bench_report("persistent edit, all versions kept", lines, ns);
+    ns = bench_best_ns(3, edits, [&](){
+        std::vector<std::unique_ptr<RopeNode>> versions;
+        for(size_t i=0;i<edits && i<100;i++){
+            versions.push_back(rope_build(text.c_str(), text.size(), 0));
+            rope_insert_at(versions.back().get(), (i * 7919) % weight, "typed");
+        }
+        for(auto &version : versions)
+            rope_destroy(std::move(version));
+    }) * edits / std::min<size_t>(edits, 100);
+    bench_report("copy and edit, all versions kept", lines, ns);
+    rope_destroy(std::move(rope));
+}
+
+/*
+    deletes a selection from the middle of a big rope,
+        in place against the split, split and append it replaced
+*/
+void bench_range_delete(size_t lines){
+    const size_t deletes = 500;
+    double ns_in_place = 0, ns_split = 0;
+    for(int in_place=0;in_place<2;in_place++){
+        std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+        std::unique_ptr<RopeNode> head = rope_concat(std::move(rope), std::unique_ptr<RopeNode>());
+        double ns = bench_best_ns(1, deletes, [&](){
+            for(size_t i=0;i<deletes;i++){
+                size_t weight = head->weight;
+                size_t index = (i * 7919) % (weight / 2), length = 100;
+                if(in_place){
+                    rope_delete_at(head.get(), index, length);
+                }else{
+                    std::unique_ptr<RopeNode> deleted = rope_split_at(head.get(), index);
+                    std::unique_ptr<RopeNode> right_side = rope_split_at(deleted.get(), length-1);
+                    if(right_side != nullptr)
+                        rope_append(head.get(), std::move(right_side));
+                    rope_destroy(std::move(deleted));
+                }
+            }
+        });
+        (in_place ? ns_in_place : ns_split) = ns;
+        rope_destroy(std::move(head));
+    }
+    bench_report("range delete, split and append", lines, ns_split);
+    bench_report("range delete, in place", lines, ns_in_place);
+}
+
+/*
+    rope typed a character at a time,
+        leaf walk before and after compacting it
+*/
+void bench_compact(size_t chars){
+    std::unique_ptr<RopeNode> rope = rope_create("");
+    for(size_t i=0;i<chars;i++)
+        rope_append(rope.get(), rope_create_node("x", (i % 80 == 79) ? FLAG_NEW_LINE : 0));
+    size_t sum = 0;
+    auto walk = [&](){
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr)
+            sum += c->weight;
+    };
+    bench_report("leaf walk, a leaf per keystroke", chars, bench_best_ns(5, chars, walk));
+    size_t removed = 0;
+    double ns = bench_ns([&](){ removed = rope_compact(rope.get()); });
+    bench_report("rope_compact", chars, ns / chars);
+    bench_report("leaf walk, compacted", chars, bench_best_ns(5, chars, walk));
+    printf("%-40s %12zu leaves removed\n", "", removed);
+    rope_destroy(std::move(rope));
+}
+
+
+/*
+    every match of a word near the end of each line,
+        in place against copying the text out and searching the string
+*/
+void bench_find(size_t lines){
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    size_t weight = rope_weight_total(*rope);
+    size_t found = 0;
+    double ns = bench_best_ns(3, lines, [&](){
+        std::string text;
+        rope_copy_to(*rope, 0, weight, text);
+        for(size_t p = text.find("line text");p != std::string::npos;p = text.find("line text", p + 9))
+            found++;
+    });
+    bench_report("copy out and std::string::find", lines, ns);
+    ns = bench_best_ns(3, lines, [&](){
+        found += rope_find_all(*rope, "line text").size();
+    });
+    bench_report("rope_find_all", lines, ns);
+    //same text in full leaves, as opened files are
+    std::string text;
+    rope_copy_to(*rope, 0, weight, text);
+    rope_destroy(std::move(rope));
+    rope = rope_build(text.data(), text.size(), 0);
+    ns = bench_best_ns(3, lines, [&](){
+        found += rope_find_all(*rope, "line text").size();
+    });
+    bench_report("rope_find_all, built leaves", lines, ns);
+    rope_destroy(std::move(rope));
+}
+
+/*
+    a stats sample over the whole rope, per leaf
+*/
+void bench_stats(size_t lines){
+    std::unique_ptr<RopeNode> rope = bench_rope_lines(lines);
+    size_t sum = 0;
+    double ns = bench_best_ns(5, lines, [&](){
+        sum += rope_stats(*rope).nodes;
+    });
+    bench_report("rope_stats per leaf", lines, ns);
+    rope_destroy(std::move(rope));
+}
+
+void bench_all(){
+    bench_node_size();
+    for(size_t lines : {1000, 100000, 1000000})
+        bench_new_line_scan(lines);
+    for(size_t lines : {1000, 100000, 1000000})
+        bench_screen_walk(lines);
+    for(size_t lines : {1000, 100000, 1000000})
+        bench_line_lookup(lines);
+    for(size_t lines : {1000, 100000, 1000000})
+        bench_copy_out(lines);
+    for(size_t lines : {1000, 100000, 1000000})
+        bench_binary_vs_btree(lines);
+    for(size_t bytes : {16, 512, 4096})
+        bench_utf8_kernels(bytes);
+    for(size_t bytes : {1000000, 10000000, 100000000})
+        bench_bulk_build(bytes);
+    bench_create_destroy(100000);
+    for(size_t lines : {1000, 100000})
+        bench_versions(lines);
+    for(size_t lines : {10000, 1000000})
+        bench_range_delete(lines);
+    bench_compact(1000000);
+    for(size_t lines : {1000, 1000000})
+        bench_find(lines);
+    for(size_t lines : {1000, 1000000})
+        bench_stats(lines);
+}
+
+/*
+    sized suite, the same operations from 1 KB to 1 GB of text;
+        text and positions come from a fixed seed, so runs are comparable between releases
+*/
+inline const uint32_t       BENCH_SEED          = 20;
+inline const size_t         BENCH_SUITE_EDITS   = 10000;
+
+/*
+    log like text, lines of 10 to 120 bytes, every eighth one with 2 byte codepoints
+*/
+std::string bench_suite_text(size_t bytes, std::mt19937 &random){
+    std::string text;
+    text.reserve(bytes);
+    const char *words[] = {"some", "log", "line", "text", "disk", "error", "čćž", "42"};
+    while(text.size() < bytes){
+        size_t length = 10 + random() % 111;
+        bool wide = random() % 8 == 0;
+        for(size_t start=text.size();text.size() - start < length;){
+            text += words[random() % (wide ? 8 : 6)];
+            text += ' ';
+        }
+        text.back() = '\n';
+    }
+    //cut on a codepoint start
+    while(text.size() > bytes && (text[bytes] & 0xC0) == 0x80)
+        bytes--;
+    text.resize(bytes);
+    return text;
+}
+
+std::vector<size_t> bench_suite_indices(size_t count, size_t weight, std::mt19937 &random){
+    std::vector<size_t> indices(count);
+    for(size_t &index : indices)
+        index = weight > 0 ? random() % weight : 0;
+    return indices;
+}
+
+/*
+    rope head over the built text, as TextBox keeps it
+*/
+std::unique_ptr<RopeNode> bench_suite_rope(const std::string &text){
+    return rope_create(text.c_str());
+}
+
+void bench_suite(size_t bytes){
+    std::mt19937 random(BENCH_SEED + bytes);
+    const size_t repeats = bytes >= (64u << 20) ? 1 : 3;
+    const std::string text = bench_suite_text(bytes, random);
+    std::unique_ptr<RopeNode> rope = bench_suite_rope(text);
+    const size_t weight = rope_weight_total(*rope);
+    size_t sum = 0;
+
+    //memory next to the text, what the leaf capacity trades against speed
+    RopeStats stats = rope_stats(*rope);
+    bench_report_value("suite overhead per text byte", bytes, (double)stats.overheadBytes / std::max<size_t>(1, stats.textBytes), "bytes");
+    bench_report_value("suite leaves", bytes, (double)stats.leaves, "leaves");
+
+    //rope_create, per byte
+    bench_report("suite rope_create per byte", bytes, bench_best_ns(repeats, text.size(), [&](){
+        std::unique_ptr<RopeNode> built = bench_suite_rope(text);
+        sum += built->weight;
+        rope_destroy(std::move(built));
+    }));
+
+    //full leaf walk, per byte
+    bench_report("suite leaf iteration per byte", bytes, bench_best_ns(repeats, text.size(), [&](){
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr)
+            sum += c->weight;
+    }));
+
+    //line starts and ends around random indices, as cursor movement asks for them
+    std::vector<size_t> indices = bench_suite_indices(BENCH_SUITE_EDITS, weight, random);
+    bench_report("suite weight_until_next/prev_new_line", bytes, bench_best_ns(repeats, indices.size(), [&](){
+        for(size_t index : indices)
+            sum += termija::weight_until_next_new_line(rope.get(), index) + termija::weight_until_prev_new_line(rope.get(), index);
+    }));
+
+    //edits, each repeat on a fresh rope so every run sees the same tree
+    auto edit = [&](const char *name, size_t count, auto &&run){
+        double best = 0;
+        for(size_t r=0;r<repeats;r++){
+            std::unique_ptr<RopeNode> edited = bench_suite_rope(text);
+            double ns = bench_ns([&](){ run(edited.get()); }) / count;
+            if(r == 0 || ns < best)
+                best = ns;
+            rope_destroy(std::move(edited));
+        }
+        bench_report(name, bytes, best);
+    };
+    edit("suite rope_insert_at random", indices.size(), [&](RopeNode *edited){
+        for(size_t index : indices)
+            rope_insert_at(edited, index, "typed");
+    });
+    size_t typed = indices.front();
+    edit("suite rope_insert_at sequential", indices.size(), [&](RopeNode *edited){
+        for(size_t i=0;i<indices.size();i++)
+            rope_insert_at(edited, typed + i, "x");
+    });
+    //deletes never reach the rope end, rope_delete_at rejects those
+    std::vector<size_t> deletes = bench_suite_indices(std::min(BENCH_SUITE_EDITS, weight / 16), weight / 2, random);
+    if(!deletes.empty())
+        edit("suite rope_delete_at", deletes.size(), [&](RopeNode *edited){
+            for(size_t index : deletes)
+                rope_delete_at(edited, index, 8);
+        });
+    //split in two and join back
+    std::vector<size_t> splits = bench_suite_indices(std::min<size_t>(1000, weight), weight, random);
+    edit("suite rope_split_at and append", splits.size(), [&](RopeNode *edited){
+        for(size_t index : splits){
+            std::unique_ptr<RopeNode> right_side = rope_split_at(edited, index);
+            if(right_side != nullptr)
+                rope_append(edited, std::move(right_side));
+        }
+    });
+
+    //rope_rebalance, per leaf
+    size_t leaves = 0;
+    {
+        RopeLeafIterator litrope(rope.get());
+        while(litrope.pop() != nullptr)
+            leaves++;
+    }
+    bench_report("suite rope_rebalance per leaf", bytes, bench_best_ns(repeats, leaves, [&](){
+        rope = rope_rebalance(std::move(rope));
+    }));
+
+    rope_destroy(std::move(rope));
+    if(sum == 0)
+        printf("\n");
+}
+
+/*
+    bulk build, file mapping and rebalance of the suite text, from 1 to every hardware thread;
+        the tree is the same whatever the thread count, only the time should change
+*/
+void bench_scaling(size_t bytes){
+    std::mt19937 random(BENCH_SEED + bytes);
+    const std::string text = bench_suite_text(bytes, random);
+    const char *path = "rope_bench_scaling.txt";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+    const size_t hardware = std::max<size_t>(1, std::thread::hardware_concurrency());
+    std::vector<size_t> counts;
+    for(size_t threads=1;threads<hardware;threads*=2)
+        counts.push_back(threads);
+    counts.push_back(hardware);
+
+    size_t sum = 0, leaves = 0;
+    double serial[3] = {};
+    for(size_t threads : counts){
+        rope_build_threads_set(threads);
+        const std::string suffix = ", threads " + std::to_string(threads);
+        double ns[3];
+        ns[0] = bench_best_ns(3, text.size(), [&](){
+            std::unique_ptr<RopeNode> built = rope_build(text.data(), text.size(), 0);
+            sum += built->weight;
+            rope_destroy(std::move(built));
+        });
+        ns[1] = bench_best_ns(3, text.size(), [&](){
+            std::unique_ptr<RopeNode> mapped = rope_map_file(path);
+            sum += mapped->weight;
+            rope_destroy(std::move(mapped));
+        });
+        std::unique_ptr<RopeNode> rope = rope_build(text.data(), text.size(), 0);
+        if(leaves == 0){
+            RopeLeafIterator litrope(rope.get());
+            while(litrope.pop() != nullptr)
+                leaves++;
+        }
+        ns[2] = bench_best_ns(3, leaves, [&](){
+            rope = rope_rebalance(std::move(rope));
+        });
+        rope_destroy(std::move(rope));
+
+        const char *names[3] = {"scaling rope_build per byte", "scaling rope_map_file per byte", "scaling rope_rebalance per leaf"};
+        for(size_t i=0;i<3;i++){
+            if(threads == 1)
+                serial[i] = ns[i];
+            bench_report((names[i] + suffix).c_str(), bytes, ns[i]);
+            bench_report_value((names[i] + suffix + ", speedup").c_str(), bytes, serial[i] / ns[i], "x");
+        }
+    }
+    rope_build_threads_set(0);
+    std::remove(path);
+    if(sum == 0)
+        printf("\n");
+}
+
+/*
+    bench [--suite | --scaling] [--max-size bytes] [--json path]
+        no arguments runs the exploratory benchmarks above, --suite the sized one,
+            --scaling bulk builds over thread counts, on 512 MB unless --max-size is smaller
+*/
+int main(int argc, char **argv){
+    bool suite = false, scaling = false;
+    size_t max_size = 1u << 30;
+    const char *json = nullptr;
+    for(int i=1;i<argc;i++){
+        if(strcmp(argv[i], "--suite") == 0)
+            suite = true;
+        else if(strcmp(argv[i], "--scaling") == 0)
+            scaling = true;
+        else if(strcmp(argv[i], "--max-size") == 0 && i + 1 < argc)
+            max_size = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json = argv[++i];
+        else{
+            fprintf(stderr, "usage: %s [--suite | --scaling] [--max-size bytes] [--json path]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(suite){
+        for(size_t bytes : {1u << 10, 1u << 15, 1u << 20, 1u << 25, 1u << 30})
+            if(bytes <= max_size)
+                bench_suite(bytes);
+    }else if(scaling)
+        bench_scaling(std::min<size_t>(max_size, 512u << 20));
+    else
+        bench_all();
+    if(json != nullptr && !bench_write_json(json, {{"seed", BENCH_SEED}, {"node_size", sizeof(RopeNode)}, {"max_weight", MAX_WEIGHT},
+                                                    {"hardware_threads", std::thread::hardware_concurrency()}})){
+        fprintf(stderr, "couldn't write %s\n", json);
+        return 1;
+    }
+    return 0;
+}
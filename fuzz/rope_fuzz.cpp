@@ -0,0 +1,443 @@
+#include <rope.h>
+#include <utf8.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <fstream>
+#include <iterator>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+
+/*
+    differential fuzzing of rope edits;
+    input bytes are decoded to a sequence of operations applied to two ropes, a and b,
+    and to two shadows, plain strings with a flag byte per codepoint.
+    After every operation both ropes are checked against their shadows:
+        text, weight, lines and height of every node, leaf caches, flags per codepoint.
+    Built with libFuzzer when TERMIJA_LIBFUZZER is defined, otherwise as a standalone driver
+    replaying files or running seeded random inputs.
+*/
+inline const size_t             FUZZ_MAX_CODEPOINTS = 8192;//shadows stay small, checks are linear
+
+//shadow flag bits, per codepoint
+inline const uint8_t            SHADOW_INVERT       = 1;
+inline const uint8_t            SHADOW_LINE_END     = 2;//a leaf with FLAG_NEW_LINE ends here
+
+enum FuzzOp : uint8_t{
+    FUZZ_CREATE,
+    FUZZ_INSERT,
+    FUZZ_DELETE,
+    FUZZ_SPLIT,
+    FUZZ_APPEND,
+    FUZZ_PREPEND,
+    FUZZ_REBALANCE,
+    FUZZ_FLAG,
+    FUZZ_COMPACT,
+    FUZZ_SWAP,
+    FUZZ_CREATE_NODE,
+    FUZZ_OP_COUNT
+};
+
+struct FuzzShadow final{
+    std::string                                 text;
+    std::vector<uint8_t>                        flags;//one per codepoint
+};
+
+struct FuzzInput final{
+    const uint8_t                               *data;
+    size_t                                      size;
+    size_t                                      at;
+};
+
+struct FuzzState final{
+    std::unique_ptr<RopeNode>                   rope[2];
+    FuzzShadow                                  shadow[2];
+    std::string                                 log;//operations so far, printed on failure
+};
+
+
+uint8_t                         _fuzz_byte(FuzzInput*);
+size_t                          _fuzz_number(FuzzInput*, size_t);
+std::string                     _fuzz_text(FuzzInput*);
+size_t                          _shadow_offset(const FuzzShadow&, size_t);
+void                            _shadow_insert(FuzzShadow*, size_t, const std::string&, uint8_t);
+void                            _shadow_erase(FuzzShadow*, size_t, size_t);
+FuzzShadow                      _shadow_split(FuzzShadow*, size_t);
+void                            _fuzz_apply(FuzzState*, FuzzInput*);
+void                            _fuzz_check(const FuzzState&, size_t);
+void                            _fuzz_check_node(const FuzzState&, const FuzzShadow&, const RopeNode&, size_t*, size_t*, uint8_t*);
+void                            _fuzz_fail(const FuzzState&, const char*);
+
+
+/*
+    runs one input, aborts on the first mismatch
+*/
+void rope_fuzz_run(const uint8_t *data, size_t size){
+    FuzzInput input = {data, size, 0};
+    FuzzState state;
+    state.rope[0] = rope_create("");
+    state.rope[1] = rope_create("");
+    _fuzz_check(state, 0);
+    _fuzz_check(state, 1);
+    while(input.at < input.size)
+        _fuzz_apply(&state, &input);
+    rope_destroy(std::move(state.rope[0]));
+    rope_destroy(std::move(state.rope[1]));
+}
+
+
+/*
+    next input byte, zero past the end
+*/
+uint8_t _fuzz_byte(FuzzInput *input){
+    return input->at < input->size ? input->data[input->at++] : 0;
+}
+
+/*
+    number in [0, bound), two bytes of input, 0 for an empty bound
+*/
+size_t _fuzz_number(FuzzInput *input, size_t bound){
+    size_t value = _fuzz_byte(input);
+    value = (value << 8) | _fuzz_byte(input);
+    return bound > 0 ? value % bound : 0;
+}
+
+/*
+    short texts come byte by byte, long ones from a seeded generator;
+        ASCII, two, three and four byte codepoints, and '\n' which is plain text to the rope
+*/
+std::string _fuzz_text(FuzzInput *input){
+    static const char *alphabet[] = {"a", "b", "c", " ", "č", "ž", "字", "😀", "\n"};
+    const size_t letters = sizeof(alphabet) / sizeof(alphabet[0]);
+    std::string text;
+    uint8_t head = _fuzz_byte(input);
+    if(head & 0x80){
+        std::minstd_rand random(_fuzz_byte(input));
+        size_t length = 1 + (head & 0x7F) * 12;//up to about three leaves
+        for(size_t i=0;i<length;i++)
+            text += alphabet[random() % letters];
+    }else{
+        for(size_t length = head % 8;length-- > 0;)
+            text += alphabet[_fuzz_byte(input) % letters];
+    }
+    return text;
+}
+
+/*
+    byte offset of the codepoint index in the shadow text
+*/
+size_t _shadow_offset(const FuzzShadow &shadow, size_t index){
+    return u_index_at(shadow.text.c_str(), index);
+}
+
+void _shadow_insert(FuzzShadow *shadow, size_t index, const std::string &text, uint8_t flags){
+    size_t weight = ustrlen(text);
+    shadow->text.insert(_shadow_offset(*shadow, index), text);
+    shadow->flags.insert(shadow->flags.begin() + index, weight, flags & SHADOW_INVERT);
+    //a new line is only after the last piece of a cut text
+    if(weight > 0 && (flags & SHADOW_LINE_END))
+        shadow->flags[index + weight - 1] |= SHADOW_LINE_END;
+}
+
+void _shadow_erase(FuzzShadow *shadow, size_t index, size_t length){
+    size_t begin = _shadow_offset(*shadow, index);
+    shadow->text.erase(begin, _shadow_offset(*shadow, index + length) - begin);
+    shadow->flags.erase(shadow->flags.begin() + index, shadow->flags.begin() + index + length);
+}
+
+/*
+    keeps [0, index) in the shadow, returns the rest
+*/
+FuzzShadow _shadow_split(FuzzShadow *shadow, size_t index){
+    FuzzShadow right;
+    size_t offset = _shadow_offset(*shadow, index);
+    right.text = shadow->text.substr(offset);
+    right.flags.assign(shadow->flags.begin() + index, shadow->flags.end());
+    shadow->text.resize(offset);
+    shadow->flags.resize(index);
+    return right;
+}
+
+
+/*
+    decodes and applies one operation to a rope and it's shadow, then checks both;
+        indices are mostly valid, rejected ones must leave the rope as it was
+*/
+void _fuzz_apply(FuzzState *state, FuzzInput *input){
+    uint8_t op = _fuzz_byte(input);
+    size_t s = (op >> 7) & 1;//rope the operation is on
+    std::unique_ptr<RopeNode> &rope = state->rope[s];
+    FuzzShadow &shadow = state->shadow[s];
+    std::unique_ptr<RopeNode> &other = state->rope[1-s];
+    FuzzShadow &other_shadow = state->shadow[1-s];
+    size_t weight = shadow.flags.size();
+    bool invalid = (_fuzz_byte(input) % 16) == 0;
+    std::string &log = state->log;
+    log += std::to_string(s) + ":";
+
+    switch((op & 0x7F) % FUZZ_OP_COUNT){
+    case FUZZ_CREATE:{
+        //empty lines are empty leaves ending a line, the shadow has no codepoint to mark, edits never make them
+        std::string text = _fuzz_text(input);
+        uint8_t flags = _fuzz_byte(input) & (text.empty() ? FLAG_INVERT : (FLAG_NEW_LINE | FLAG_INVERT));
+        rope_destroy(std::move(rope));
+        rope = rope_create(text.c_str(), flags);
+        shadow = FuzzShadow();
+        _shadow_insert(&shadow, 0, text, ((flags & FLAG_INVERT) ? SHADOW_INVERT : 0) | ((flags & FLAG_NEW_LINE) ? SHADOW_LINE_END : 0));
+        log += "create(" + std::to_string(ustrlen(text)) + ", " + std::to_string(flags) + ") ";
+        break;
+    }
+    case FUZZ_INSERT:{
+        //inserts after the codepoint at index, at 0 into an empty rope
+        size_t index = invalid ? weight + _fuzz_number(input, 4) : _fuzz_number(input, weight);
+        std::string text = _fuzz_text(input);
+        uint8_t flags = _fuzz_byte(input) & (FLAG_NEW_LINE | FLAG_INVERT);
+        if(weight + ustrlen(text) > FUZZ_MAX_CODEPOINTS)
+            break;
+        rope_insert_at(rope.get(), index, rope_create_node(text.c_str(), flags));
+        if(!text.empty() && (weight == 0 || index < weight))
+            _shadow_insert(&shadow, weight == 0 ? 0 : index + 1, text,
+                ((flags & FLAG_INVERT) ? SHADOW_INVERT : 0) | ((flags & FLAG_NEW_LINE) ? SHADOW_LINE_END : 0));
+        log += "insert(" + std::to_string(index) + ", " + std::to_string(ustrlen(text)) + ", " + std::to_string(flags) + ") ";
+        break;
+    }
+    case FUZZ_DELETE:{
+        //removes (index, index+length], deletes reaching the end are rejected
+        size_t index = _fuzz_number(input, weight);
+        size_t length = invalid ? weight - std::min(weight, index) : 1 + _fuzz_number(input, std::min<size_t>(weight, 1100));
+        rope_delete_at(rope.get(), index, length);
+        if(length > 0 && index + length < weight)
+            _shadow_erase(&shadow, index + 1, length);
+        log += "delete(" + std::to_string(index) + ", " + std::to_string(length) + ") ";
+        break;
+    }
+    case FUZZ_SPLIT:{
+        //rope keeps [0, index], the other rope gets the rest
+        size_t index = invalid ? weight + _fuzz_number(input, 4) : _fuzz_number(input, weight);
+        std::unique_ptr<RopeNode> right_side = rope_split_at(rope.get(), index);
+        if(index + 1 < weight){
+            if(right_side == nullptr)
+                _fuzz_fail(*state, "split returned nothing for a right side");
+            rope_destroy(std::move(other));
+            other = std::move(right_side);
+            other_shadow = _shadow_split(&shadow, index + 1);
+        }else if(right_side != nullptr)
+            _fuzz_fail(*state, "split returned a right side past the end");
+        log += "split(" + std::to_string(index) + ") ";
+        _fuzz_check(*state, 1-s);
+        break;
+    }
+    case FUZZ_APPEND:
+    case FUZZ_PREPEND:{
+        //moves the other rope in
+        bool append = (op & 0x7F) % FUZZ_OP_COUNT == FUZZ_APPEND;
+        if(weight + other_shadow.flags.size() > FUZZ_MAX_CODEPOINTS)
+            break;
+        //empty ones are rejected, the rope stays as it was
+        if(append){
+            rope_append(rope.get(), std::move(other));
+            shadow.text += other_shadow.text;
+            shadow.flags.insert(shadow.flags.end(), other_shadow.flags.begin(), other_shadow.flags.end());
+        }else{
+            rope_prepend(rope.get(), std::move(other));
+            shadow.text.insert(0, other_shadow.text);
+            shadow.flags.insert(shadow.flags.begin(), other_shadow.flags.begin(), other_shadow.flags.end());
+        }
+        other = rope_create("");
+        other_shadow = FuzzShadow();
+        log += append ? "append " : "prepend ";
+        _fuzz_check(*state, 1-s);
+        break;
+    }
+    case FUZZ_REBALANCE:
+        rope = rope_rebalance(std::move(rope));
+        log += "rebalance ";
+        break;
+    case FUZZ_FLAG:{
+        //sets [index, index+length) inverted, leaves there lose their new lines
+        size_t index = _fuzz_number(input, weight);
+        size_t length = invalid ? weight + 1 - index : 1 + _fuzz_number(input, weight - index);
+        rope_insert_flag_at(rope.get(), index, length, FLAG_INVERT);
+        if(length > 0 && index + length <= weight)
+            for(size_t i=index;i<index+length;i++)
+                shadow.flags[i] = SHADOW_INVERT;
+        log += "flag(" + std::to_string(index) + ", " + std::to_string(length) + ") ";
+        break;
+    }
+    case FUZZ_COMPACT:{
+        size_t begin = _fuzz_number(input, weight + 1);
+        size_t end = begin + _fuzz_number(input, weight - begin + 1);
+        rope_compact(rope.get(), begin, end);
+        log += "compact(" + std::to_string(begin) + ", " + std::to_string(end) + ") ";
+        break;
+    }
+    case FUZZ_CREATE_NODE:{
+        //bare leaf used as the head, longer text would make a subtree without one
+        std::string text = _fuzz_text(input);
+        text.resize(u_index_at(text.c_str(), MAX_WEIGHT));
+        uint8_t flags = _fuzz_byte(input) & (text.empty() ? FLAG_INVERT : (FLAG_NEW_LINE | FLAG_INVERT));
+        rope_destroy(std::move(rope));
+        rope = rope_create_node(text.c_str(), flags);
+        shadow = FuzzShadow();
+        _shadow_insert(&shadow, 0, text, ((flags & FLAG_INVERT) ? SHADOW_INVERT : 0) | ((flags & FLAG_NEW_LINE) ? SHADOW_LINE_END : 0));
+        log += "create_node(" + std::to_string(ustrlen(text)) + ", " + std::to_string(flags) + ") ";
+        break;
+    }
+    case FUZZ_SWAP:
+        rope.swap(other);
+        std::swap(shadow, other_shadow);
+        log += "swap ";
+        _fuzz_check(*state, 1-s);
+        break;
+    }
+    _fuzz_check(*state, s);
+}
+
+
+/*
+    compares the rope to it's shadow and checks every node
+*/
+void _fuzz_check(const FuzzState &state, size_t s){
+    const RopeNode *rope = state.rope[s].get();
+    const FuzzShadow &shadow = state.shadow[s];
+    if(rope == nullptr)
+        _fuzz_fail(state, "rope is NULL");
+    size_t weight = shadow.flags.size();
+    if(rope_weight_total(*rope) != weight)
+        _fuzz_fail(state, "rope_weight_total differs from the shadow");
+    if(rope_weight_measure(*rope) != weight)
+        _fuzz_fail(state, "rope_weight_measure differs from the shadow");
+    std::string text;
+    rope_copy_to(*const_cast<RopeNode*>(rope), 0, weight, text);
+    if(text != shadow.text)
+        _fuzz_fail(state, "text differs from the shadow");
+
+    //node invariants, flags by codepoint
+    size_t index = 0, lines = 0;
+    uint8_t height = 0;
+    _fuzz_check_node(state, shadow, *rope, &index, &lines, &height);
+    if(index != weight)
+        _fuzz_fail(state, "leaves don't add up to the weight");
+    size_t line_ends = 0;
+    for(uint8_t flags : shadow.flags)
+        line_ends += (flags & SHADOW_LINE_END) ? 1 : 0;
+    if(rope_line_count(*rope) != line_ends || lines != line_ends)
+        _fuzz_fail(state, "line count differs from the shadow");
+}
+
+/*
+    walks the subtree in order, checking weight, lines, height and balance of every node against it's children,
+        and leaf text, caches and flags against the shadow;
+            index is the codepoint index of the subtree start, lines and height are returned
+*/
+void _fuzz_check_node(const FuzzState &state, const FuzzShadow &shadow, const RopeNode &node, size_t *index, size_t *lines, uint8_t *height){
+    if(node.left == nullptr && node.right == nullptr){
+        bool new_line = (node.flags.effects & RopeEffects(FLAG_NEW_LINE)).any();
+        bool invert = (node.flags.effects & RopeEffects(FLAG_INVERT)).any();
+        *lines = new_line ? 1 : 0;
+        *height = 0;
+        if(node.text == nullptr || node.weight == 0){
+            if(node.weight != 0)
+                _fuzz_fail(state, "leaf without text has weight");
+            if(new_line)
+                _fuzz_fail(state, "empty leaf ends a line");
+            return;
+        }
+        if(node.weight != u_count(node.text.get(), node.bytes))
+            _fuzz_fail(state, "leaf weight differs from it's text");
+        if(node.ascii != (node.weight == node.bytes))
+            _fuzz_fail(state, "leaf ascii bit is stale");
+        if(!node.mapped && node.text[node.bytes] != 0)
+            _fuzz_fail(state, "leaf text isn't NUL terminated");
+        if(node.text.get() == node.inlineText + 1 && node.bytes + 2 > RopePolicy::inlineText)
+            _fuzz_fail(state, "inline leaf text runs past the node");
+        if(*index + node.weight > shadow.flags.size())
+            _fuzz_fail(state, "leaves run past the shadow");
+        for(size_t i=0;i<node.weight;i++){
+            uint8_t flags = shadow.flags[*index + i];
+            if(((flags & SHADOW_INVERT) != 0) != invert)
+                _fuzz_fail(state, "invert flag differs from the shadow");
+            if(((flags & SHADOW_LINE_END) != 0) != (new_line && i + 1 == node.weight))
+                _fuzz_fail(state, "line end differs from the shadow");
+        }
+        *index += node.weight;
+        return;
+    }
+    size_t left_lines = 0, right_lines = 0;
+    uint8_t left_height = 0, right_height = 0;
+    size_t start = *index;
+    if(node.left != nullptr)
+        _fuzz_check_node(state, shadow, *node.left, index, &left_lines, &left_height);
+    if(node.weight != *index - start)
+        _fuzz_fail(state, "node weight isn't it's left subtree weight");
+    if(node.lines != left_lines)
+        _fuzz_fail(state, "node lines aren't it's left subtree lines");
+    if(node.right != nullptr)
+        _fuzz_check_node(state, shadow, *node.right, index, &right_lines, &right_height);
+    *lines = left_lines + right_lines;
+    *height = 1 + std::max(node.left != nullptr ? left_height : 0, node.right != nullptr ? right_height : 0);
+    if(node.height != *height)
+        _fuzz_fail(state, "node height is stale");
+    //the head only has a left side, every node under it is AVL balanced
+    int left_levels = node.left != nullptr ? 1 + left_height : 0;
+    int right_levels = node.right != nullptr ? 1 + right_height : 0;
+    if(&node != state.rope[0].get() && &node != state.rope[1].get() && std::abs(left_levels - right_levels) > 1)
+        _fuzz_fail(state, "node isn't balanced");
+}
+
+void _fuzz_fail(const FuzzState &state, const char *message){
+    fprintf(stderr, "rope fuzz: %s\noperations: %s\n", message, state.log.c_str());
+    abort();
+}
+
+
+#ifdef TERMIJA_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size){
+    rope_fuzz_run(data, size);
+    return 0;
+}
+#else
+/*
+    rope_fuzz [file...] replays inputs,
+    rope_fuzz -n iterations [-s seed] runs random ones
+*/
+int main(int argc, char **argv){
+    size_t iterations = 10000;
+    uint32_t seed = 1;
+    std::vector<const char*> files;
+    for(int i=1;i<argc;i++){
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            iterations = strtoull(argv[++i], nullptr, 10);
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else
+            files.push_back(argv[i]);
+    }
+    for(const char *path : files){
+        std::ifstream file(path, std::ios::binary);
+        if(!file){
+            fprintf(stderr, "can't open %s\n", path);
+            return 1;
+        }
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        rope_fuzz_run((const uint8_t*)data.data(), data.size());
+    }
+    if(!files.empty())
+        return 0;
+    std::mt19937 random(seed);
+    std::vector<uint8_t> data;
+    for(size_t i=0;i<iterations;i++){
+        data.resize(random() % 4096);
+        for(uint8_t &byte : data)
+            byte = (uint8_t)random();
+        rope_fuzz_run(data.data(), data.size());
+    }
+    printf("%zu inputs, seed %u, passed\n", iterations, seed);
+    return 0;
+}
+#endif
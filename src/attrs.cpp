@@ -0,0 +1,338 @@
+#include "attrs.h"
+#include <plog/Log.h>
+
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+std::unique_ptr<RopeAttrsNode>                  _attrs_node(RopeAttrs*, size_t, uint8_t);
+size_t                                          _attrs_total(const std::unique_ptr<RopeAttrsNode>&);
+void                                            _attrs_update(RopeAttrsNode*);
+void                                            _attrs_apply(RopeAttrsNode*, uint8_t, uint8_t);
+void                                            _attrs_push(RopeAttrsNode*);
+void                                            _attrs_split(std::unique_ptr<RopeAttrsNode>, size_t, std::unique_ptr<RopeAttrsNode>&, std::unique_ptr<RopeAttrsNode>&);
+std::unique_ptr<RopeAttrsNode>                  _attrs_merge(std::unique_ptr<RopeAttrsNode>, std::unique_ptr<RopeAttrsNode>);
+RopeAttrsNode*                                  _attrs_edge(RopeAttrsNode*, bool);
+void                                            _attrs_fuse(RopeAttrs*, size_t);
+void                                            _attrs_mark(RopeAttrs*, size_t, size_t, uint8_t, uint8_t);
+
+
+RopeAttrsNode::RopeAttrsNode()
+: length{0}, total{0}, attrs{0}, set{0}, clear{0}, all{0}, any{0}, priority{0}
+{}
+
+RopeAttrs::RopeAttrs()
+: seed{0x9e3779b9}
+{}
+
+
+/*
+    a single run of the given length without attributes
+*/
+void attrs_reset(RopeAttrs *attrs, size_t length){
+    if(attrs == nullptr){
+        PLOG_ERROR << "given attrs are NULL, aborted.";
+        return;
+    }
+    attrs->root.reset();
+    if(length > 0)
+        attrs->root = _attrs_node(attrs, length, 0);
+}
+
+/*
+    text was inserted at index, it gets no attributes
+*/
+void attrs_text_inserted(RopeAttrs *attrs, size_t index, size_t length){
+    if(attrs == nullptr || length == 0){
+        PLOG_ERROR << "given attrs are NULL or length is 0, aborted.";
+        return;
+    }
+    if(index > attrs_length(*attrs)){
+        PLOG_ERROR << "index bigger than length, aborted. index : " << index;
+        return;
+    }
+    std::unique_ptr<RopeAttrsNode> left, right;
+    _attrs_split(std::move(attrs->root), index, left, right);
+    attrs->root = _attrs_merge(_attrs_merge(std::move(left), _attrs_node(attrs, length, 0)), std::move(right));
+    _attrs_fuse(attrs, index);
+    _attrs_fuse(attrs, index + length);
+}
+
+/*
+    text [index, index+length) was deleted, runs over it go with it
+*/
+void attrs_text_deleted(RopeAttrs *attrs, size_t index, size_t length){
+    if(attrs == nullptr || length == 0){
+        PLOG_ERROR << "given attrs are NULL or length is 0, aborted.";
+        return;
+    }
+    if(index + length > attrs_length(*attrs)){
+        PLOG_ERROR << "invalid index/length combination, aborted. index : " << index << " length: " << length;
+        return;
+    }
+    std::unique_ptr<RopeAttrsNode> left, middle, right, rest;
+    _attrs_split(std::move(attrs->root), index, left, rest);
+    _attrs_split(std::move(rest), length, middle, right);
+    attrs->root = _attrs_merge(std::move(left), std::move(right));
+    _attrs_fuse(attrs, index);
+}
+
+/*
+    adds attribute bits to [index, index+length)
+*/
+void attrs_add(RopeAttrs *attrs, size_t index, size_t length, uint8_t bits){
+    _attrs_mark(attrs, index, length, bits, 0);
+}
+
+/*
+    removes attribute bits from [index, index+length)
+*/
+void attrs_remove(RopeAttrs *attrs, size_t index, size_t length, uint8_t bits){
+    _attrs_mark(attrs, index, length, 0, bits);
+}
+
+/*
+    attributes at index, run_end is set to the end of the run holding it;
+        pending masks on the way down are folded in without touching the tree
+*/
+uint8_t attrs_at(const RopeAttrs &attrs, size_t index, size_t *run_end){
+    const RopeAttrsNode *node = attrs.root.get();
+    //masks of the ancestors, the farther one applied last
+    uint8_t set = 0, clear = 0;
+    size_t start = 0;
+    while(node != nullptr){
+        size_t left_total = _attrs_total(node->left);
+        const RopeAttrsNode *child;
+        if(index < left_total){
+            child = node->left.get();
+        }else if(index < left_total + node->length){
+            if(run_end != nullptr)
+                *run_end = start + left_total + node->length;
+            return (node->attrs & ~clear) | set;
+        }else{
+            index -= left_total + node->length;
+            start += left_total + node->length;
+            child = node->right.get();
+        }
+        //child masks come before the node's
+        set = (node->set & ~clear) | set;
+        clear = node->clear | clear;
+        node = child;
+    }
+    if(run_end != nullptr)
+        *run_end = start + index + 1;
+    return 0;
+}
+
+size_t attrs_length(const RopeAttrs &attrs){
+    return _attrs_total(attrs.root);
+}
+
+/*
+    runs in the treap, for tests and stats
+*/
+size_t attrs_run_count(const RopeAttrs &attrs){
+    size_t count = 0;
+    std::vector<const RopeAttrsNode*> nodeStack;
+    if(attrs.root != nullptr)
+        nodeStack.push_back(attrs.root.get());
+    while(!nodeStack.empty()){
+        const RopeAttrsNode *node = nodeStack.back();
+        nodeStack.pop_back();
+        count++;
+        if(node->left != nullptr)
+            nodeStack.push_back(node->left.get());
+        if(node->right != nullptr)
+            nodeStack.push_back(node->right.get());
+    }
+    return count;
+}
+
+
+/*
+    new run, priorities from a xorshift so shapes are reproducible
+*/
+std::unique_ptr<RopeAttrsNode> _attrs_node(RopeAttrs *attrs, size_t length, uint8_t bits){
+    attrs->seed ^= attrs->seed << 13;
+    attrs->seed ^= attrs->seed >> 17;
+    attrs->seed ^= attrs->seed << 5;
+    std::unique_ptr<RopeAttrsNode> node = std::make_unique<RopeAttrsNode>();
+    node->length = node->total = length;
+    node->attrs = node->all = node->any = bits;
+    node->priority = attrs->seed;
+    return node;
+}
+
+/*
+    helper
+*/
+size_t _attrs_total(const std::unique_ptr<RopeAttrsNode> &node){
+    return node != nullptr ? node->total : 0;
+}
+
+/*
+    helper
+*/
+void _attrs_update(RopeAttrsNode *node){
+    node->total = node->length;
+    node->all = node->any = node->attrs;
+    for(const std::unique_ptr<RopeAttrsNode> *child : {&node->left, &node->right}){
+        if(*child == nullptr)
+            continue;
+        node->total += (*child)->total;
+        node->all &= (*child)->all;
+        node->any |= (*child)->any;
+    }
+}
+
+/*
+    applies masks to the node's run, and keeps them pending for it's children
+*/
+void _attrs_apply(RopeAttrsNode *node, uint8_t set, uint8_t clear){
+    node->attrs = (node->attrs & ~clear) | set;
+    node->all = (node->all & ~clear) | set;
+    node->any = (node->any & ~clear) | set;
+    node->set = (node->set & ~clear) | set;
+    node->clear |= clear;
+}
+
+/*
+    hands pending masks down to the children
+*/
+void _attrs_push(RopeAttrsNode *node){
+    if(node->set == 0 && node->clear == 0)
+        return;
+    if(node->left != nullptr)
+        _attrs_apply(node->left.get(), node->set, node->clear);
+    if(node->right != nullptr)
+        _attrs_apply(node->right.get(), node->set, node->clear);
+    node->set = node->clear = 0;
+}
+
+/*
+    first index codepoints to left, the rest to right;
+        a run holding the cut is cut in two
+*/
+void _attrs_split(std::unique_ptr<RopeAttrsNode> node, size_t index, std::unique_ptr<RopeAttrsNode> &left, std::unique_ptr<RopeAttrsNode> &right){
+    if(node == nullptr){
+        left.reset();
+        right.reset();
+        return;
+    }
+    _attrs_push(node.get());
+    size_t left_total = _attrs_total(node->left);
+    if(index <= left_total){
+        std::unique_ptr<RopeAttrsNode> inner;
+        _attrs_split(std::move(node->left), index, left, inner);
+        node->left = std::move(inner);
+        _attrs_update(node.get());
+        right = std::move(node);
+    }else if(index >= left_total + node->length){
+        std::unique_ptr<RopeAttrsNode> inner;
+        _attrs_split(std::move(node->right), index - left_total - node->length, inner, right);
+        node->right = std::move(inner);
+        _attrs_update(node.get());
+        left = std::move(node);
+    }else{
+        //cut inside the run, the right part keeps the node's place
+        size_t cut = index - left_total;
+        std::unique_ptr<RopeAttrsNode> part = std::make_unique<RopeAttrsNode>();
+        part->length = cut;
+        part->attrs = node->attrs;
+        part->priority = node->priority;
+        part->left = std::move(node->left);
+        _attrs_update(part.get());
+        node->length -= cut;
+        _attrs_update(node.get());
+        left = std::move(part);
+        right = std::move(node);
+    }
+}
+
+/*
+    every codepoint of left comes before right
+*/
+std::unique_ptr<RopeAttrsNode> _attrs_merge(std::unique_ptr<RopeAttrsNode> left, std::unique_ptr<RopeAttrsNode> right){
+    if(left == nullptr)
+        return right;
+    if(right == nullptr)
+        return left;
+    if(left->priority > right->priority){
+        _attrs_push(left.get());
+        left->right = _attrs_merge(std::move(left->right), std::move(right));
+        _attrs_update(left.get());
+        return left;
+    }
+    _attrs_push(right.get());
+    right->left = _attrs_merge(std::move(left), std::move(right->left));
+    _attrs_update(right.get());
+    return right;
+}
+
+/*
+    left-most or right-most run, pushing masks on the way
+*/
+RopeAttrsNode* _attrs_edge(RopeAttrsNode *node, bool rightmost){
+    while(true){
+        _attrs_push(node);
+        RopeAttrsNode *next = rightmost ? node->right.get() : node->left.get();
+        if(next == nullptr)
+            return node;
+        node = next;
+    }
+}
+
+/*
+    merges the runs meeting at index if they have the same attributes,
+        keeps edits from leaving a trail of split runs
+*/
+void _attrs_fuse(RopeAttrs *attrs, size_t index){
+    size_t length = attrs_length(*attrs);
+    if(index == 0 || index >= length)
+        return;
+    std::unique_ptr<RopeAttrsNode> left, right;
+    _attrs_split(std::move(attrs->root), index, left, right);
+    RopeAttrsNode *last = _attrs_edge(left.get(), true);
+    RopeAttrsNode *first = _attrs_edge(right.get(), false);
+    if(last->attrs == first->attrs){
+        //first run of the right side goes, the left side grows by it
+        size_t first_length = first->length;
+        std::unique_ptr<RopeAttrsNode> dropped, rest, before, tail;
+        _attrs_split(std::move(right), first_length, dropped, rest);
+        _attrs_split(std::move(left), index - last->length, before, tail);
+        tail->length += first_length;
+        _attrs_update(tail.get());
+        left = _attrs_merge(std::move(before), std::move(tail));
+        right = std::move(rest);
+    }
+    attrs->root = _attrs_merge(std::move(left), std::move(right));
+}
+
+/*
+    marks the range with set and clear masks, a pending mask on the subtree holding it;
+        a range left with the same bits everywhere is folded into one run
+*/
+void _attrs_mark(RopeAttrs *attrs, size_t index, size_t length, uint8_t set, uint8_t clear){
+    if(attrs == nullptr || length == 0){
+        PLOG_ERROR << "given attrs are NULL or length is 0, aborted.";
+        return;
+    }
+    if(index + length > attrs_length(*attrs)){
+        PLOG_ERROR << "invalid index/length combination, aborted. index : " << index << " length: " << length;
+        return;
+    }
+    std::unique_ptr<RopeAttrsNode> left, middle, right, rest;
+    _attrs_split(std::move(attrs->root), index, left, rest);
+    _attrs_split(std::move(rest), length, middle, right);
+    _attrs_apply(middle.get(), set, clear);
+    if(middle->all == middle->any && (middle->left != nullptr || middle->right != nullptr)){
+        //the range became a single run
+        uint8_t bits = middle->all;
+        middle = _attrs_node(attrs, length, bits);
+    }
+    attrs->root = _attrs_merge(_attrs_merge(std::move(left), std::move(middle)), std::move(right));
+    _attrs_fuse(attrs, index);
+    _attrs_fuse(attrs, index + length);
+}
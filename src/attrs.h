@@ -0,0 +1,58 @@
+#ifndef ATTRS_H
+#define ATTRS_H
+
+
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+
+/*
+    text attributes kept apart from the text;
+    runs of codepoints with the same attribute bits in a treap keyed by position,
+    a node knows only the length of it's run and subtree, so text edits shift every later run for free.
+    Adding or removing attributes over a range marks whole subtrees with pending set/clear masks,
+    both are O(log n) and never touch the text rope.
+    Attribute bits are the rope flags, drawing ors them with the leaf flags.
+*/
+struct RopeAttrsNode final{
+    std::size_t                                 length;//codepoints in the run
+    std::size_t                                 total;//codepoints in the subtree
+    std::uint8_t                                attrs;//of the run, pending masks of the node already applied
+    std::uint8_t                                set;//pending for the children, applied after clear
+    std::uint8_t                                clear;
+    std::uint8_t                                all;//bits every run in the subtree has
+    std::uint8_t                                any;//bits some run in the subtree has
+    std::uint32_t                               priority;
+
+    std::unique_ptr<RopeAttrsNode>              left;
+    std::unique_ptr<RopeAttrsNode>              right;
+
+    RopeAttrsNode();
+
+    RopeAttrsNode(const RopeAttrsNode&) = delete;
+    RopeAttrsNode& operator=(const RopeAttrsNode&) = delete;
+};
+
+struct RopeAttrs final{
+    std::unique_ptr<RopeAttrsNode>              root;
+    std::uint32_t                               seed;
+
+    RopeAttrs();
+
+    RopeAttrs(const RopeAttrs&) = delete;
+    RopeAttrs& operator=(const RopeAttrs&) = delete;
+};
+
+
+void                            attrs_reset(RopeAttrs*, size_t);
+void                            attrs_text_inserted(RopeAttrs*, size_t, size_t);
+void                            attrs_text_deleted(RopeAttrs*, size_t, size_t);
+void                            attrs_add(RopeAttrs*, size_t, size_t, uint8_t);
+void                            attrs_remove(RopeAttrs*, size_t, size_t, uint8_t);
+uint8_t                         attrs_at(const RopeAttrs&, size_t, size_t*);
+size_t                          attrs_length(const RopeAttrs&);
+size_t                          attrs_run_count(const RopeAttrs&);
+
+
+#endif
@@ -0,0 +1,792 @@
+#include "brope.h"
+#include <plog/Log.h>
+
+
+#include <memory>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <vector>
+
+
+size_t                                          _bleaf_lines(const RopeNode&);
+void                                            _bharvest(std::unique_ptr<RopeNode>, std::vector<std::unique_ptr<RopeNode>>&);
+size_t                                          _bnode_weight(const BRopeNode&);
+size_t                                          _bnode_lines(const BRopeNode&);
+void                                            _bentry_move(BRopeNode*, size_t, BRopeNode*, size_t);
+std::unique_ptr<BRopeNode>                      _bnode_insert(BRopeNode*, size_t, std::unique_ptr<BRopeNode>, std::unique_ptr<RopeNode>, size_t, size_t);
+void                                            _bnode_erase(BRopeNode*, size_t);
+void                                            _bbuild(BRope*, std::vector<std::unique_ptr<RopeNode>>&);
+void                                            _binsert_root(BRope*, size_t, std::unique_ptr<RopeNode>);
+void                                            _bboundary(BRope*, size_t);
+size_t                                          _bremove(BRopeNode*, size_t, size_t);
+void                                            _btake(BRopeNode*, size_t, std::vector<std::unique_ptr<RopeNode>>&);
+void                                            _bshrink(BRope*);
+size_t                                          _blines_measure_set(BRopeNode*);
+
+
+BRopeNode::BRopeNode()
+: count{0}, leaf_level{true}, weights{}, lines{}
+{}
+
+BRope::BRope()
+: weight{0}, lines{0}, height{1}
+{}
+
+
+BRopeLeafIterator::BRopeLeafIterator(BRope *rope, size_t start)
+: current{nullptr}, localStartIndex{0}
+{
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return;
+    }
+    if(start >= rope->weight){
+        if(rope->weight > 0)
+            PLOG_ERROR << "index bigger than weight, aborted. index : " << start;
+        return;
+    }
+    //find leaf at index
+    BRopeNode *node = rope->root.get();
+    while(true){
+        size_t i = 0;
+        while(i+1 < node->count && start >= node->weights[i]){
+            start -= node->weights[i];
+            i++;
+        }
+        path.push_back({node, i});
+        if(node->leaf_level)
+            break;
+        node = node->nodes[i].get();
+    }
+    localStartIndex = start;
+    current = path.back().first->leaves[path.back().second].get();
+}
+RopeNode* BRopeLeafIterator::next(){
+    //climb to the first level that has a next child
+    size_t level = path.size();
+    while(level > 0 && path[level-1].second + 1 >= path[level-1].first->count)
+        level--;
+    if(level == 0){
+        PLOG_WARNING << "there is no next element, aborted.";
+        return nullptr;
+    }
+    path[level-1].second++;
+    //and down to the left-most leaf
+    for(size_t l=level;l<path.size();l++)
+        path[l] = {path[l-1].first->nodes[path[l-1].second].get(), 0};
+    current = path.back().first->leaves[path.back().second].get();
+    return current;
+}
+bool BRopeLeafIterator::hasNext(){
+    for(const std::pair<BRopeNode*, size_t> &level : path){
+        if(level.second + 1 < level.first->count)
+            return true;
+    }
+    return false;
+}
+RopeNode* BRopeLeafIterator::pop(){
+    RopeNode *prev = current;
+    if(current == nullptr)
+        return nullptr;
+    //next leaf in the same array
+    std::pair<BRopeNode*, size_t> &leaf_level = path.back();
+    if(leaf_level.second + 1 < leaf_level.first->count){
+        leaf_level.second++;
+        current = leaf_level.first->leaves[leaf_level.second].get();
+    }else if(hasNext()){
+        next();
+    }else{
+        current = nullptr;
+    }
+    return prev;
+}
+size_t BRopeLeafIterator::local_start_index(){
+    return localStartIndex;
+}
+
+
+/*
+    creates rope with the given text
+*/
+std::unique_ptr<BRope> brope_create(const char *text){
+    return brope_create(text, 0);
+}
+
+/*
+    creates rope with the given text and flags
+*/
+std::unique_ptr<BRope> brope_create(const char *text, RopeEffects effects){
+    if(text == nullptr){
+        PLOG_ERROR << "given text is NULL, aborted.";
+        return nullptr;
+    }
+    std::unique_ptr<BRope> rope = std::make_unique<BRope>();
+    std::vector<std::unique_ptr<RopeNode>> leaves;
+    _bharvest(rope_create_node(text, effects), leaves);
+    _bbuild(rope.get(), leaves);
+    return rope;
+}
+
+/*
+    destroys the given rope, leaves go back to the pool
+*/
+void rope_destroy(std::unique_ptr<BRope> rope){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return;
+    }
+    rope.reset();
+}
+
+void rope_prepend(BRope *rope, const char *text){
+    rope_prepend(rope, rope_create_node(text));
+}
+/*
+    connects the given rope before the beggining;
+        consumes the ownership of the given rope
+*/
+void rope_prepend(BRope *rope, std::unique_ptr<RopeNode> prope){
+    if(prope == nullptr || rope == nullptr || prope->weight == 0){
+        PLOG_ERROR << "given rope is NULL or empty, aborted.";
+        return;
+    }
+    std::vector<std::unique_ptr<RopeNode>> leaves;
+    _bharvest(std::move(prope), leaves);
+    size_t index = 0;
+    for(std::unique_ptr<RopeNode> &leaf : leaves){
+        size_t weight = leaf->weight;
+        _binsert_root(rope, index, std::move(leaf));
+        index += weight;
+    }
+}
+
+void rope_append(BRope *rope, const char *text){
+    rope_append(rope, rope_create_node(text));
+}
+/*
+    connects the given rope to the end;
+        consumes the ownership of the given rope
+*/
+void rope_append(BRope *rope, std::unique_ptr<RopeNode> prope){
+    if(prope == nullptr || rope == nullptr || prope->weight == 0){
+        PLOG_ERROR << "given rope is NULL or empty, aborted.";
+        return;
+    }
+    std::vector<std::unique_ptr<RopeNode>> leaves;
+    _bharvest(std::move(prope), leaves);
+    for(std::unique_ptr<RopeNode> &leaf : leaves)
+        _binsert_root(rope, rope->weight, std::move(leaf));
+}
+
+void rope_insert_at(BRope *rope, size_t index, const char *text){
+    rope_insert_at(rope, index, rope_create_node(text));
+}
+/*
+    inserts the given rope after the character at the given index, as the binary rope does;
+        consumes the ownership of the given rope
+*/
+void rope_insert_at(BRope *rope, size_t index, std::unique_ptr<RopeNode> prope){
+    if(rope == nullptr || prope == nullptr || prope->weight == 0){
+        PLOG_ERROR << "given rope is NULL or empty, aborted.";
+        return;
+    }
+    if(index >= rope->weight && rope->weight != 0){
+        PLOG_ERROR << "given index is bigger than rope weight, aborted. index: " << index;
+        return;
+    }
+    std::vector<std::unique_ptr<RopeNode>> leaves;
+    _bharvest(std::move(prope), leaves);
+    //an empty rope takes it at the start
+    if(rope->weight != 0)
+        index++;
+    _bboundary(rope, index);
+    for(std::unique_ptr<RopeNode> &leaf : leaves){
+        size_t weight = leaf->weight;
+        _binsert_root(rope, index, std::move(leaf));
+        index += weight;
+    }
+}
+
+/*
+    inserts given flags at given range
+*/
+void rope_insert_flag_at(BRope *rope, size_t index, size_t length, uint8_t flags){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return;
+    }else if(length <= 0 || (index+length) > rope->weight){
+        PLOG_ERROR << "invalid index/length combination, aborted.";
+        return;
+    }
+    //range starts and ends on leaf boundaries
+    _bboundary(rope, index);
+    _bboundary(rope, index+length);
+
+    BRopeLeafIterator litrope(rope, index);
+    RopeNode *c;
+    size_t i=index;
+    bool new_lines_changed = false;
+    while(i < index+length && (c = litrope.pop()) != nullptr){
+        size_t lines = _bleaf_lines(*c);
+        c->flags.effects = flags;
+        new_lines_changed |= lines != _bleaf_lines(*c);
+        i += c->weight;
+    }
+    //leaves gained or lost new lines, recount
+    if(new_lines_changed)
+        rope->lines = _blines_measure_set(rope->root.get());
+}
+
+/*
+    removes the given number of characters after the given index, as the binary rope does
+*/
+void rope_delete_at(BRope *rope, size_t index, size_t length){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return;
+    }
+    if(length == 0 ||
+         index+length >= rope->weight){
+        PLOG_ERROR << "index/length combination invalid, aborted." << "index: " << index << " length: " << length;
+        return;
+    }
+    _bboundary(rope, index+1);
+    _bboundary(rope, index+1+length);
+    rope->lines -= _bremove(rope->root.get(), index+1, length);
+    rope->weight -= length;
+    _bshrink(rope);
+}
+
+/*
+    splits the rope after the given index, returns the right side;
+        leaves after the index are moved to a new rope built bottom up
+*/
+std::unique_ptr<BRope> rope_split_at(BRope *rope, size_t index){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return nullptr;
+    }
+    if(index >= rope->weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
+        return nullptr;
+    }
+    //nothing on the right side
+    if(index + 1 == rope->weight)
+        return nullptr;
+
+    _bboundary(rope, index + 1);
+    //move right side leaves out, their slots are erased by the removal
+    std::vector<std::unique_ptr<RopeNode>> leaves;
+    _btake(rope->root.get(), index + 1, leaves);
+    size_t length = rope->weight - (index + 1);
+    rope->lines -= _bremove(rope->root.get(), index + 1, length);
+    rope->weight -= length;
+    _bshrink(rope);
+
+    std::unique_ptr<BRope> new_rope = std::make_unique<BRope>();
+    _bbuild(new_rope.get(), leaves);
+    return new_rope;
+}
+
+/*
+    total weight of the rope
+*/
+size_t rope_weight_total(const BRope &rope){
+    return rope.weight;
+}
+
+/*
+    number of new lines in the rope
+*/
+size_t rope_line_count(const BRope &rope){
+    return rope.lines;
+}
+
+/*
+    returns index of the first character of the given line;
+            on error returns rope weight
+*/
+size_t rope_line_to_index(const BRope &rope, size_t line){
+    if(line == 0)
+        return 0;
+    if(line > rope.lines){
+        PLOG_ERROR << "line bigger than number of lines, aborted.";
+        return rope.weight;
+    }
+    size_t index = 0;
+    const BRopeNode *node = rope.root.get();
+    while(true){
+        size_t i = 0;
+        //child holding the new line that ends the previous line
+        while(i+1 < node->count && line > node->lines[i]){
+            line -= node->lines[i];
+            index += node->weights[i];
+            i++;
+        }
+        if(node->leaf_level)
+            return index + node->weights[i];
+        node = node->nodes[i].get();
+    }
+}
+
+/*
+    returns line of the character at the given index;
+        on error returns number of lines
+*/
+size_t rope_index_to_line(const BRope &rope, size_t index){
+    if(index >= rope.weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
+        return rope.lines;
+    }
+    size_t line = 0;
+    const BRopeNode *node = rope.root.get();
+    while(true){
+        size_t i = 0;
+        while(i+1 < node->count && index >= node->weights[i]){
+            index -= node->weights[i];
+            line += node->lines[i];
+            i++;
+        }
+        if(node->leaf_level)
+            return line;
+        node = node->nodes[i].get();
+    }
+}
+
+/*
+    levels of internal nodes, leaves not counted
+*/
+size_t rope_height_measure(const BRope &rope){
+    return rope.height;
+}
+
+/*
+    checks if given rope has flags at given range
+*/
+bool rope_has_flag_at(BRope &rope, size_t index, size_t length, uint8_t flags){
+    BRopeLeafIterator litrope(&rope, index);
+    RopeNode *c;
+    size_t i=index;
+    while((c = litrope.pop()) != nullptr && i < (index+length)){
+        if(!has_flags(&c->flags, flags))
+            return false;
+        i += c->weight;
+    }
+    return true;
+}
+
+/*
+    returns leaf that contains character at the given index;
+            on error returns null
+*/
+RopeNode* rope_node_at_index(BRope &rope, size_t index, size_t *local_index){
+    if(index >= rope.weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
+        return nullptr;
+    }
+    BRopeNode *node = rope.root.get();
+    while(true){
+        size_t i = 0;
+        while(i+1 < node->count && index >= node->weights[i]){
+            index -= node->weights[i];
+            i++;
+        }
+        if(node->leaf_level){
+            if(local_index != nullptr)
+                *local_index = index;
+            return node->leaves[i].get();
+        }
+        node = node->nodes[i].get();
+    }
+}
+
+
+/*
+    helper
+*/
+size_t _bleaf_lines(const RopeNode &leaf){
+    return (leaf.flags.effects.to_ulong() & (uint64_t)FLAG_NEW_LINE) ? 1 : 0;
+}
+
+/*
+    moves non empty leaves of the binary rope to the vector, in order
+*/
+void _bharvest(std::unique_ptr<RopeNode> rope, std::vector<std::unique_ptr<RopeNode>> &leaves){
+    std::vector<std::unique_ptr<RopeNode>> nodeStack;
+    nodeStack.push_back(std::move(rope));
+    while(!nodeStack.empty()){
+        std::unique_ptr<RopeNode> node = std::move(nodeStack.back());
+        nodeStack.pop_back();
+        if(node->left == nullptr && node->right == nullptr){
+            if(node->text != nullptr && node->weight > 0)
+                leaves.push_back(std::move(node));
+            continue;
+        }
+        if(node->right != nullptr)
+            nodeStack.push_back(std::move(node->right));
+        if(node->left != nullptr)
+            nodeStack.push_back(std::move(node->left));
+    }
+}
+
+/*
+    helper
+*/
+size_t _bnode_weight(const BRopeNode &node){
+    size_t weight = 0;
+    for(size_t i=0;i<node.count;i++)
+        weight += node.weights[i];
+    return weight;
+}
+
+/*
+    helper
+*/
+size_t _bnode_lines(const BRopeNode &node){
+    size_t lines = 0;
+    for(size_t i=0;i<node.count;i++)
+        lines += node.lines[i];
+    return lines;
+}
+
+/*
+    moves child entry, with it's weight and lines, between array slots
+*/
+void _bentry_move(BRopeNode *from, size_t i, BRopeNode *to, size_t j){
+    to->weights[j] = from->weights[i];
+    to->lines[j] = from->lines[i];
+    to->nodes[j] = std::move(from->nodes[i]);
+    to->leaves[j] = std::move(from->leaves[i]);
+}
+
+/*
+    inserts the child, node or leaf, at the given position;
+        full node is split in halves first, returns the new right half or null
+*/
+std::unique_ptr<BRopeNode> _bnode_insert(BRopeNode *node, size_t position, std::unique_ptr<BRopeNode> child,
+                                        std::unique_ptr<RopeNode> leaf, size_t weight, size_t lines){
+    std::unique_ptr<BRopeNode> sibling;
+    BRopeNode *target = node;
+    if(node->count == BROPE_MAX_CHILDREN){
+        sibling = std::make_unique<BRopeNode>();
+        sibling->leaf_level = node->leaf_level;
+        size_t half = node->count / 2;
+        for(size_t i=half;i<node->count;i++)
+            _bentry_move(node, i, sibling.get(), i - half);
+        sibling->count = node->count - half;
+        node->count = half;
+        if(position > node->count){
+            position -= node->count;
+            target = sibling.get();
+        }
+    }
+    //make room
+    for(size_t i=target->count;i>position;i--)
+        _bentry_move(target, i-1, target, i);
+    target->weights[position] = weight;
+    target->lines[position] = lines;
+    target->nodes[position] = std::move(child);
+    target->leaves[position] = std::move(leaf);
+    target->count++;
+    return sibling;
+}
+
+/*
+    removes the child at the given position, destroying it
+*/
+void _bnode_erase(BRopeNode *node, size_t position){
+    node->nodes[position].reset();
+    node->leaves[position].reset();
+    for(size_t i=position;i+1<node->count;i++)
+        _bentry_move(node, i+1, node, i);
+    node->count--;
+}
+
+/*
+    builds the tree bottom up out of the given leaves,
+        each level is filled evenly
+*/
+void _bbuild(BRope *rope, std::vector<std::unique_ptr<RopeNode>> &leaves){
+    rope->root = std::make_unique<BRopeNode>();
+    rope->weight = 0;
+    rope->lines = 0;
+    rope->height = 1;
+    if(leaves.empty())
+        return;
+
+    std::vector<std::unique_ptr<BRopeNode>> level;
+    size_t groups = (leaves.size() + BROPE_MAX_CHILDREN - 1) / BROPE_MAX_CHILDREN;
+    for(size_t g=0;g<groups;g++){
+        std::unique_ptr<BRopeNode> node = std::make_unique<BRopeNode>();
+        for(size_t i=g*leaves.size()/groups;i<(g+1)*leaves.size()/groups;i++){
+            size_t weight = leaves[i]->weight;
+            size_t lines = _bleaf_lines(*(leaves[i]));
+            _bnode_insert(node.get(), node->count, nullptr, std::move(leaves[i]), weight, lines);
+            rope->weight += weight;
+            rope->lines += lines;
+        }
+        level.push_back(std::move(node));
+    }
+    while(level.size() > 1){
+        std::vector<std::unique_ptr<BRopeNode>> upper;
+        groups = (level.size() + BROPE_MAX_CHILDREN - 1) / BROPE_MAX_CHILDREN;
+        for(size_t g=0;g<groups;g++){
+            std::unique_ptr<BRopeNode> node = std::make_unique<BRopeNode>();
+            node->leaf_level = false;
+            for(size_t i=g*level.size()/groups;i<(g+1)*level.size()/groups;i++){
+                size_t weight = _bnode_weight(*(level[i]));
+                size_t lines = _bnode_lines(*(level[i]));
+                _bnode_insert(node.get(), node->count, std::move(level[i]), nullptr, weight, lines);
+            }
+            upper.push_back(std::move(node));
+        }
+        level.swap(upper);
+        rope->height++;
+    }
+    rope->root = std::move(level[0]);
+}
+
+/*
+    inserts the leaf so it starts at the given index, index has to be on a leaf boundary;
+        returns the new right sibling when the node had to be split
+*/
+std::unique_ptr<BRopeNode> _binsert(BRopeNode *node, size_t index, std::unique_ptr<RopeNode> leaf, size_t weight, size_t lines){
+    size_t i = 0;
+    if(node->leaf_level){
+        //after leaves that end before index
+        while(i < node->count && index >= node->weights[i]){
+            index -= node->weights[i];
+            i++;
+        }
+        return _bnode_insert(node, i, nullptr, std::move(leaf), weight, lines);
+    }
+
+    while(i+1 < node->count && index > node->weights[i]){
+        index -= node->weights[i];
+        i++;
+    }
+    std::unique_ptr<BRopeNode> split = _binsert(node->nodes[i].get(), index, std::move(leaf), weight, lines);
+    node->weights[i] += weight;
+    node->lines[i] += lines;
+    if(split == nullptr)
+        return nullptr;
+    //child was split, add it's right half after it
+    size_t split_weight = _bnode_weight(*split);
+    size_t split_lines = _bnode_lines(*split);
+    node->weights[i] -= split_weight;
+    node->lines[i] -= split_lines;
+    return _bnode_insert(node, i+1, std::move(split), nullptr, split_weight, split_lines);
+}
+
+/*
+    inserts the leaf at the given leaf boundary, grows the tree when the root splits
+*/
+void _binsert_root(BRope *rope, size_t index, std::unique_ptr<RopeNode> leaf){
+    size_t weight = leaf->weight;
+    size_t lines = _bleaf_lines(*leaf);
+    std::unique_ptr<BRopeNode> split = _binsert(rope->root.get(), index, std::move(leaf), weight, lines);
+    rope->weight += weight;
+    rope->lines += lines;
+    if(split == nullptr)
+        return;
+
+    std::unique_ptr<BRopeNode> root = std::make_unique<BRopeNode>();
+    root->leaf_level = false;
+    size_t split_weight = _bnode_weight(*split);
+    size_t split_lines = _bnode_lines(*split);
+    _bnode_insert(root.get(), 0, std::move(rope->root), nullptr, rope->weight - split_weight, rope->lines - split_lines);
+    _bnode_insert(root.get(), 1, std::move(split), nullptr, split_weight, split_lines);
+    rope->root = std::move(root);
+    rope->height++;
+}
+
+/*
+    cuts the leaf holding the given index,
+        returns the part starting at index, leaf keeps the rest
+*/
+std::unique_ptr<RopeNode> _bleaf_cut(RopeNode *leaf, size_t index){
+    size_t b_index = rope_leaf_offset(*leaf, index);
+    std::unique_ptr<RopeNode> right = std::make_unique<RopeNode>();
+    rope_leaf_text_set(right.get(), leaf->text.get() + b_index, leaf->bytes - b_index);
+    right->flags.effects = leaf->flags.effects;
+    //new line stays after the right part
+    leaf->flags.effects &= ~RopeEffects(FLAG_NEW_LINE);
+    rope_leaf_text_set(leaf, leaf->text.get(), b_index);
+    return right;
+}
+
+/*
+    helper
+*/
+std::unique_ptr<RopeNode> _bcut(BRopeNode *node, size_t index){
+    size_t i = 0;
+    while(i+1 < node->count && index >= node->weights[i]){
+        index -= node->weights[i];
+        i++;
+    }
+    std::unique_ptr<RopeNode> right = node->leaf_level ?
+        _bleaf_cut(node->leaves[i].get(), index) : _bcut(node->nodes[i].get(), index);
+    node->weights[i] -= right->weight;
+    node->lines[i] -= _bleaf_lines(*right);
+    return right;
+}
+
+/*
+    makes sure a leaf starts at the given index
+*/
+void _bboundary(BRope *rope, size_t index){
+    if(index == 0 || index >= rope->weight)
+        return;
+    size_t local_index = 0;
+    if(rope_node_at_index(*rope, index, &local_index) == nullptr || local_index == 0)
+        return;
+    std::unique_ptr<RopeNode> right = _bcut(rope->root.get(), index);
+    rope->weight -= right->weight;
+    rope->lines -= _bleaf_lines(*right);
+    _binsert_root(rope, index, std::move(right));
+}
+
+/*
+    refills the child that has less than the minimum of children,
+        by merging it with a sibling or borrowing from it;
+            returns true if anything changed
+*/
+bool _bfix(BRopeNode *node, size_t position){
+    BRopeNode *child = node->nodes[position].get();
+    if(child->count == 0){
+        _bnode_erase(node, position);
+        return true;
+    }
+    if(child->count >= BROPE_MIN_CHILDREN || node->count < 2)
+        return false;
+
+    size_t l = position > 0 ? position - 1 : position;
+    BRopeNode *left = node->nodes[l].get();
+    BRopeNode *right = node->nodes[l+1].get();
+    if(left->count + right->count <= BROPE_MAX_CHILDREN){
+        //merge right into left
+        for(size_t i=0;i<right->count;i++)
+            _bentry_move(right, i, left, left->count + i);
+        left->count += right->count;
+        right->count = 0;
+        node->weights[l] += node->weights[l+1];
+        node->lines[l] += node->lines[l+1];
+        _bnode_erase(node, l+1);
+        return true;
+    }
+    //borrow, one child at a time
+    while(left->count < BROPE_MIN_CHILDREN){
+        node->weights[l] += right->weights[0];
+        node->lines[l] += right->lines[0];
+        node->weights[l+1] -= right->weights[0];
+        node->lines[l+1] -= right->lines[0];
+        _bentry_move(right, 0, left, left->count);
+        left->count++;
+        for(size_t i=0;i+1<right->count;i++)
+            _bentry_move(right, i+1, right, i);
+        right->count--;
+    }
+    while(right->count < BROPE_MIN_CHILDREN){
+        size_t last = left->count - 1;
+        node->weights[l] -= left->weights[last];
+        node->lines[l] -= left->lines[last];
+        node->weights[l+1] += left->weights[last];
+        node->lines[l+1] += left->lines[last];
+        for(size_t i=right->count;i>0;i--)
+            _bentry_move(right, i-1, right, i);
+        _bentry_move(left, last, right, 0);
+        right->count++;
+        left->count--;
+    }
+    return true;
+}
+
+/*
+    removes the given range, it has to start and end on leaf boundaries;
+        returns number of removed new lines
+*/
+size_t _bremove(BRopeNode *node, size_t index, size_t length){
+    size_t removed_lines = 0;
+    size_t i = 0;
+    //skip children before the range
+    while(i < node->count && index >= node->weights[i]){
+        index -= node->weights[i];
+        i++;
+    }
+    while(i < node->count && length > 0){
+        if(index == 0 && length >= node->weights[i]){
+            //whole child
+            length -= node->weights[i];
+            removed_lines += node->lines[i];
+            _bnode_erase(node, i);
+            continue;
+        }
+        size_t part = std::min(length, node->weights[i] - index);
+        size_t lines = _bremove(node->nodes[i].get(), index, part);
+        node->weights[i] -= part;
+        node->lines[i] -= lines;
+        removed_lines += lines;
+        length -= part;
+        index = 0;
+        i++;
+    }
+
+    //refill children left with too few
+    if(!node->leaf_level){
+        for(size_t j=0;j<node->count;){
+            if(node->nodes[j]->count < BROPE_MIN_CHILDREN && _bfix(node, j))
+                j = 0;
+            else
+                j++;
+        }
+    }
+    return removed_lines;
+}
+
+/*
+    moves out leaves from the given leaf boundary to the end, in order
+*/
+void _btake(BRopeNode *node, size_t index, std::vector<std::unique_ptr<RopeNode>> &leaves){
+    size_t i = 0;
+    while(i < node->count && index >= node->weights[i]){
+        index -= node->weights[i];
+        i++;
+    }
+    for(;i<node->count;i++){
+        if(node->leaf_level)
+            leaves.push_back(std::move(node->leaves[i]));
+        else
+            _btake(node->nodes[i].get(), index, leaves);
+        index = 0;
+    }
+}
+
+/*
+    drops root levels left with a single child
+*/
+void _bshrink(BRope *rope){
+    while(!rope->root->leaf_level && rope->root->count == 1){
+        std::unique_ptr<BRopeNode> child = std::move(rope->root->nodes[0]);
+        rope->root = std::move(child);
+        rope->height--;
+    }
+    if(!rope->root->leaf_level && rope->root->count == 0){
+        rope->root = std::make_unique<BRopeNode>();
+        rope->height = 1;
+    }
+}
+
+/*
+    go trough tree counting and setting new lines,
+        returns total number of new lines
+*/
+size_t _blines_measure_set(BRopeNode *node){
+    size_t lines = 0;
+    for(size_t i=0;i<node->count;i++){
+        node->lines[i] = node->leaf_level ?
+            _bleaf_lines(*(node->leaves[i])) : _blines_measure_set(node->nodes[i].get());
+        lines += node->lines[i];
+    }
+    return lines;
+}
@@ -0,0 +1,91 @@
+#ifndef BROPE_H
+#define BROPE_H
+
+
+#include "rope.h"
+
+#include <memory>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <bitset>
+
+
+/*
+    B-tree rope;
+    wide internal nodes keep child weights and new line counts in contiguous arrays,
+    so finding a child is a scan over one or two cache lines instead of a pointer chase.
+    All leaves are at the same depth and are ordinary RopeNode leaves,
+    code working with leaves works the same for both ropes.
+*/
+inline const size_t                 BROPE_MAX_CHILDREN = 16;
+inline const size_t                 BROPE_MIN_CHILDREN = BROPE_MAX_CHILDREN / 2;
+
+
+struct BRopeNode final{
+    std::size_t                                 count;
+    bool                                        leaf_level;//children are leaves
+    std::size_t                                 weights[BROPE_MAX_CHILDREN];
+    std::size_t                                 lines[BROPE_MAX_CHILDREN];
+    std::unique_ptr<BRopeNode>                  nodes[BROPE_MAX_CHILDREN];
+    std::unique_ptr<RopeNode>                   leaves[BROPE_MAX_CHILDREN];
+
+    BRopeNode();
+
+    BRopeNode(const BRopeNode&) = delete;
+    BRopeNode& operator=(const BRopeNode&) = delete;
+};
+
+struct BRope final{
+    std::unique_ptr<BRopeNode>                  root;
+    std::size_t                                 weight;
+    std::size_t                                 lines;
+    std::size_t                                 height;//levels of internal nodes
+
+    BRope();
+
+    BRope(const BRope&) = delete;
+    BRope& operator=(const BRope&) = delete;
+};
+
+
+/*
+    walks the leaves in order,
+        moves trough the leaf array and only climbs when it runs out
+*/
+class BRopeLeafIterator{
+    std::vector<std::pair<BRopeNode*, size_t>>  path;
+    RopeNode                                    *current;
+    size_t                                      localStartIndex;
+public:
+    explicit BRopeLeafIterator(BRope *rope, size_t start = 0);
+
+    RopeNode* next();
+    bool      hasNext();
+    RopeNode* pop();
+    size_t    local_start_index();
+};
+
+
+std::unique_ptr<BRope>          brope_create(const char*);
+std::unique_ptr<BRope>          brope_create(const char*, RopeEffects);
+void                            rope_destroy(std::unique_ptr<BRope>);
+void                            rope_prepend(BRope*,const char*);
+void                            rope_prepend(BRope*,std::unique_ptr<RopeNode>);
+void                            rope_append(BRope*,const char*);
+void                            rope_append(BRope*,std::unique_ptr<RopeNode>);
+void                            rope_insert_at(BRope*,size_t,const char*);
+void                            rope_insert_at(BRope*,size_t,std::unique_ptr<RopeNode>);
+void                            rope_insert_flag_at(BRope*, size_t, size_t, uint8_t);
+void                            rope_delete_at(BRope*, size_t, size_t);
+std::unique_ptr<BRope>          rope_split_at(BRope*,size_t);
+size_t                          rope_weight_total(const BRope&);
+size_t                          rope_line_count(const BRope&);
+size_t                          rope_line_to_index(const BRope&, size_t);
+size_t                          rope_index_to_line(const BRope&, size_t);
+size_t                          rope_height_measure(const BRope&);
+bool                            rope_has_flag_at(BRope&, size_t, size_t, uint8_t);
+RopeNode*                       rope_node_at_index(BRope&,size_t,size_t*);
+
+
+#endif
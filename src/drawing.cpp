@@ -1,5 +1,6 @@
 #include "termija.h"
 #include "widget.h"
+#include "utf8.h"
 
 
 #include <raylib.h>
@@ -142,7 +143,7 @@ void _draw(uint8_t flags, Font font, const char *text, Vector2 position, float f
 }
 
 
-void _tra_draw_node_down(RopeNode *node, uint16_t &x, uint16_t &y, uint16_t xPaneStart, uint16_t yPaneStart, uint16_t xStart, uint16_t yStart, uint16_t textWidth, uint16_t textHeight, size_t startIndex){
+void _tra_draw_node_down(RopeNode *node, uint16_t &x, uint16_t &y, uint16_t xPaneStart, uint16_t yPaneStart, uint16_t xStart, uint16_t yStart, uint16_t textWidth, uint16_t textHeight, size_t startIndex, const RopeAttrs *attrs, size_t nodeIndex){
     const Termija& termija = Termija::instance();
     //get font
     Font *font = tra_get_font();
@@ -154,19 +155,35 @@ void _tra_draw_node_down(RopeNode *node, uint16_t &x, uint16_t &y, uint16_t xPan
         return;
     }
     //whole or until end of frame
+    //leaf weight is its codepoint count, byte offset moves along with left
+    const char *text = node->text.get();
+    if(node->mapped){
+        //mapped text isn't NUL terminated, drawing measures it as a C string
+        thread_local std::string scratch;
+        scratch.assign(text, node->bytes);
+        text = scratch.c_str();
+    }
     size_t left = startIndex;
-    size_t right = std::min(ustrlen(node->text.get()), startIndex + (size_t)textWidth - x);
+    size_t offset = rope_leaf_offset(*node, left);
     //whole text or until textHeight
-     //draw until right, excluding right
-    while(left < right && y < textHeight){
+    while(left < node->weight && y < textHeight){
+        //until line end, excluding right
+        size_t right = std::min(node->weight, left + (size_t)(textWidth - x));
+        uint8_t flags = (uint8_t)node->flags.effects.to_ulong();
+        //attribute runs cut the part, their bits go with the leaf flags
+        if(attrs != nullptr){
+            size_t runEnd;
+            flags |= attrs_at(*attrs, nodeIndex + left, &runEnd);
+            right = std::min(right, runEnd - nodeIndex);
+        }
         //draw
         Vector2 position{(float)xPaneStart+xStart+(x*(termija.fontWidth+termija.fontSpacing)), (float)yPaneStart+yStart+(y*(termija.fontHeight))};
-        _draw(node->flags->effects.to_ullong(),*font, node->text.get() + u_index_at(node->text.get(), left), position, (float)termija.fontHeight, (float)termija.fontSpacing, termija.fontColor, right-left);
+        _draw(flags,*font, text + offset, position, (float)termija.fontHeight, (float)termija.fontSpacing, termija.fontColor, right-left);
+        offset = node->ascii ? right : offset + u_offset(text + offset, node->bytes - offset, right - left);
         //move position
         x += (right - left);
         //next part
         left = right;
-        right = std::min(ustrlen(node->text.get()), right+(size_t)(textWidth - 0));
         //next line
         if(x >= textWidth){
             y++;
@@ -174,7 +191,7 @@ void _tra_draw_node_down(RopeNode *node, uint16_t &x, uint16_t &y, uint16_t xPan
         }
     }
     //new line, only if not already at the star
-    if(x > 0 && (node->flags->effects.to_ulong() & (uint64_t)FLAG_NEW_LINE)){
+    if(x > 0 && (node->flags.effects.to_ulong() & (uint64_t)FLAG_NEW_LINE)){
         x=0;
         y++;
     }
@@ -182,9 +199,9 @@ void _tra_draw_node_down(RopeNode *node, uint16_t &x, uint16_t &y, uint16_t xPan
 
 /*
     draw text down from cursor index;
-        starts from cursor xy
+        starts from cursor xy, attrs are drawn over the text if given
 */
-void _tra_draw_text_down(RopeNode *rope, uint16_t xPaneStart, uint16_t yPaneStart, uint16_t xStart, uint16_t yStart, uint16_t textWidth, uint16_t textHeight,const Cursor &cursor){
+void _tra_draw_text_down(RopeNode *rope, uint16_t xPaneStart, uint16_t yPaneStart, uint16_t xStart, uint16_t yStart, uint16_t textWidth, uint16_t textHeight,const Cursor &cursor, const RopeAttrs *attrs){
     if(rope == nullptr){
         PLOG_ERROR << "rope is NULL, aborted.";
         return;
@@ -196,12 +213,15 @@ void _tra_draw_text_down(RopeNode *rope, uint16_t xPaneStart, uint16_t yPaneStar
     RopeNode *current;//start from cursor xy
     uint16_t x=cursor.x,y=cursor.y;//initialStartIndex is length to starting index inside leaf
     size_t initialStartIndex = litrope.local_start_index();
+    //rope index of the leaf start
+    size_t nodeIndex = cursor.index - initialStartIndex;
     //draw leaves
     while((current = litrope.pop()) != nullptr && y < textHeight){
         //draw node text
         if(current->text != nullptr){
-            _tra_draw_node_down(current, x, y, xPaneStart, yPaneStart, xStart, yStart, textWidth, textHeight, initialStartIndex);
+            _tra_draw_node_down(current, x, y, xPaneStart, yPaneStart, xStart, yStart, textWidth, textHeight, initialStartIndex, attrs, nodeIndex);
             initialStartIndex = 0;
+            nodeIndex += current->weight;
         }
     }
 }
@@ -210,48 +230,38 @@ void _tra_draw_text_down(RopeNode *rope, uint16_t xPaneStart, uint16_t yPaneStar
     measures weight up until next new line including cursor
 */
 size_t weight_until_next_new_line(RopeNode *rope, size_t currentIndex){
-    size_t weight = 0;
-    RopeLeafIterator litrope(rope, currentIndex);
-    size_t weightToNodeEnd = litrope.get() != nullptr ? litrope.get()->weight - litrope.local_start_index() : 0;
-    RopeNode *current;
-    do{
-        current = litrope.pop();
-        if(current == nullptr)
-            break;        
-        //add weight
-        weight += weightToNodeEnd>0?weightToNodeEnd:current->weight;
-        weightToNodeEnd = 0;
-    }while(!(current->flags->effects.to_ulong() & (uint64_t)FLAG_NEW_LINE));
-    return weight + weightToNodeEnd;
+    if(rope_node_at_index(*rope, currentIndex, nullptr) == nullptr)
+        return 0;
+    //start of the next line, or rope end if this is the last one
+    size_t line = rope_index_to_line(*rope, currentIndex);
+    size_t nextLineIndex = line < rope_line_count(*rope) ?
+                            rope_line_to_index(*rope, line + 1) : rope_weight_total(*rope);
+    return nextLineIndex - currentIndex;
 }
 
 /*
     measures weight up until previous new line including cursor
 */
 size_t weight_until_prev_new_line(RopeNode *rope, size_t currentIndex){
-    size_t weight = 0;
-    RopeLeafIteratorBack blitrope(rope, currentIndex);
-    size_t weightToNodeStart = blitrope.local_start_index() + 1;
-    RopeNode *current;
-    current = blitrope.pop();
-
-    //start from prev
-    while((current = blitrope.pop()) != nullptr &&
-        !(current->flags->effects.to_ulong() & (uint64_t)FLAG_NEW_LINE)){
-        //add weight
-        weight += current->weight;
-    }
-    return weight + weightToNodeStart;
+    if(rope_node_at_index(*rope, currentIndex, nullptr) == nullptr)
+        return 1;
+    //start of the current line
+    size_t lineIndex = rope_line_to_index(*rope, rope_index_to_line(*rope, currentIndex));
+    return currentIndex - lineIndex + 1;
 }
 
 void tra_draw_text(RopeNode *rope, uint16_t xPaneStart, uint16_t yPaneStart, uint16_t xStart, uint16_t yStart, uint16_t textWidth, uint16_t textHeight,size_t index){
     Cursor c;
     c.index = index;
-    _tra_draw_text_down(rope, xPaneStart, yPaneStart, xStart, yStart, textWidth, textHeight, c);
+    _tra_draw_text_down(rope, xPaneStart, yPaneStart, xStart, yStart, textWidth, textHeight, c, nullptr);
 }
 
 void tra_draw_text(RopeNode *rope, uint16_t xPaneStart, uint16_t yPaneStart, uint16_t xStart, uint16_t yStart, uint16_t textWidth, uint16_t textHeight,Cursor &cursor){
-    _tra_draw_text_down(rope, xPaneStart, yPaneStart, xStart, yStart, textWidth, textHeight, cursor);
+    _tra_draw_text_down(rope, xPaneStart, yPaneStart, xStart, yStart, textWidth, textHeight, cursor, nullptr);
+}
+
+void tra_draw_text(RopeNode *rope, uint16_t xPaneStart, uint16_t yPaneStart, uint16_t xStart, uint16_t yStart, uint16_t textWidth, uint16_t textHeight,Cursor &cursor, const RopeAttrs *attrs){
+    _tra_draw_text_down(rope, xPaneStart, yPaneStart, xStart, yStart, textWidth, textHeight, cursor, attrs);
 }
 
 // Draw inverted character (codepoint)
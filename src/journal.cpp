@@ -0,0 +1,383 @@
+#include "journal.h"
+#include <plog/Log.h>
+
+
+#include <memory>
+#include <utility>
+#include <algorithm>
+
+
+size_t                                          _edit_bytes(const RopeEdit&);
+void                                            _edit_capture(RopeNode&, size_t, size_t, RopeEdit*);
+void                                            _edit_run_push(RopeEdit*, const RopeEditRun&);
+bool                                            _edit_coalesce(RopeEdit*, RopeEdit&);
+void                                            _journal_push(RopeJournal*, RopeEdit);
+void                                            _journal_trim(RopeJournal*);
+void                                            _replay_insert(std::unique_ptr<RopeNode>&, const RopeEdit&);
+void                                            _replay_delete(std::unique_ptr<RopeNode>&, const RopeEdit&);
+void                                            _replay_flags(std::unique_ptr<RopeNode>&, const RopeEdit&, bool);
+
+
+RopeJournal::RopeJournal(size_t budget)
+: applied{0}, bytes{0}, budget{budget}, sealed{false}, groups{0}, joining{false}
+{}
+
+
+/*
+    records text just inserted at index
+*/
+void journal_insert(RopeJournal *journal, RopeNode &rope, size_t index, size_t length){
+    if(journal == nullptr || length == 0){
+        PLOG_ERROR << "given journal is NULL or edit is empty, aborted.";
+        return;
+    }
+    RopeEdit edit;
+    edit.kind = EDIT_INSERT;
+    edit.joined = false;
+    _edit_capture(rope, index, length, &edit);
+    _journal_push(journal, std::move(edit));
+}
+
+/*
+    records text about to be deleted at index,
+        call before the delete
+*/
+void journal_delete(RopeJournal *journal, RopeNode &rope, size_t index, size_t length){
+    if(journal == nullptr || length == 0){
+        PLOG_ERROR << "given journal is NULL or edit is empty, aborted.";
+        return;
+    }
+    RopeEdit edit;
+    edit.kind = EDIT_DELETE;
+    edit.joined = false;
+    _edit_capture(rope, index, length, &edit);
+    _journal_push(journal, std::move(edit));
+}
+
+/*
+    records flags about to be set at index,
+        call before setting them; only flags are kept, not the text
+*/
+void journal_flags(RopeJournal *journal, RopeNode &rope, size_t index, size_t length, uint8_t flags){
+    if(journal == nullptr || length == 0){
+        PLOG_ERROR << "given journal is NULL or edit is empty, aborted.";
+        return;
+    }
+    RopeEdit edit;
+    edit.kind = EDIT_FLAGS;
+    edit.joined = false;
+    edit.flags = flags;
+    _edit_capture(rope, index, length, &edit);
+    edit.text.clear();
+    edit.text.shrink_to_fit();
+    _journal_push(journal, std::move(edit));
+}
+
+/*
+    the next edit is not coalesced with the last one
+*/
+void journal_seal(RopeJournal *journal){
+    if(journal != nullptr)
+        journal->sealed = true;
+}
+
+/*
+    starts a group, edits until the matching end are undone and redone as one;
+        the first of them isn't coalesced with an edit before the group
+*/
+void journal_group_begin(RopeJournal *journal){
+    if(journal == nullptr)
+        return;
+    if(journal->groups++ > 0)
+        return;
+    journal->sealed = true;
+    journal->joining = false;
+}
+
+/*
+    ends the group, the next edit is not coalesced with it's last one
+*/
+void journal_group_end(RopeJournal *journal){
+    if(journal == nullptr || journal->groups == 0){
+        PLOG_ERROR << "given journal is NULL or has no group, aborted.";
+        return;
+    }
+    if(--journal->groups > 0)
+        return;
+    journal->sealed = true;
+    journal->joining = false;
+}
+
+void journal_clear(RopeJournal *journal){
+    if(journal == nullptr)
+        return;
+    journal->edits.clear();
+    journal->applied = 0;
+    journal->bytes = 0;
+    journal->sealed = false;
+    journal->joining = false;
+}
+
+/*
+    sets the byte budget, dropping oldest edits if over it
+*/
+void journal_budget_set(RopeJournal *journal, size_t budget){
+    if(journal == nullptr)
+        return;
+    journal->budget = budget;
+    _journal_trim(journal);
+}
+
+bool journal_can_undo(const RopeJournal &journal){
+    return journal.applied > 0;
+}
+
+bool journal_can_redo(const RopeJournal &journal){
+    return journal.applied < journal.edits.size();
+}
+
+/*
+    reverts the last applied edit, or the whole group it ends,
+        index is set to where the cursor belongs after it;
+            false if there is nothing to undo
+*/
+bool journal_undo(RopeJournal *journal, std::unique_ptr<RopeNode> &rope, size_t *index){
+    if(journal == nullptr || rope == nullptr || !journal_can_undo(*journal))
+        return false;
+    size_t cursor = 0;
+    bool joined = true;
+    while(joined && journal_can_undo(*journal)){
+        const RopeEdit &edit = journal->edits[--journal->applied];
+        cursor = edit.index;
+        if(edit.kind == EDIT_INSERT){
+            _replay_delete(rope, edit);
+        }else if(edit.kind == EDIT_DELETE){
+            _replay_insert(rope, edit);
+            cursor += edit.length;
+        }else{
+            _replay_flags(rope, edit, true);
+        }
+        joined = edit.joined;
+    }
+    journal->sealed = true;
+    //an edit after it starts a new group, it doesn't join the replayed ones
+    journal->joining = false;
+    if(index != nullptr)
+        *index = cursor;
+    return true;
+}
+
+/*
+    applies the last undone edit again, or the whole group it starts,
+        index is set to where the cursor belongs after it;
+            false if there is nothing to redo
+*/
+bool journal_redo(RopeJournal *journal, std::unique_ptr<RopeNode> &rope, size_t *index){
+    if(journal == nullptr || rope == nullptr || !journal_can_redo(*journal))
+        return false;
+    size_t cursor = 0;
+    do{
+        const RopeEdit &edit = journal->edits[journal->applied++];
+        cursor = edit.index;
+        if(edit.kind == EDIT_INSERT){
+            _replay_insert(rope, edit);
+            cursor += edit.length;
+        }else if(edit.kind == EDIT_DELETE){
+            _replay_delete(rope, edit);
+        }else{
+            _replay_flags(rope, edit, false);
+        }
+    }while(journal_can_redo(*journal) && journal->edits[journal->applied].joined);
+    journal->sealed = true;
+    //an edit after it starts a new group, it doesn't join the replayed ones
+    journal->joining = false;
+    if(index != nullptr)
+        *index = cursor;
+    return true;
+}
+
+
+/*
+    memory held by the edit
+*/
+size_t _edit_bytes(const RopeEdit &edit){
+    return sizeof(RopeEdit) + edit.text.size() + edit.runs.size() * sizeof(RopeEditRun);
+}
+
+/*
+    copies text and flags of the range into the edit, run per leaf;
+        a leaf cut before it's end doesn't end the line, new line goes with the leaf end
+*/
+void _edit_capture(RopeNode &rope, size_t index, size_t length, RopeEdit *edit){
+    edit->index = index;
+    edit->length = 0;
+    RopeLeafIterator litrope(&rope, index);
+    size_t skip = litrope.local_start_index();
+    RopeNode *c;
+    while(edit->length < length && (c = litrope.pop()) != nullptr){
+        if(c->text == nullptr || c->weight <= skip){
+            skip -= std::min(skip, c->weight);
+            continue;
+        }
+        size_t take = std::min(c->weight - skip, length - edit->length);
+        size_t from = rope_leaf_offset(*c, skip);
+        size_t to = rope_leaf_offset(*c, skip + take);
+        uint8_t flags = (uint8_t)c->flags.effects.to_ulong();
+        if(skip + take < c->weight)
+            flags &= ~FLAG_NEW_LINE;
+        edit->text.append(c->text.get() + from, to - from);
+        _edit_run_push(edit, {(uint32_t)(to - from), (uint32_t)take, flags});
+        edit->length += take;
+        skip = 0;
+    }
+}
+
+/*
+    appends the run, merged into the last one when flags match
+*/
+void _edit_run_push(RopeEdit *edit, const RopeEditRun &run){
+    if(!edit->runs.empty()){
+        RopeEditRun &last = edit->runs.back();
+        if(last.flags == run.flags && !(last.flags & FLAG_NEW_LINE)){
+            last.bytes += run.bytes;
+            last.weight += run.weight;
+            return;
+        }
+    }
+    edit->runs.push_back(run);
+}
+
+/*
+    merges the edit into the last one if it continues it;
+        typing after the last insert, backspace before or delete at the last delete;
+            never across a new line
+*/
+bool _edit_coalesce(RopeEdit *last, RopeEdit &edit){
+    if(last->kind != edit.kind || last->kind == EDIT_FLAGS ||
+        last->length + edit.length > JOURNAL_COALESCE_MAX)
+        return false;
+    for(const RopeEditRun &run : edit.runs)
+        if(run.flags & FLAG_NEW_LINE)
+            return false;
+    for(const RopeEditRun &run : last->runs)
+        if(run.flags & FLAG_NEW_LINE)
+            return false;
+
+    if(edit.kind == EDIT_INSERT ? edit.index == last->index + last->length :
+                                    edit.index == last->index){
+        //after the last one
+        last->text += edit.text;
+        for(const RopeEditRun &run : edit.runs)
+            _edit_run_push(last, run);
+    }else if(edit.kind == EDIT_DELETE && edit.index + edit.length == last->index){
+        //before the last one
+        for(const RopeEditRun &run : last->runs)
+            _edit_run_push(&edit, run);
+        edit.text += last->text;
+        last->text.swap(edit.text);
+        last->runs.swap(edit.runs);
+        last->index = edit.index;
+    }else{
+        return false;
+    }
+    last->length += edit.length;
+    return true;
+}
+
+/*
+    adds the edit, dropping everything that could be redone
+*/
+void _journal_push(RopeJournal *journal, RopeEdit edit){
+    while(journal->edits.size() > journal->applied){
+        journal->bytes -= _edit_bytes(journal->edits.back());
+        journal->edits.pop_back();
+    }
+    if(!journal->sealed && !journal->edits.empty()){
+        RopeEdit &last = journal->edits.back();
+        size_t last_bytes = _edit_bytes(last);
+        if(_edit_coalesce(&last, edit)){
+            journal->bytes += _edit_bytes(last) - last_bytes;
+            _journal_trim(journal);
+            return;
+        }
+    }
+    //the first edit of a group starts it, the rest join it
+    edit.joined = journal->joining && !journal->edits.empty();
+    journal->joining = journal->groups > 0;
+    journal->bytes += _edit_bytes(edit);
+    journal->edits.push_back(std::move(edit));
+    journal->applied = journal->edits.size();
+    journal->sealed = false;
+    _journal_trim(journal);
+}
+
+/*
+    drops oldest edits until the journal fits the budget
+*/
+void _journal_trim(RopeJournal *journal){
+    while(journal->bytes > journal->budget && !journal->edits.empty()){
+        journal->bytes -= _edit_bytes(journal->edits.front());
+        journal->edits.pop_front();
+        if(journal->applied > 0)
+            journal->applied--;
+        //what's left of a group it cut stands on it's own
+        if(!journal->edits.empty())
+            journal->edits.front().joined = false;
+    }
+}
+
+/*
+    inserts the edit text at it's index, run by run with their flags
+*/
+void _replay_insert(std::unique_ptr<RopeNode> &rope, const RopeEdit &edit){
+    std::unique_ptr<RopeNode> piece;
+    size_t offset = 0;
+    for(const RopeEditRun &run : edit.runs){
+        std::unique_ptr<RopeNode> run_rope = rope_build(edit.text.data() + offset, run.bytes, run.flags);
+        if(piece == nullptr)
+            piece = std::move(run_rope);
+        else
+            rope_append(piece.get(), std::move(run_rope));
+        offset += run.bytes;
+    }
+    if(piece == nullptr)
+        return;
+
+    if(edit.index == 0)
+        rope_prepend(rope.get(), std::move(piece));
+    else if(edit.index == rope->weight)
+        rope_append(rope.get(), std::move(piece));
+    else
+        rope_insert_at(rope.get(), edit.index - 1, std::move(piece));
+}
+
+/*
+    deletes the edit range,
+        from the start the rest of the rope becomes the rope
+*/
+void _replay_delete(std::unique_ptr<RopeNode> &rope, const RopeEdit &edit){
+    if(edit.index > 0){
+        rope_delete_at(rope.get(), edit.index - 1, edit.length);
+        return;
+    }
+    std::unique_ptr<RopeNode> right_side = rope_split_at(rope.get(), edit.length - 1);
+    if(right_side == nullptr)
+        right_side = rope_create_empty();
+    std::swap(rope, right_side);
+    rope_destroy(std::move(right_side));
+}
+
+/*
+    sets the edit flags again, or the flags each run had before
+*/
+void _replay_flags(std::unique_ptr<RopeNode> &rope, const RopeEdit &edit, bool undo){
+    if(!undo){
+        rope_insert_flag_at(rope.get(), edit.index, edit.length, edit.flags);
+        return;
+    }
+    size_t index = edit.index;
+    for(const RopeEditRun &run : edit.runs){
+        rope_insert_flag_at(rope.get(), index, run.weight, run.flags);
+        index += run.weight;
+    }
+}
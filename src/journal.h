@@ -0,0 +1,79 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+
+#include "rope.h"
+
+#include <memory>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+
+
+/*
+    edit journal;
+    every edit keeps the text and flags it inserted or removed, enough to replay it
+    either way without looking at the rope, so undo and redo are a single insert or delete.
+    Consecutive keystrokes are coalesced into one edit,
+    edits made inside a group are undone and redone together, as one,
+    oldest edits are dropped once the journal goes over its byte budget.
+    Journal indexes are the first codepoint of the edited range.
+*/
+inline const size_t                 JOURNAL_BUDGET          = 1024 * 1024;
+inline const size_t                 JOURNAL_COALESCE_MAX    = 64;//codepoints in a coalesced edit
+
+//edit kinds
+inline const uint8_t                EDIT_INSERT     = 0;
+inline const uint8_t                EDIT_DELETE     = 1;
+inline const uint8_t                EDIT_FLAGS      = 2;
+
+
+//text with the same flags, as it was in the rope
+struct RopeEditRun final{
+    std::uint32_t                               bytes;
+    std::uint32_t                               weight;
+    std::uint8_t                                flags;
+};
+
+struct RopeEdit final{
+    std::uint8_t                                kind;
+    std::uint8_t                                flags;//flags set by EDIT_FLAGS
+    std::size_t                                 index;
+    std::size_t                                 length;//codepoints
+    std::string                                 text;
+    std::vector<RopeEditRun>                    runs;//flags before the edit for EDIT_FLAGS
+    bool                                        joined;//undone and redone together with the edit before it
+};
+
+struct RopeJournal final{
+    std::deque<RopeEdit>                        edits;
+    std::size_t                                 applied;//edits before it can be undone, the rest redone
+    std::size_t                                 bytes;
+    std::size_t                                 budget;
+    bool                                        sealed;//next edit starts a new one
+    std::size_t                                 groups;//open groups, groups nest
+    bool                                        joining;//next edit joins the one before it
+
+    explicit RopeJournal(size_t budget = JOURNAL_BUDGET);
+
+    RopeJournal(const RopeJournal&) = delete;
+    RopeJournal& operator=(const RopeJournal&) = delete;
+};
+
+
+void                            journal_insert(RopeJournal*, RopeNode&, size_t, size_t);
+void                            journal_delete(RopeJournal*, RopeNode&, size_t, size_t);
+void                            journal_flags(RopeJournal*, RopeNode&, size_t, size_t, uint8_t);
+void                            journal_seal(RopeJournal*);
+void                            journal_group_begin(RopeJournal*);
+void                            journal_group_end(RopeJournal*);
+void                            journal_clear(RopeJournal*);
+void                            journal_budget_set(RopeJournal*, size_t);
+bool                            journal_can_undo(const RopeJournal&);
+bool                            journal_can_redo(const RopeJournal&);
+bool                            journal_undo(RopeJournal*, std::unique_ptr<RopeNode>&, size_t*);
+bool                            journal_redo(RopeJournal*, std::unique_ptr<RopeNode>&, size_t*);
+
+
+#endif
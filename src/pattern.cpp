@@ -0,0 +1,757 @@
+#include "pattern.h"
+#include <plog/Log.h>
+
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <cctype>
+
+
+//ast node kinds
+inline const uint8_t                AST_SET     = 0;
+inline const uint8_t                AST_CAT     = 1;
+inline const uint8_t                AST_ALT     = 2;
+inline const uint8_t                AST_STAR    = 3;
+inline const uint8_t                AST_PLUS    = 4;
+inline const uint8_t                AST_QUEST   = 5;
+
+struct _PatternAst final{
+    std::uint8_t                                kind;
+    std::bitset<PATTERN_SYMBOLS>                symbols;
+    std::vector<_PatternAst>                    children;
+};
+
+struct _PatternParser final{
+    const char                                  *pattern;
+    size_t                                      at;
+    bool                                        ok;
+};
+
+
+_PatternAst                                     _ast_set(std::bitset<PATTERN_SYMBOLS>);
+_PatternAst                                     _ast_range(uint16_t, uint16_t);
+_PatternAst                                     _ast_bytes(const char*, size_t);
+_PatternAst                                     _ast_any_multibyte();
+bool                                            _parse_fail(_PatternParser*, const char*);
+size_t                                          _parse_codepoint(_PatternParser*);
+bool                                            _parse_escape_class(char, std::bitset<PATTERN_SYMBOLS>*);
+_PatternAst                                     _parse_class(_PatternParser*);
+_PatternAst                                     _parse_atom(_PatternParser*);
+_PatternAst                                     _parse_repeat(_PatternParser*);
+_PatternAst                                     _parse_concat(_PatternParser*);
+_PatternAst                                     _parse_alt(_PatternParser*);
+int32_t                                         _nfa_add(std::vector<PatternNfaState>&, uint8_t);
+std::pair<int32_t, int32_t>                     _nfa_build(std::vector<PatternNfaState>&, const _PatternAst&, bool);
+void                                            _nfa_compile(std::vector<PatternNfaState>&, const _PatternAst&, bool);
+void                                            _closure(const std::vector<PatternNfaState>&, std::vector<int32_t>&);
+void                                            _dfa_reset(PatternDfa*, const std::vector<PatternNfaState>&, bool);
+int32_t                                         _dfa_state(PatternDfa*, std::vector<int32_t>);
+int32_t                                         _dfa_next(PatternDfa*, int32_t, uint16_t);
+int32_t                                         _dfa_entry(PatternDfa*, bool);
+bool                                            _dfa_dead(const PatternDfa&, int32_t);
+RopeNode*                                       _leaf_at(RopeNode&, size_t, size_t*);
+bool                                            _line_boundary(RopeNode&, size_t, size_t);
+size_t                                          _match_start(RopePattern*, RopeNode&, size_t, size_t, size_t);
+size_t                                          _match_end(RopePattern*, RopeNode&, size_t, size_t);
+
+
+PatternSearch::PatternSearch()
+: pattern{nullptr}, index{0}, floor{0}, restart{true}, done{true}
+{}
+
+
+/*
+    compiles the pattern, NULL if it's invalid or matches empty text
+*/
+std::unique_ptr<RopePattern> pattern_compile(const char *pattern){
+    if(pattern == nullptr){
+        PLOG_ERROR << "given pattern is NULL, aborted.";
+        return nullptr;
+    }
+    _PatternParser parser{pattern, 0, true};
+    _PatternAst ast = _parse_alt(&parser);
+    if(parser.ok && pattern[parser.at] != '\0')
+        _parse_fail(&parser, "unmatched )");
+    if(!parser.ok)
+        return nullptr;
+
+    std::unique_ptr<RopePattern> compiled = std::make_unique<RopePattern>();
+    _nfa_compile(compiled->forward, ast, false);
+    _nfa_compile(compiled->reverse, ast, true);
+    _dfa_reset(&compiled->scan, compiled->forward, true);
+    _dfa_reset(&compiled->extend, compiled->forward, false);
+    _dfa_reset(&compiled->back, compiled->reverse, false);
+    if(compiled->extend.accepting[_dfa_entry(&compiled->extend, false)]){
+        PLOG_ERROR << "pattern matches empty text, aborted. pattern : " << pattern;
+        return nullptr;
+    }
+    return compiled;
+}
+
+/*
+    starts searching from the codepoint index from
+*/
+void pattern_search_begin(PatternSearch *search, RopePattern *pattern, size_t from){
+    if(search == nullptr || pattern == nullptr){
+        PLOG_ERROR << "given search or pattern is NULL, aborted.";
+        return;
+    }
+    search->pattern = pattern;
+    search->index = search->floor = from;
+    search->state.clear();
+    search->restart = true;
+    search->done = false;
+}
+
+/*
+    scans at least budget bytes, stopping at a leaf end, appending matches found;
+        true once the whole rope is searched
+*/
+bool pattern_search_step(PatternSearch *search, RopeNode &rope, size_t budget, std::vector<RopeMatch> &matches){
+    if(search == nullptr || search->pattern == nullptr || search->done)
+        return true;
+    PatternDfa *dfa = &search->pattern->scan;
+    size_t total = rope_weight_total(rope);
+    size_t scanned = 0;
+    //a match restarts the scan after it, leaf iteration starts again there
+    while(search->index < total){
+        int32_t state;
+        if(search->restart){
+            state = _dfa_entry(dfa, false);
+            if(_line_boundary(rope, search->index, total))
+                state = _dfa_next(dfa, state, PATTERN_BOUNDARY);
+            search->restart = false;
+        }else{
+            state = _dfa_state(dfa, search->state);
+        }
+        size_t pos = search->index;
+        size_t matchEnd = 0;
+        bool matched = false;
+        RopeLeafIterator litrope(&rope, pos);
+        size_t local = litrope.local_start_index();
+        RopeNode *c;
+        while(!matched && (c = litrope.pop()) != nullptr){
+            if(c->text == nullptr || c->weight <= local){
+                local -= std::min(local, c->weight);
+                continue;
+            }
+            const unsigned char *text = (const unsigned char*)c->text.get();
+            size_t from = local > 0 ? rope_leaf_offset(*c, local) : 0;
+            local = 0;
+            for(size_t i=from;i<c->bytes;i++){
+                if((text[i] & 0xC0) != 0x80)
+                    pos++;
+                state = _dfa_next(dfa, state, text[i]);
+                if(dfa->accepting[state]){
+                    matched = true;
+                    matchEnd = pos;
+                    break;
+                }
+            }
+            if(matched)
+                break;
+            scanned += c->bytes - from;
+            if(has_flags(&c->flags, FLAG_NEW_LINE) || pos >= total){
+                state = _dfa_next(dfa, state, PATTERN_BOUNDARY);
+                if(dfa->accepting[state]){
+                    matched = true;
+                    matchEnd = pos;
+                    break;
+                }
+            }
+            if(scanned >= budget && pos < total){
+                search->index = pos;
+                search->state = dfa->sets[state];
+                return false;
+            }
+        }
+        if(!matched)
+            break;
+
+        size_t start = _match_start(search->pattern, rope, search->floor, matchEnd, total);
+        size_t end = _match_end(search->pattern, rope, start, total);
+        if(end > start){
+            matches.push_back({start, end - start});
+            search->index = search->floor = end;
+            search->restart = true;
+        }else{
+            //nothing but line boundaries, as ^$ on an empty line, scanning goes on from here
+            search->index = pos;
+            search->state = dfa->sets[state];
+        }
+    }
+    search->done = true;
+    return true;
+}
+
+/*
+    every match in the rope, searched in one go;
+        empty if the pattern is invalid
+*/
+std::vector<RopeMatch> rope_find_pattern(RopeNode &rope, const char *pattern){
+    std::vector<RopeMatch> matches;
+    std::unique_ptr<RopePattern> compiled = pattern_compile(pattern);
+    if(compiled == nullptr)
+        return matches;
+    PatternSearch search;
+    pattern_search_begin(&search, compiled.get(), 0);
+    while(!pattern_search_step(&search, rope, (size_t)-1, matches));
+    return matches;
+}
+
+
+/*
+    helper
+*/
+_PatternAst _ast_set(std::bitset<PATTERN_SYMBOLS> symbols){
+    _PatternAst ast;
+    ast.kind = AST_SET;
+    ast.symbols = symbols;
+    return ast;
+}
+
+/*
+    bytes from first to last, inclusive
+*/
+_PatternAst _ast_range(uint16_t first, uint16_t last){
+    std::bitset<PATTERN_SYMBOLS> symbols;
+    for(uint16_t b=first;b<=last;b++)
+        symbols.set(b);
+    return _ast_set(symbols);
+}
+
+/*
+    literal bytes, in order
+*/
+_PatternAst _ast_bytes(const char *bytes, size_t length){
+    _PatternAst ast;
+    ast.kind = AST_CAT;
+    for(size_t i=0;i<length;i++)
+        ast.children.push_back(_ast_range((unsigned char)bytes[i], (unsigned char)bytes[i]));
+    return ast;
+}
+
+/*
+    any codepoint of two, three or four bytes
+*/
+_PatternAst _ast_any_multibyte(){
+    _PatternAst ast;
+    ast.kind = AST_ALT;
+    for(uint16_t lead : {0xC2, 0xE0, 0xF0}){
+        _PatternAst sequence;
+        sequence.kind = AST_CAT;
+        sequence.children.push_back(_ast_range(lead, lead == 0xC2 ? 0xDF : lead == 0xE0 ? 0xEF : 0xF4));
+        size_t continuations = lead == 0xC2 ? 1 : lead == 0xE0 ? 2 : 3;
+        for(size_t i=0;i<continuations;i++)
+            sequence.children.push_back(_ast_range(0x80, 0xBF));
+        ast.children.push_back(std::move(sequence));
+    }
+    return ast;
+}
+
+/*
+    helper
+*/
+bool _parse_fail(_PatternParser *parser, const char *reason){
+    if(parser->ok)
+        PLOG_ERROR << reason << ", aborted. pattern : " << parser->pattern << " at : " << parser->at;
+    parser->ok = false;
+    return false;
+}
+
+/*
+    bytes in the codepoint at the parser position, 0 at the end or on invalid UTF-8
+*/
+size_t _parse_codepoint(_PatternParser *parser){
+    unsigned char lead = parser->pattern[parser->at];
+    size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+    for(size_t i=1;i<length;i++)
+        if(((unsigned char)parser->pattern[parser->at + i] & 0xC0) != 0x80)
+            return 0;
+    return lead == 0 ? 0 : length;
+}
+
+/*
+    \d \w \s as ASCII sets, false for any other letter
+*/
+bool _parse_escape_class(char escape, std::bitset<PATTERN_SYMBOLS> *symbols){
+    switch(escape){
+    case 'd':
+        for(char b='0';b<='9';b++) symbols->set(b);
+        return true;
+    case 'w':
+        for(char b='0';b<='9';b++) symbols->set(b);
+        for(char b='a';b<='z';b++) symbols->set(b);
+        for(char b='A';b<='Z';b++) symbols->set(b);
+        symbols->set('_');
+        return true;
+    case 's':
+        for(char b : {' ', '\t', '\r', '\n', '\f', '\v'}) symbols->set(b);
+        return true;
+    case 'n':
+        symbols->set('\n');
+        return true;
+    case 't':
+        symbols->set('\t');
+        return true;
+    }
+    return false;
+}
+
+/*
+    [...] after the opening bracket
+*/
+_PatternAst _parse_class(_PatternParser *parser){
+    _PatternAst ast;
+    ast.kind = AST_ALT;
+    std::bitset<PATTERN_SYMBOLS> ascii;
+    bool negated = parser->pattern[parser->at] == '^';
+    if(negated)
+        parser->at++;
+    bool first = true;
+    while(parser->ok && (parser->pattern[parser->at] != ']' || first)){
+        first = false;
+        char b = parser->pattern[parser->at];
+        if(b == '\0'){
+            _parse_fail(parser, "unterminated class");
+            break;
+        }
+        if(b == '\\'){
+            char escape = parser->pattern[parser->at + 1];
+            if(escape == '\0' || (std::isalnum((unsigned char)escape) && !_parse_escape_class(escape, &ascii))){
+                _parse_fail(parser, "unknown escape");
+                break;
+            }
+            if(!std::isalnum((unsigned char)escape))
+                ascii.set((unsigned char)escape);
+            parser->at += 2;
+            continue;
+        }
+        size_t length = _parse_codepoint(parser);
+        if(length == 0){
+            _parse_fail(parser, "invalid UTF-8");
+            break;
+        }
+        if(length > 1){
+            if(negated || parser->pattern[parser->at + length] == '-'){
+                _parse_fail(parser, "only ASCII ranges and negated classes are supported");
+                break;
+            }
+            ast.children.push_back(_ast_bytes(parser->pattern + parser->at, length));
+            parser->at += length;
+            continue;
+        }
+        unsigned char last = b;
+        parser->at++;
+        if(parser->pattern[parser->at] == '-' && parser->pattern[parser->at + 1] != ']' && parser->pattern[parser->at + 1] != '\0'){
+            last = parser->pattern[parser->at + 1];
+            if(last >= 0x80 || last < (unsigned char)b){
+                _parse_fail(parser, "invalid range");
+                break;
+            }
+            parser->at += 2;
+        }
+        for(unsigned member = (unsigned char)b;member <= last;member++)
+            ascii.set(member);
+    }
+    if(parser->ok)
+        parser->at++;
+    if(negated){
+        std::bitset<PATTERN_SYMBOLS> complement;
+        for(uint16_t b=0;b<0x80;b++)
+            if(!ascii[b])
+                complement.set(b);
+        ast.children.push_back(_ast_set(complement));
+        ast.children.push_back(_ast_any_multibyte());
+    }else{
+        ast.children.push_back(_ast_set(ascii));
+    }
+    return ast;
+}
+
+/*
+    single codepoint, class, group or anchor
+*/
+_PatternAst _parse_atom(_PatternParser *parser){
+    char b = parser->pattern[parser->at];
+    if(b == '('){
+        parser->at++;
+        _PatternAst ast = _parse_alt(parser);
+        if(parser->pattern[parser->at] != ')')
+            _parse_fail(parser, "unmatched (");
+        parser->at++;
+        return ast;
+    }
+    if(b == '['){
+        parser->at++;
+        return _parse_class(parser);
+    }
+    if(b == '.'){
+        parser->at++;
+        _PatternAst ast = _ast_any_multibyte();
+        ast.children.push_back(_ast_range(0x00, 0x7F));
+        return ast;
+    }
+    if(b == '^' || b == '$'){
+        parser->at++;
+        return _ast_range(PATTERN_BOUNDARY, PATTERN_BOUNDARY);
+    }
+    if(b == '*' || b == '+' || b == '?'){
+        _parse_fail(parser, "nothing to repeat");
+        return _PatternAst();
+    }
+    if(b == '\\'){
+        char escape = parser->pattern[parser->at + 1];
+        std::bitset<PATTERN_SYMBOLS> symbols;
+        if(escape == '\0' || (std::isalnum((unsigned char)escape) && !_parse_escape_class(escape, &symbols))){
+            _parse_fail(parser, "unknown escape");
+            return _PatternAst();
+        }
+        if(!std::isalnum((unsigned char)escape))
+            symbols.set((unsigned char)escape);
+        parser->at += 2;
+        return _ast_set(symbols);
+    }
+    size_t length = _parse_codepoint(parser);
+    if(length == 0){
+        _parse_fail(parser, "invalid UTF-8");
+        return _PatternAst();
+    }
+    parser->at += length;
+    return _ast_bytes(parser->pattern + parser->at - length, length);
+}
+
+/*
+    atom followed by any number of * + ?
+*/
+_PatternAst _parse_repeat(_PatternParser *parser){
+    _PatternAst ast = _parse_atom(parser);
+    while(parser->ok){
+        char b = parser->pattern[parser->at];
+        uint8_t kind = b == '*' ? AST_STAR : b == '+' ? AST_PLUS : b == '?' ? AST_QUEST : AST_SET;
+        if(kind == AST_SET)
+            break;
+        parser->at++;
+        _PatternAst repeat;
+        repeat.kind = kind;
+        repeat.children.push_back(std::move(ast));
+        ast = std::move(repeat);
+    }
+    return ast;
+}
+
+/*
+    helper
+*/
+_PatternAst _parse_concat(_PatternParser *parser){
+    _PatternAst ast;
+    ast.kind = AST_CAT;
+    while(parser->ok){
+        char b = parser->pattern[parser->at];
+        if(b == '\0' || b == '|' || b == ')')
+            break;
+        ast.children.push_back(_parse_repeat(parser));
+    }
+    return ast;
+}
+
+/*
+    helper
+*/
+_PatternAst _parse_alt(_PatternParser *parser){
+    _PatternAst ast;
+    ast.kind = AST_ALT;
+    ast.children.push_back(_parse_concat(parser));
+    while(parser->ok && parser->pattern[parser->at] == '|'){
+        parser->at++;
+        ast.children.push_back(_parse_concat(parser));
+    }
+    return ast;
+}
+
+/*
+    helper
+*/
+int32_t _nfa_add(std::vector<PatternNfaState> &nfa, uint8_t kind){
+    nfa.push_back({kind, std::bitset<PATTERN_SYMBOLS>(), -1, -1});
+    return (int32_t)nfa.size() - 1;
+}
+
+/*
+    thompson construction, returns the first state and an empty split left open at the end;
+        reversed, concatenations are built back to front, for feeding bytes backwards
+*/
+std::pair<int32_t, int32_t> _nfa_build(std::vector<PatternNfaState> &nfa, const _PatternAst &ast, bool reverse){
+    if(ast.kind == AST_SET){
+        int32_t first = _nfa_add(nfa, NFA_SET);
+        int32_t end = _nfa_add(nfa, NFA_SPLIT);
+        nfa[first].symbols = ast.symbols;
+        nfa[first].out = end;
+        return {first, end};
+    }
+    if(ast.kind == AST_CAT){
+        int32_t first = _nfa_add(nfa, NFA_SPLIT);
+        int32_t end = first;
+        for(size_t i=0;i<ast.children.size();i++){
+            const _PatternAst &child = ast.children[reverse ? ast.children.size() - 1 - i : i];
+            std::pair<int32_t, int32_t> part = _nfa_build(nfa, child, reverse);
+            nfa[end].out = part.first;
+            end = part.second;
+        }
+        return {first, end};
+    }
+    if(ast.kind == AST_ALT){
+        int32_t end = _nfa_add(nfa, NFA_SPLIT);
+        int32_t first = -1;
+        for(size_t i=ast.children.size();i-- > 0;){
+            std::pair<int32_t, int32_t> part = _nfa_build(nfa, ast.children[i], reverse);
+            nfa[part.second].out = end;
+            if(first == -1){
+                first = part.first;
+                continue;
+            }
+            int32_t split = _nfa_add(nfa, NFA_SPLIT);
+            nfa[split].out = part.first;
+            nfa[split].out1 = first;
+            first = split;
+        }
+        return {first, end};
+    }
+    //repeats
+    std::pair<int32_t, int32_t> part = _nfa_build(nfa, ast.children.front(), reverse);
+    int32_t end = _nfa_add(nfa, NFA_SPLIT);
+    int32_t split = _nfa_add(nfa, NFA_SPLIT);
+    nfa[split].out = part.first;
+    nfa[split].out1 = end;
+    if(ast.kind == AST_STAR){
+        nfa[part.second].out = split;
+        return {split, end};
+    }
+    if(ast.kind == AST_PLUS){
+        nfa[part.second].out = split;
+        return {part.first, end};
+    }
+    nfa[part.second].out = end;
+    return {split, end};
+}
+
+/*
+    whole pattern, the start state is 0
+*/
+void _nfa_compile(std::vector<PatternNfaState> &nfa, const _PatternAst &ast, bool reverse){
+    int32_t start = _nfa_add(nfa, NFA_SPLIT);
+    std::pair<int32_t, int32_t> part = _nfa_build(nfa, ast, reverse);
+    nfa[start].out = part.first;
+    nfa[part.second].out = _nfa_add(nfa, NFA_MATCH);
+}
+
+/*
+    follows splits, the set is left sorted with only consuming and match states
+*/
+void _closure(const std::vector<PatternNfaState> &nfa, std::vector<int32_t> &set){
+    std::vector<int32_t> stack(set);
+    std::vector<bool> seen(nfa.size(), false);
+    set.clear();
+    while(!stack.empty()){
+        int32_t state = stack.back();
+        stack.pop_back();
+        if(state < 0 || seen[state])
+            continue;
+        seen[state] = true;
+        if(nfa[state].kind == NFA_SPLIT){
+            stack.push_back(nfa[state].out1);
+            stack.push_back(nfa[state].out);
+        }else{
+            set.push_back(state);
+        }
+    }
+    std::sort(set.begin(), set.end());
+}
+
+/*
+    empty cache over the given nfa
+*/
+void _dfa_reset(PatternDfa *dfa, const std::vector<PatternNfaState> &nfa, bool unanchored){
+    dfa->nfa = &nfa;
+    dfa->start = {0};
+    _closure(nfa, dfa->start);
+    dfa->unanchored = unanchored;
+    dfa->ids.clear();
+    dfa->sets.clear();
+    dfa->next.clear();
+    dfa->accepting.clear();
+    dfa->flushes = 0;
+}
+
+/*
+    id of the state for the nfa set, added if new;
+        adding over PATTERN_DFA_MAX flushes the cache, earlier ids are gone
+*/
+int32_t _dfa_state(PatternDfa *dfa, std::vector<int32_t> set){
+    std::map<std::vector<int32_t>, int32_t>::iterator found = dfa->ids.find(set);
+    if(found != dfa->ids.end())
+        return found->second;
+    if(dfa->sets.size() >= PATTERN_DFA_MAX){
+        dfa->ids.clear();
+        dfa->sets.clear();
+        dfa->next.clear();
+        dfa->accepting.clear();
+        dfa->flushes++;
+    }
+    bool accepting = false;
+    for(int32_t state : set)
+        accepting |= (*dfa->nfa)[state].kind == NFA_MATCH;
+    int32_t id = (int32_t)dfa->sets.size();
+    dfa->ids.emplace(set, id);
+    dfa->sets.push_back(std::move(set));
+    dfa->next.emplace_back();
+    dfa->next.back().fill(-1);
+    dfa->accepting.push_back(accepting);
+    return id;
+}
+
+/*
+    state after consuming the symbol, computed once and cached
+*/
+int32_t _dfa_next(PatternDfa *dfa, int32_t id, uint16_t symbol){
+    int32_t cached = dfa->next[id][symbol];
+    if(cached >= 0)
+        return cached;
+    const std::vector<PatternNfaState> &nfa = *dfa->nfa;
+    std::vector<int32_t> set;
+    for(int32_t state : dfa->sets[id])
+        if(nfa[state].kind == NFA_SET && nfa[state].symbols[symbol])
+            set.push_back(nfa[state].out);
+    if(dfa->unanchored)
+        set.insert(set.end(), dfa->start.begin(), dfa->start.end());
+    _closure(nfa, set);
+    size_t flushes = dfa->flushes;
+    int32_t next = _dfa_state(dfa, std::move(set));
+    if(flushes == dfa->flushes)
+        dfa->next[id][symbol] = next;
+    return next;
+}
+
+/*
+    start state, with an optional line boundary consumed if at one
+*/
+int32_t _dfa_entry(PatternDfa *dfa, bool boundary){
+    if(!boundary)
+        return _dfa_state(dfa, dfa->start);
+    const std::vector<PatternNfaState> &nfa = *dfa->nfa;
+    std::vector<int32_t> set(dfa->start);
+    for(int32_t state : dfa->start)
+        if(nfa[state].kind == NFA_SET && nfa[state].symbols[PATTERN_BOUNDARY])
+            set.push_back(nfa[state].out);
+    _closure(nfa, set);
+    return _dfa_state(dfa, std::move(set));
+}
+
+bool _dfa_dead(const PatternDfa &dfa, int32_t id){
+    return dfa.sets[id].empty();
+}
+
+/*
+    leaf holding the codepoint at index, leafStart is set to it's first index
+*/
+RopeNode* _leaf_at(RopeNode &rope, size_t index, size_t *leafStart){
+    RopeLeafIterator litrope(&rope, index);
+    size_t local = litrope.local_start_index();
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        if(c->text == nullptr || c->weight <= local){
+            local -= std::min(local, c->weight);
+            continue;
+        }
+        *leafStart = index - local;
+        return c;
+    }
+    return nullptr;
+}
+
+/*
+    a line starts or ends between the codepoints at index - 1 and index,
+        text start and end included
+*/
+bool _line_boundary(RopeNode &rope, size_t index, size_t total){
+    if(index == 0 || index >= total)
+        return true;
+    size_t leafStart = 0;
+    RopeNode *c = _leaf_at(rope, index - 1, &leafStart);
+    return c != nullptr && leafStart + c->weight == index && has_flags(&c->flags, FLAG_NEW_LINE);
+}
+
+/*
+    leftmost start, not before floor, of a match ending at end;
+        bytes are fed backwards to the reverse dfa
+*/
+size_t _match_start(RopePattern *pattern, RopeNode &rope, size_t floor, size_t end, size_t total){
+    PatternDfa *dfa = &pattern->back;
+    int32_t state = _dfa_entry(dfa, _line_boundary(rope, end, total));
+    size_t pos = end, start = end;
+    while(pos > floor && !_dfa_dead(*dfa, state)){
+        size_t leafStart = 0;
+        RopeNode *c = _leaf_at(rope, pos - 1, &leafStart);
+        if(c == nullptr)
+            break;
+        const unsigned char *text = (const unsigned char*)c->text.get();
+        size_t first = rope_leaf_offset(*c, std::max(floor, leafStart) - leafStart);
+        for(size_t i=rope_leaf_offset(*c, pos - leafStart);i-- > first;){
+            state = _dfa_next(dfa, state, text[i]);
+            if((text[i] & 0xC0) != 0x80)
+                pos--;
+            if(_dfa_dead(*dfa, state))
+                break;
+            if(dfa->accepting[state])
+                start = pos;
+        }
+        if(_dfa_dead(*dfa, state))
+            break;
+        if(_line_boundary(rope, pos, total)){
+            state = _dfa_next(dfa, state, PATTERN_BOUNDARY);
+            if(dfa->accepting[state])
+                start = pos;
+        }
+    }
+    return start;
+}
+
+/*
+    longest match end from start
+*/
+size_t _match_end(RopePattern *pattern, RopeNode &rope, size_t start, size_t total){
+    PatternDfa *dfa = &pattern->extend;
+    int32_t state = _dfa_entry(dfa, _line_boundary(rope, start, total));
+    size_t pos = start, end = start;
+    RopeLeafIterator litrope(&rope, start);
+    size_t local = litrope.local_start_index();
+    RopeNode *c;
+    while(!_dfa_dead(*dfa, state) && (c = litrope.pop()) != nullptr){
+        if(c->text == nullptr || c->weight <= local){
+            local -= std::min(local, c->weight);
+            continue;
+        }
+        const unsigned char *text = (const unsigned char*)c->text.get();
+        size_t from = local > 0 ? rope_leaf_offset(*c, local) : 0;
+        local = 0;
+        for(size_t i=from;i<c->bytes;i++){
+            if((text[i] & 0xC0) != 0x80)
+                pos++;
+            state = _dfa_next(dfa, state, text[i]);
+            if(_dfa_dead(*dfa, state))
+                break;
+            if(dfa->accepting[state])
+                end = pos;
+        }
+        if(_dfa_dead(*dfa, state))
+            break;
+        if(has_flags(&c->flags, FLAG_NEW_LINE) || pos >= total){
+            state = _dfa_next(dfa, state, PATTERN_BOUNDARY);
+            if(dfa->accepting[state])
+                end = pos;
+        }
+    }
+    return end;
+}
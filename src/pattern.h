@@ -0,0 +1,103 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+
+#include "rope.h"
+
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <bitset>
+#include <array>
+#include <map>
+#include <vector>
+
+
+/*
+    pattern search over rope leaves;
+    a pattern is compiled to a byte level NFA, and run as a DFA built lazily, a state at a time,
+    so leaf bytes are fed straight to a transition table and nothing is copied out.
+    Lines are leaf flags, not characters, so line ends are fed as one more symbol, PATTERN_BOUNDARY;
+    ^ and $ match it, nothing else does, so matches never span lines.
+    Matches are found by where they end first, then extended as far left, and then as far right, as they go:
+        forward scan finds the earliest match end,
+        reverse DFA from it finds the leftmost start,
+        anchored DFA from that start finds the longest end.
+    Searching is resumable, pattern_search_step scans a budget of bytes and stops at a leaf end,
+    so a huge text can be searched over several frames.
+
+    Syntax: literals (UTF-8), . [] [^] * + ? | () ^ $, escapes \d \w \s \n \t and escaped punctuation;
+        classes take ASCII ranges and single non ASCII codepoints, negated ones only ASCII.
+*/
+inline const size_t                 PATTERN_SYMBOLS     = 257;//bytes and the line boundary
+inline const uint16_t               PATTERN_BOUNDARY    = 256;
+inline const size_t                 PATTERN_DFA_MAX     = 2048;//cached states, the cache is flushed over it
+inline const size_t                 PATTERN_STEP_BYTES  = 1024 * 1024;//bytes a frame step scans by default
+
+//nfa state kinds
+inline const uint8_t                NFA_SET     = 0;
+inline const uint8_t                NFA_SPLIT   = 1;
+inline const uint8_t                NFA_MATCH   = 2;
+
+
+struct PatternNfaState final{
+    std::uint8_t                                kind;
+    std::bitset<PATTERN_SYMBOLS>                symbols;//NFA_SET consumes one of these
+    std::int32_t                                out;
+    std::int32_t                                out1;//second NFA_SPLIT edge
+};
+
+//nfa states reachable without consuming, one set per dfa state
+struct PatternDfa final{
+    const std::vector<PatternNfaState>          *nfa;
+    std::vector<std::int32_t>                   start;
+    bool                                        unanchored;//start is added after every step
+    std::map<std::vector<std::int32_t>, std::int32_t>
+                                                ids;
+    std::vector<std::vector<std::int32_t>>      sets;
+    std::vector<std::array<std::int32_t, PATTERN_SYMBOLS>>
+                                                next;//-1 until computed
+    std::vector<bool>                           accepting;
+    std::size_t                                 flushes;
+};
+
+struct RopePattern final{
+    std::vector<PatternNfaState>                forward;
+    std::vector<PatternNfaState>                reverse;
+    PatternDfa                                  scan;//unanchored forward, match ends
+    PatternDfa                                  back;//anchored reverse, match starts
+    PatternDfa                                  extend;//anchored forward, longest match ends
+
+    RopePattern() = default;
+    RopePattern(const RopePattern&) = delete;
+    RopePattern& operator=(const RopePattern&) = delete;
+};
+
+//codepoint range, as insertFlagAtRange takes it
+struct RopeMatch final{
+    std::size_t                                 index;
+    std::size_t                                 length;
+
+    bool operator==(const RopeMatch &other) const {return index == other.index && length == other.length;}
+};
+
+//search in progress, valid until the rope is edited
+struct PatternSearch final{
+    RopePattern                                 *pattern;
+    std::size_t                                 index;//codepoint index the scan continues from
+    std::size_t                                 floor;//matches start at or after it, the last match end
+    std::vector<std::int32_t>                   state;//scan dfa state, as nfa states, survives cache flushes
+    bool                                        restart;//scan starts fresh at index
+    bool                                        done;
+
+    PatternSearch();
+};
+
+
+std::unique_ptr<RopePattern>    pattern_compile(const char *);
+void                            pattern_search_begin(PatternSearch*, RopePattern*, size_t);
+bool                            pattern_search_step(PatternSearch*, RopeNode&, size_t, std::vector<RopeMatch>&);
+std::vector<RopeMatch>          rope_find_pattern(RopeNode&, const char *);
+
+
+#endif
@@ -0,0 +1,449 @@
+#include "prope.h"
+#include "utf8.h"
+#include <plog/Log.h>
+
+
+#include <memory>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <vector>
+
+
+int                                             _pheight(const PRope&);
+PRope                                           _pleaf(const char*, size_t, RopeEffects);
+PRope                                           _pnode(const PRope&, const PRope&);
+PRope                                           _pbalance(const PRope&, const PRope&);
+PRope                                           _pjoin(const PRope&, const PRope&);
+void                                            _psplit(const PRope&, size_t, PRope&, PRope&);
+PRope                                           _pmerge(std::vector<PRope>&, size_t, size_t);
+PRope                                           _pflags_set(const PRope&, uint8_t);
+std::unique_ptr<RopeNode>                       _pthaw(const PRope&);
+
+
+PRopeNode::PRopeNode()
+: weight{0}, lines{0}, height{0}, ascii{true}, bytes{0}
+{}
+
+
+PRopeLeafIterator::PRopeLeafIterator(PRope rope, size_t start)
+: root{std::move(rope)}, depth{0}, current{nullptr}, localStartIndex{0}
+{
+    if(root == nullptr)
+        return;
+    if(start >= root->weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << start;
+        return;
+    }
+    //find leaf at index, keeping the path
+    const PRopeNode *node = root.get();
+    while(node->left != nullptr){
+        path[depth++] = node;
+        if(start < node->left->weight){
+            node = node->left.get();
+        }else{
+            start -= node->left->weight;
+            node = node->right.get();
+        }
+    }
+    localStartIndex = start;
+    current = node;
+}
+
+void PRopeLeafIterator::left_most(const PRopeNode *node){
+    while(node->left != nullptr){
+        path[depth++] = node;
+        node = node->left.get();
+    }
+    current = node;
+}
+
+const PRopeNode* PRopeLeafIterator::next(){
+    //climb while coming from the right
+    const PRopeNode *child = current;
+    while(depth > 0 && path[depth-1]->right.get() == child)
+        child = path[--depth];
+    if(depth == 0){
+        current = nullptr;
+        return nullptr;
+    }
+    left_most(path[depth-1]->right.get());
+    return current;
+}
+
+bool PRopeLeafIterator::hasNext(){
+    return current != nullptr;
+}
+
+const PRopeNode* PRopeLeafIterator::pop(){
+    const PRopeNode *c = current;
+    if(c != nullptr)
+        next();
+    return c;
+}
+
+size_t PRopeLeafIterator::local_start_index(){
+    return localStartIndex;
+}
+
+
+/*
+    creates persistent rope with the given text
+*/
+PRope prope_create(const char *text){
+    return prope_create(text, 0);
+}
+
+/*
+    creates persistent rope with the given text and flags,
+        cut in even leaves of at most MAX_WEIGHT codepoints;
+            empty text is the empty rope
+*/
+PRope prope_create(const char *text, RopeEffects effects){
+    if(text == nullptr){
+        PLOG_ERROR << "given text is NULL, aborted.";
+        return nullptr;
+    }
+    size_t b_length = strlen(text);
+    if(b_length == 0)
+        return nullptr;
+    const char *end = text + b_length;
+    size_t remaining = u_count(text, b_length);
+    size_t pieces = (remaining + MAX_WEIGHT - 1) / MAX_WEIGHT;
+
+    std::vector<PRope> leaves;
+    leaves.reserve(pieces);
+    for(size_t i=0;i<pieces;i++){
+        size_t weight = (remaining + (pieces - i) - 1) / (pieces - i);
+        size_t piece_length = (i+1 == pieces) ? (size_t)(end - text) : u_offset(text, end - text, weight);
+        RopeEffects piece_effects = effects;
+        //new line only after the last piece
+        if(i+1 < pieces)
+            piece_effects &= ~RopeEffects(FLAG_NEW_LINE);
+        leaves.push_back(_pleaf(text, piece_length, piece_effects));
+        text += piece_length;
+        remaining -= weight;
+    }
+    return _pmerge(leaves, 0, leaves.size()-1);
+}
+
+/*
+    persistent copy of a mutable rope, linear in its size;
+        later versions are derived from it by the persistent edits
+*/
+PRope prope_snapshot(const RopeNode &rope){
+    std::vector<PRope> leaves;
+    RopeLeafIterator litrope(const_cast<RopeNode*>(&rope));
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        if(c->text == nullptr || c->weight == 0)
+            continue;
+        leaves.push_back(_pleaf(c->text.get(), c->bytes, c->flags.effects));
+    }
+    if(leaves.empty())
+        return nullptr;
+    return _pmerge(leaves, 0, leaves.size()-1);
+}
+
+/*
+    mutable copy of a version, linear in its size
+*/
+std::unique_ptr<RopeNode> prope_thaw(const PRope &rope){
+    if(rope == nullptr)
+        return rope_create("");
+    return rope_concat(_pthaw(rope), std::unique_ptr<RopeNode>());
+}
+
+/*
+    concatenates two versions into a balanced one,
+        neither is changed
+*/
+PRope rope_concat(const PRope &left, const PRope &right){
+    return _pjoin(left, right);
+}
+
+/*
+    splits after the given index, the left side keeps the character at index;
+        on error returns the rope and an empty right side
+*/
+std::pair<PRope, PRope> rope_split_at(const PRope &rope, size_t index){
+    if(rope == nullptr || index >= rope->weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
+        return {rope, nullptr};
+    }
+    PRope left, right;
+    _psplit(rope, index, left, right);
+    return {left, right};
+}
+
+PRope rope_insert_at(const PRope &rope, size_t index, const char *text){
+    return rope_insert_at(rope, index, prope_create(text));
+}
+/*
+    returns a version with the given rope inserted after the given index
+*/
+PRope rope_insert_at(const PRope &rope, size_t index, const PRope &prope){
+    if(prope == nullptr){
+        PLOG_ERROR << "given rope is NULL or empty, aborted.";
+        return rope;
+    }
+    if(rope == nullptr)
+        return prope;
+    if(index >= rope->weight){
+        PLOG_ERROR << "given index is bigger than rope weight, aborted. index: " << index;
+        return rope;
+    }
+    PRope left, right;
+    _psplit(rope, index, left, right);
+    return _pjoin(_pjoin(left, prope), right);
+}
+
+/*
+    returns a version with the given flags set on the given range;
+        leaves in the range are copied, the rest is shared
+*/
+PRope rope_insert_flag_at(const PRope &rope, size_t index, size_t length, uint8_t flags){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return rope;
+    }else if(length == 0 || (index+length) > rope->weight){
+        PLOG_ERROR << "invalid index/length combination, aborted.";
+        return rope;
+    }
+    PRope before, range = rope, after;
+    if(index > 0)
+        _psplit(rope, index-1, before, range);
+    PRope middle;
+    _psplit(range, length-1, middle, after);
+    return _pjoin(_pjoin(before, _pflags_set(middle, flags)), after);
+}
+
+/*
+    returns a version without the given number of characters after the given index
+*/
+PRope rope_delete_at(const PRope &rope, size_t index, size_t length){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return rope;
+    }
+    if(length == 0 ||
+         index+length >= rope->weight){
+        PLOG_ERROR << "index/length combination invalid, aborted." << "index: " << index << " length: " << length;
+        return rope;
+    }
+    PRope left, rest, deleted, right;
+    _psplit(rope, index, left, rest);
+    _psplit(rest, length-1, deleted, right);
+    return _pjoin(left, right);
+}
+
+size_t rope_weight_total(const PRope &rope){
+    return rope != nullptr ? rope->weight : 0;
+}
+
+size_t rope_line_count(const PRope &rope){
+    return rope != nullptr ? rope->lines : 0;
+}
+
+size_t rope_height_measure(const PRope &rope){
+    if(rope == nullptr || rope->left == nullptr)
+        return 0;
+    return 1 + std::max(rope_height_measure(rope->left), rope_height_measure(rope->right));
+}
+
+/*
+    every node is AVL balanced, children heights differ by at most one
+*/
+bool rope_is_balanced(const PRope &rope){
+    if(rope == nullptr || rope->left == nullptr)
+        return true;
+    long left_height = static_cast<long>(rope_height_measure(rope->left));
+    long right_height = static_cast<long>(rope_height_measure(rope->right));
+    return std::abs(left_height - right_height) <= 1 &&
+        rope_is_balanced(rope->left) && rope_is_balanced(rope->right);
+}
+
+/*
+    returns leaf that contains character at the given index,
+        on error returns null
+*/
+const PRopeNode* rope_node_at_index(const PRope &rope, size_t index, size_t *local_index){
+    if(rope == nullptr || index >= rope->weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
+        return nullptr;
+    }
+    const PRopeNode *node = rope.get();
+    while(node->left != nullptr){
+        if(index < node->left->weight){
+            node = node->left.get();
+        }else{
+            index -= node->left->weight;
+            node = node->right.get();
+        }
+    }
+    if(local_index != nullptr)
+        *local_index = index;
+    return node;
+}
+
+/*
+    appends text in the codepoint range [begin, end) to the buffer;
+        returns bytes copied
+*/
+size_t rope_copy_to(const PRope &rope, size_t begin, size_t end, std::string &buffer){
+    size_t start_size = buffer.size();
+    end = std::min(end, rope_weight_total(rope));
+    if(begin >= end)
+        return 0;
+    buffer.reserve(start_size + end - begin);
+
+    PRopeLeafIterator litrope(rope, begin);
+    size_t skip = litrope.local_start_index(), remaining = end - begin;
+    const PRopeNode *c;
+    while(remaining > 0 && (c = litrope.pop()) != nullptr){
+        size_t take = std::min(c->weight - skip, remaining);
+        size_t from = c->ascii ? skip : u_offset(c->text.get(), c->bytes, skip);
+        size_t to = c->ascii ? skip + take : u_offset(c->text.get(), c->bytes, skip + take);
+        buffer.append(c->text.get() + from, to - from);
+        remaining -= take;
+        skip = 0;
+    }
+    return buffer.size() - start_size;
+}
+
+
+/*
+    helper
+*/
+int _pheight(const PRope &node){
+    return node != nullptr ? node->height : -1;
+}
+
+/*
+    new leaf with a copy of the given bytes
+*/
+PRope _pleaf(const char *text, size_t b_length, RopeEffects effects){
+    std::shared_ptr<PRopeNode> leaf = std::make_shared<PRopeNode>();
+    leaf->text = rope_text_copy(text, b_length);
+    leaf->bytes = (uint32_t)b_length;
+    leaf->weight = u_count(text, b_length);
+    leaf->ascii = leaf->weight == b_length;
+    leaf->effects = effects;
+    leaf->lines = (effects.to_ulong() & (uint64_t)FLAG_NEW_LINE) ? 1 : 0;
+    return leaf;
+}
+
+/*
+    new internal node over both children, as they are
+*/
+PRope _pnode(const PRope &left, const PRope &right){
+    std::shared_ptr<PRopeNode> node = std::make_shared<PRopeNode>();
+    node->left = left;
+    node->right = right;
+    node->weight = left->weight + right->weight;
+    node->lines = left->lines + right->lines;
+    node->height = 1 + std::max(left->height, right->height);
+    return node;
+}
+
+/*
+    node over children whose heights differ by at most two,
+        rotated back into AVL balance with new nodes
+*/
+PRope _pbalance(const PRope &left, const PRope &right){
+    int balance = _pheight(left) - _pheight(right);
+    if(balance > 1){
+        if(_pheight(left->left) >= _pheight(left->right))
+            return _pnode(left->left, _pnode(left->right, right));
+        return _pnode(_pnode(left->left, left->right->left), _pnode(left->right->right, right));
+    }else if(balance < -1){
+        if(_pheight(right->right) >= _pheight(right->left))
+            return _pnode(_pnode(left, right->left), right->right);
+        return _pnode(_pnode(left, right->left->left), _pnode(right->left->right, right->right));
+    }
+    return _pnode(left, right);
+}
+
+/*
+    concatenates two balanced versions into a balanced one;
+        goes down the taller one to the height of the other,
+            copying only that spine
+*/
+PRope _pjoin(const PRope &left, const PRope &right){
+    if(left == nullptr)
+        return right;
+    if(right == nullptr)
+        return left;
+    int left_height = left->height;
+    int right_height = right->height;
+    if(left_height > right_height + 1)
+        return _pbalance(left->left, _pjoin(left->right, right));
+    if(right_height > left_height + 1)
+        return _pbalance(_pjoin(left, right->left), right->right);
+    return _pnode(left, right);
+}
+
+/*
+    splits after the given index, both sides balanced;
+        joins telescope, O(log n) new nodes in total
+*/
+void _psplit(const PRope &rope, size_t index, PRope &left, PRope &right){
+    if(rope == nullptr){
+        left = right = nullptr;
+        return;
+    }
+    if(rope->left == nullptr){
+        if(index + 1 >= rope->weight){
+            left = rope;
+            right = nullptr;
+            return;
+        }
+        //new line goes to the right, other flags to both
+        size_t b_index = rope->ascii ? index+1 : u_offset(rope->text.get(), rope->bytes, index+1);
+        left = _pleaf(rope->text.get(), b_index, rope->effects & ~RopeEffects(FLAG_NEW_LINE));
+        right = _pleaf(rope->text.get() + b_index, rope->bytes - b_index, rope->effects);
+        return;
+    }
+    PRope side;
+    if(index < rope->left->weight){
+        _psplit(rope->left, index, left, side);
+        right = _pjoin(side, rope->right);
+    }else{
+        _psplit(rope->right, index - rope->left->weight, side, right);
+        left = _pjoin(rope->left, side);
+    }
+}
+
+/*
+    builds balanced tree out of the given leaves
+*/
+PRope _pmerge(std::vector<PRope> &leaves, size_t left, size_t right){
+    if(left == right)
+        return std::move(leaves[left]);
+    size_t mid = left + (right - left)/2;
+    return _pnode(_pmerge(leaves, left, mid), _pmerge(leaves, mid+1, right));
+}
+
+/*
+    copy of the subtree with the given flags on every leaf
+*/
+PRope _pflags_set(const PRope &rope, uint8_t flags){
+    if(rope == nullptr)
+        return nullptr;
+    if(rope->left == nullptr)
+        return _pleaf(rope->text.get(), rope->bytes, flags);
+    return _pnode(_pflags_set(rope->left, flags), _pflags_set(rope->right, flags));
+}
+
+/*
+    mutable copy of the subtree, same shape
+*/
+std::unique_ptr<RopeNode> _pthaw(const PRope &rope){
+    if(rope->left == nullptr){
+        std::unique_ptr<RopeNode> leaf = std::make_unique<RopeNode>();
+        rope_leaf_text_set(leaf.get(), rope->text.get(), rope->bytes);
+        leaf->flags.effects = rope->effects;
+        return leaf;
+    }
+    return rope_concat(_pthaw(rope->left), _pthaw(rope->right));
+}
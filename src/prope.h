@@ -0,0 +1,84 @@
+#ifndef PROPE_H
+#define PROPE_H
+
+
+#include "rope.h"
+
+#include <memory>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <bitset>
+
+
+/*
+    persistent rope;
+    nodes are immutable and shared between versions, an edit copies only the nodes
+    on the paths it touches and returns a new root, every older root stays a valid snapshot.
+    Keeping a version costs one reference, an edit O(log n) new nodes.
+    Unlike RopeNode, weight and lines count the whole subtree, an empty rope is nullptr.
+*/
+struct PRopeNode;
+
+using PRope = std::shared_ptr<const PRopeNode>;
+
+struct PRopeNode final{
+    RopeText                                    text;
+    std::size_t                                 weight;//codepoints in the subtree
+    std::size_t                                 lines;//new lines in the subtree
+    RopeEffects                              effects;
+    std::uint8_t                                height;//levels below the node, 0 for leaves
+    bool                                        ascii;
+    std::uint32_t                               bytes;//leaf text length in bytes
+
+    PRope                                       left;
+    PRope                                       right;
+
+    PRopeNode();
+
+    PRopeNode(const PRopeNode&) = delete;
+    PRopeNode& operator=(const PRopeNode&) = delete;
+};
+
+
+/*
+    walks the leaves of one version in order,
+        the version is held for as long as the iterator lives
+*/
+class PRopeLeafIterator{
+    PRope                                       root;
+    const PRopeNode                             *path[ROPE_PATH_MAX];
+    size_t                                      depth;
+    const PRopeNode                             *current;
+    size_t                                      localStartIndex;
+
+    void                                        left_most(const PRopeNode*);
+public:
+    explicit PRopeLeafIterator(PRope rope, size_t start = 0);
+
+    const PRopeNode*    next();
+    bool                hasNext();
+    const PRopeNode*    pop();
+    size_t              local_start_index();
+};
+
+
+PRope                           prope_create(const char*);
+PRope                           prope_create(const char*, RopeEffects);
+PRope                           prope_snapshot(const RopeNode&);
+std::unique_ptr<RopeNode>       prope_thaw(const PRope&);
+PRope                           rope_concat(const PRope&, const PRope&);
+std::pair<PRope, PRope>         rope_split_at(const PRope&, size_t);
+PRope                           rope_insert_at(const PRope&, size_t, const char*);
+PRope                           rope_insert_at(const PRope&, size_t, const PRope&);
+PRope                           rope_insert_flag_at(const PRope&, size_t, size_t, uint8_t);
+PRope                           rope_delete_at(const PRope&, size_t, size_t);
+size_t                          rope_weight_total(const PRope&);
+size_t                          rope_line_count(const PRope&);
+size_t                          rope_height_measure(const PRope&);
+bool                            rope_is_balanced(const PRope&);
+const PRopeNode*                rope_node_at_index(const PRope&, size_t, size_t*);
+size_t                          rope_copy_to(const PRope&, size_t, size_t, std::string&);
+
+
+#endif
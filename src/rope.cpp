@@ -1,4 +1,5 @@
 #include "rope.h"
+#include "utf8.h"
 #include <plog/Log.h>
 
 
@@ -8,6 +9,21 @@
 #include <algorithm>
 #include <sstream>
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ROPE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 /*
 
@@ -26,17 +42,553 @@
 void                                            _split_node(RopeNode*, size_t, std::unique_ptr<RopeNode> &, std::unique_ptr<RopeNode> &);
 std::vector<std::unique_ptr<RopeNode>>          _harvest(std::unique_ptr<RopeNode>);
 std::unique_ptr<RopeNode>                       _merge(std::vector<std::unique_ptr<RopeNode>>*, size_t, size_t);
+std::unique_ptr<RopeNode>                       _merge_parallel(std::vector<std::unique_ptr<RopeNode>>*, size_t, size_t);
+void                                            _merge_ranges(size_t, size_t, size_t, std::vector<std::pair<size_t, size_t>>*);
+void                                            _harvest_parallel(std::unique_ptr<RopeNode>, std::vector<std::unique_ptr<RopeNode>>*);
+void                                            _harvest_parts(std::unique_ptr<RopeNode>, size_t, std::vector<std::unique_ptr<RopeNode>>*);
 RopeNode*                                       _rope_node_at_index_trace_right(RopeNode &,size_t, std::stack<RopeNode*> *, size_t *);
-size_t                                          _rope_weight_measure_node(const RopeNode&);
+RopeNode*                                       _left_most_path(RopeNode*, RopeLeafIterator*);
+RopeNode*                                       _right_most_path(RopeNode*, RopeLeafIterator*);
+size_t                                          _leaf_lines(const RopeNode&);
+size_t                                          _leaf_weight_measure(const RopeNode&);
+size_t                                          _rope_lines_total(const RopeNode&);
+bool                                            _set_leaf_flags(RopeNode*, uint8_t);
+void                                            _height_set(RopeNode*);
+std::unique_ptr<RopeNode>                       _unwrap(std::unique_ptr<RopeNode>);
+void                                            _head_from_leaf(RopeNode*);
+std::unique_ptr<RopeNode>                       _build_text(const char*, size_t, RopeEffects);
+void                                            _build_pieces(const char*, const char*, size_t, size_t, size_t, size_t, RopeEffects, std::vector<std::unique_ptr<RopeNode>>*);
+void                                            _build_lines(const char*, size_t, bool, std::vector<std::unique_ptr<RopeNode>>&);
+void                                            _build_lines_parallel(const char*, size_t, bool, std::vector<std::unique_ptr<RopeNode>>&);
+std::unique_ptr<RopeNode>                       _build_join(std::unique_ptr<RopeNode>, std::vector<std::unique_ptr<RopeNode>>&);
+std::unique_ptr<RopeNode>                       _join(std::unique_ptr<RopeNode>, std::unique_ptr<RopeNode>);
+void                                            _split(std::unique_ptr<RopeNode>, size_t, std::unique_ptr<RopeNode>&, std::unique_ptr<RopeNode>&);
+std::unique_ptr<RopeNode>                       _delete_range(std::unique_ptr<RopeNode>, size_t, size_t, size_t, size_t, size_t*);
+size_t                                          _cut_leaf_range(RopeNode*, size_t, size_t);
+bool                                            _leaf_mergeable(const RopeNode&, const RopeNode&, size_t);
+void                                            _compact_leaves(std::vector<std::unique_ptr<RopeNode>>&);
+size_t                                          _leaf_block_bytes(const RopeNode&);
+bool                                            _leaf_inline(const RopeNode&);
+void                                            _leaf_text_copy(RopeNode*, const char*, size_t);
+
+/*
+    Rope Pool;
+    nodes and leaf text are carved out of slabs and recycled trough free lists instead of
+    going to the global heap for every node. Leaf text uses size classes, from 16 bytes up to 4KB,
+    with a single header byte in front of each block holding its class; bigger text goes to the heap,
+    short text stays inside the leaf node, behind a header byte of its own.
+    Destroyed ropes are not walked, their root is put on the garbage list and reclaimed lazily,
+    one node at a time, whenever the pool runs out of free blocks; so freeing a whole rope is O(1).
+    The garbage is bounded, once it holds more than GARBAGE_MAX_WEIGHT codepoints the destroy drains it.
+    Pools are per thread, slabs are never given back since nodes can outlive the thread that made them;
+    a thread drains it's pool on exit and retires it, the next thread to start adopts it with it's free lists.
+*/
+namespace{
+
+inline const size_t             POOL_SLAB_SIZE      = 64 * 1024;
+inline const size_t             POOL_ALIGN          = 8;//nodes and text need no more than pointer alignment
+inline const size_t             TEXT_CLASS_MIN      = 4;//2^4 = 16B
+inline const size_t             TEXT_CLASS_COUNT    = 9;//up to 2^12 = 4KB
+inline const uint8_t            TEXT_CLASS_HEAP     = 0xff;
+inline const uint8_t            TEXT_CLASS_INLINE   = 0xfe;
+inline const size_t             RECLAIM_TRIES       = 8;
+inline const size_t             GARBAGE_MAX_WEIGHT  = 1024 * 1024;//codepoints waiting in the garbage before destroy drains it
+
+struct PoolBlock{
+    PoolBlock                  *next;
+};
+
+struct RopePool final{
+    PoolBlock                  *freeNodes = nullptr;
+    PoolBlock                  *freeText[TEXT_CLASS_COUNT] = {};
+    char                       *slab = nullptr;
+    size_t                      slabLeft = 0;
+    std::vector<RopeNode*>      garbage;
+    size_t                      garbageWeight = 0;//codepoints in the garbage leaves
+};
+
+struct RopePools final{
+    std::mutex                  mutex;
+    std::vector<RopePool*>      retired;//pools of exited threads
+};
+
+struct PoolExit final{
+    ~PoolExit();
+};
+
+thread_local RopePool          *t_pool = nullptr;
+thread_local bool               t_poolExited = false;
+
+RopePools& _pools(){
+    //never destroyed, threads can still exit during static destruction
+    static RopePools *pools = new RopePools();
+    return *pools;
+}
+
+RopePool& _pool(){
+    if(t_pool != nullptr)
+        return *t_pool;
+    //nodes freed after the thread retired it's pool go to a new one that isn't retired again
+    if(t_poolExited){
+        t_pool = new RopePool();
+        return *t_pool;
+    }
+    {
+        RopePools &pools = _pools();
+        std::lock_guard<std::mutex> lock(pools.mutex);
+        if(!pools.retired.empty()){
+            t_pool = pools.retired.back();
+            pools.retired.pop_back();
+        }
+    }
+    if(t_pool == nullptr)
+        t_pool = new RopePool();
+    thread_local PoolExit exit;
+    (void)exit;
+    return *t_pool;
+}
+
+size_t _round_up(size_t size){
+    return (size + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+}
+
+void* _pool_carve(RopePool &pool, size_t size){
+    size = _round_up(size);
+    if(pool.slabLeft < size){
+        pool.slab = static_cast<char*>(::operator new(POOL_SLAB_SIZE));
+        pool.slabLeft = POOL_SLAB_SIZE;
+    }
+    void *block = pool.slab;
+    pool.slab += size;
+    pool.slabLeft -= size;
+    return block;
+}
+
+/*
+    takes one node from the garbage, hands it's children to the garbage
+        and gives it's memory, and text, back to the free lists
+*/
+bool _pool_reclaim(RopePool &pool){
+    if(pool.garbage.empty())
+        return false;
+
+    RopeNode *node = pool.garbage.back();
+    pool.garbage.pop_back();
+    if(node->left == nullptr && node->right == nullptr)
+        pool.garbageWeight -= std::min(pool.garbageWeight, node->weight);
+    if(node->left != nullptr)
+        pool.garbage.push_back(node->left.release());
+    if(node->right != nullptr)
+        pool.garbage.push_back(node->right.release());
+    delete node;
+    return true;
+}
+
+/*
+    reclaims the whole garbage;
+        returns number of nodes freed
+*/
+size_t _pool_drain(RopePool &pool){
+    size_t nodes = 0;
+    while(_pool_reclaim(pool))
+        nodes++;
+    pool.garbageWeight = 0;
+    return nodes;
+}
+
+/*
+    drains the pool of the exiting thread and hands it to the next thread that starts
+*/
+PoolExit::~PoolExit(){
+    RopePool *pool = t_pool;
+    if(pool == nullptr)
+        return;
+    _pool_drain(*pool);
+    t_pool = nullptr;
+    t_poolExited = true;
+    RopePools &pools = _pools();
+    std::lock_guard<std::mutex> lock(pools.mutex);
+    pools.retired.push_back(pool);
+}
+
+size_t _text_class(size_t size){
+    size_t cls = 0;
+    while((size_t(1) << (cls + TEXT_CLASS_MIN)) < size)
+        cls++;
+    return cls;
+}
+
+}
+
+/*
+    File Mappings;
+    mapped leaves point straight into a read-only file mapping instead of owning a text block.
+    Mapped text isn't NUL terminated, readers go by the leaf byte length.
+    Each mapping counts the leaves pointing into it, a mapped leaf keeps a pointer to it's mapping
+    in the inline text it doesn't use, so letting go of one is a single decrement, without a lookup;
+    the last one unmaps it, so a mapping lives exactly as long as some rope, split result or snapshot still shows it.
+    Text deleters never see mapped text, the leaf lets go of it itself.
+*/
+namespace{
+
+inline const size_t             MAP_BUILD_BYTES     = 4 * 1024 * 1024;//file indexed and merged at once while mapping
+
+struct RopeMapping final{
+    char                       *begin = nullptr;
+    size_t                      length = 0;
+    std::atomic<size_t>         leaves{1};//the build holds one until it's done
+};
+
+std::atomic<size_t>& _mappings_live(){
+    static std::atomic<size_t> live{0};
+    return live;
+}
+
+RopeMapping* _leaf_mapping(const RopeNode &leaf){
+    RopeMapping *mapping;
+    memcpy(&mapping, leaf.inlineText, sizeof(mapping));
+    return mapping;
+}
+
+void _leaf_mapping_set(RopeNode *leaf, RopeMapping *mapping){
+    memcpy(leaf->inlineText, &mapping, sizeof(mapping));
+}
+
+/*
+    drops a reference to the mapping, the last one unmaps it
+*/
+void _mapping_release(RopeMapping *mapping){
+    if(mapping->leaves.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+#ifdef ROPE_MMAP
+    munmap(mapping->begin, mapping->length);
+#endif
+    delete mapping;
+    _mappings_live().fetch_sub(1, std::memory_order_release);
+}
+
+/*
+    frees the leaf text, mapped text by dropping it's mapping reference
+*/
+void _leaf_text_free(RopeNode *leaf){
+    if(!leaf->mapped){
+        leaf->text.reset();
+        return;
+    }
+    leaf->mapped = false;
+    if(leaf->text == nullptr)
+        return;
+    RopeMapping *mapping = _leaf_mapping(*leaf);
+    leaf->text.release();
+    _mapping_release(mapping);
+}
+
+}
+
+/*
+    Rope Workers;
+    bulk builds and rebalances of big inputs cut their work in parts along the same splits the serial
+    build makes, build the parts on worker threads and join them on the calling thread,
+    so the tree comes out node for node the same as the serial one.
+    Workers are started on first use and live with the process, each with it's own pool;
+    one parallel section runs at a time, the calling thread works in it too.
+*/
+namespace{
+
+inline const size_t             PARALLEL_PARTS      = 4;//parts per thread, uneven ones even out
+inline const size_t             PARALLEL_MIN_BYTES  = 256 * 1024;//smallest text part worth a worker
+inline const size_t             PARALLEL_MIN_LEAVES = 4096;//smallest leaf range worth a worker
+
+struct RopeWorkers final{
+    std::mutex                          run;//one parallel section at a time
+    std::mutex                          mutex;
+    std::condition_variable             wake;
+    std::condition_variable             idle;
+    size_t                              started = 0;
+    size_t                              generation = 0;
+    size_t                              wanted = 0;//workers taking part in the current section
+    size_t                              pending = 0;//of them, not done yet
+    const std::function<void(size_t)>  *job = nullptr;
+    size_t                              jobs = 0;
+    std::atomic<size_t>                 next{0};
+    std::atomic<size_t>                 threads{std::max<size_t>(1, std::thread::hardware_concurrency())};
+};
+
+RopeWorkers& _workers(){
+    //never destroyed, workers wait on it until the process ends
+    static RopeWorkers *workers = new RopeWorkers();
+    return *workers;
+}
+
+/*
+    runs jobs of the current section until there are none left
+*/
+void _workers_drain(RopeWorkers &workers){
+    for(size_t i = workers.next.fetch_add(1);i < workers.jobs;i = workers.next.fetch_add(1))
+        (*workers.job)(i);
+}
+
+void _worker_loop(RopeWorkers *workers, size_t id, size_t seen){
+    std::unique_lock<std::mutex> lock(workers->mutex);
+    while(true){
+        workers->wake.wait(lock, [&](){ return workers->generation != seen; });
+        seen = workers->generation;
+        //fewer threads asked for, sits this one out
+        if(id >= workers->wanted)
+            continue;
+        lock.unlock();
+        _workers_drain(*workers);
+        lock.lock();
+        if(--workers->pending == 0)
+            workers->idle.notify_all();
+        //workers may sit idle for good, their garbage isn't left for the next section
+        lock.unlock();
+        rope_pool_trim();
+        lock.lock();
+    }
+}
+
+/*
+    runs job for every index below jobs, on the workers and the calling thread;
+        returns once all of them are done
+*/
+void _parallel_for(size_t jobs, const std::function<void(size_t)> &job){
+    RopeWorkers &workers = _workers();
+    size_t threads = std::min(workers.threads.load(), jobs);
+    if(threads < 2){
+        for(size_t i=0;i<jobs;i++)
+            job(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> run(workers.run);
+    std::unique_lock<std::mutex> lock(workers.mutex);
+    for(;workers.started < threads - 1;workers.started++)
+        std::thread(_worker_loop, &workers, workers.started, workers.generation).detach();
+    workers.job = &job;
+    workers.jobs = jobs;
+    workers.next = 0;
+    workers.wanted = threads - 1;
+    workers.pending = threads - 1;
+    workers.generation++;
+    lock.unlock();
+    workers.wake.notify_all();
+
+    _workers_drain(workers);
+    lock.lock();
+    workers.idle.wait(lock, [&](){ return workers.pending == 0; });
+    workers.job = nullptr;
+}
+
+/*
+    parts to cut work of the given size in, a power of two;
+        a few per thread, none smaller than the given minimum, 1 if it isn't worth it
+*/
+size_t _parallel_parts(size_t size, size_t minimum){
+    size_t threads = _workers().threads.load();
+    if(threads < 2)
+        return 1;
+    size_t parts = 1;
+    while(parts < threads * PARALLEL_PARTS && size / (parts * 2) >= minimum)
+        parts *= 2;
+    return parts;
+}
+
+}
+
+/*
+    threads bulk builds and rebalances use, the calling one included;
+        0 picks the hardware thread count, 1 keeps them serial
+*/
+void rope_build_threads_set(size_t threads){
+    if(threads == 0)
+        threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    _workers().threads = threads;
+}
+
+size_t rope_build_threads(){
+    return _workers().threads.load();
+}
+
+void* RopeNode::operator new(std::size_t size){
+    RopePool &pool = _pool();
+    if(pool.freeNodes == nullptr)
+        _pool_reclaim(pool);
+    if(pool.freeNodes != nullptr){
+        PoolBlock *block = pool.freeNodes;
+        pool.freeNodes = block->next;
+        return block;
+    }
+    return _pool_carve(pool, size);
+}
+
+void RopeNode::operator delete(void *node){
+    if(node == nullptr)
+        return;
+    RopePool &pool = _pool();
+    PoolBlock *block = static_cast<PoolBlock*>(node);
+    block->next = pool.freeNodes;
+    pool.freeNodes = block;
+}
+
+/*
+    allocates text block of at least size bytes
+*/
+RopeText rope_text_alloc(size_t size){
+    size_t total = size + 1;//class header
+    size_t cls = _text_class(total);
+    if(cls >= TEXT_CLASS_COUNT){
+        char *block = static_cast<char*>(::operator new(total));
+        block[0] = TEXT_CLASS_HEAP;
+        return RopeText(block + 1);
+    }
+
+    RopePool &pool = _pool();
+    for(size_t tries = 0;pool.freeText[cls] == nullptr && tries < RECLAIM_TRIES;tries++){
+        if(!_pool_reclaim(pool))
+            break;
+    }
+    char *block;
+    if(pool.freeText[cls] != nullptr){
+        block = reinterpret_cast<char*>(pool.freeText[cls]);
+        pool.freeText[cls] = pool.freeText[cls]->next;
+    }else{
+        block = static_cast<char*>(_pool_carve(pool, size_t(1) << (cls + TEXT_CLASS_MIN)));
+    }
+    block[0] = static_cast<char>(cls);
+    return RopeText(block + 1);
+}
+
+void RopeTextDeleter::operator()(char *text) const{
+    char *block = text - 1;
+    uint8_t cls = static_cast<uint8_t>(block[0]);
+    if(cls == TEXT_CLASS_INLINE)
+        return;
+    if(cls == TEXT_CLASS_HEAP){
+        ::operator delete(block);
+        return;
+    }
+    RopePool &pool = _pool();
+    PoolBlock *free = reinterpret_cast<PoolBlock*>(block);
+    free->next = pool.freeText[cls];
+    pool.freeText[cls] = free;
+}
+
+/*
+    copies given number of bytes into a new text block, null terminated
+*/
+RopeText rope_text_copy(const char *text, size_t b_length){
+    RopeText copy = rope_text_alloc(b_length + 1);
+    memcpy(copy.get(), text, b_length);
+    copy[b_length] = 0;
+    return copy;
+}
+
+/*
+    copies text into the leaf, caching its byte length and codepoint count
+*/
+void rope_leaf_text_set(RopeNode *leaf, const char *text, size_t b_length){
+    _leaf_text_copy(leaf, text, b_length);
+    leaf->mapped = false;
+    leaf->bytes = (uint32_t)b_length;
+    leaf->weight = u_count(leaf->text.get(), b_length);
+    leaf->ascii = leaf->weight == b_length;
+}
+
+/*
+    byte offset of the codepoint at index in the leaf,
+        plain arithmetic for ascii leaves
+*/
+size_t rope_leaf_offset(const RopeNode &leaf, size_t index){
+    if(leaf.ascii)
+        return std::min<size_t>(index, leaf.bytes);
+    return u_offset(leaf.text.get(), leaf.bytes, index);
+}
+
+/*
+    true if the leaf text is kept inside the node
+*/
+bool _leaf_inline(const RopeNode &leaf){
+    return leaf.text.get() == leaf.inlineText + 1;
+}
+
+/*
+    copies text into the leaf, inside the node when it fits, null terminated;
+        text can be the leaf's own
+*/
+void _leaf_text_copy(RopeNode *leaf, const char *text, size_t b_length){
+    //text can point into the leaf's mapping, it's let go after the copy
+    RopeMapping *mapping = nullptr;
+    if(leaf->mapped && leaf->text != nullptr){
+        mapping = _leaf_mapping(*leaf);
+        leaf->text.release();
+    }
+    leaf->mapped = false;
+    if(b_length + 2 > RopePolicy::inlineText){
+        leaf->text = rope_text_copy(text, b_length);
+    }else{
+        memmove(leaf->inlineText + 1, text, b_length);
+        leaf->inlineText[b_length + 1] = 0;
+        if(!_leaf_inline(*leaf)){
+            leaf->inlineText[0] = static_cast<char>(TEXT_CLASS_INLINE);
+            leaf->text = RopeText(leaf->inlineText + 1);
+        }
+    }
+    if(mapping != nullptr)
+        _mapping_release(mapping);
+}
+
+/*
+    moves leaf text, weight and flags to a new node
+*/
+std::unique_ptr<RopeNode> _take_leaf(RopeNode *leaf){
+    std::unique_ptr<RopeNode> node = std::make_unique<RopeNode>();
+    //inline text can't change nodes by pointer
+    if(_leaf_inline(*leaf)){
+        _leaf_text_copy(node.get(), leaf->text.get(), leaf->bytes);
+        leaf->text.reset();
+    }else
+        node->text.swap(leaf->text);
+    //the mapping reference goes with the text
+    if(leaf->mapped)
+        _leaf_mapping_set(node.get(), _leaf_mapping(*leaf));
+    node->weight = leaf->weight;
+    node->bytes = leaf->bytes;
+    node->ascii = leaf->ascii;
+    node->mapped = leaf->mapped;
+    leaf->mapped = false;
+    std::swap(node->flags.effects, leaf->flags.effects);
+    return node;
+}
+
+/*
+    a bare leaf used as the head moves it's text to a new left child,
+        so head edits can work on the left side as with any other head;
+            an empty head, without text, stays as it is
+*/
+void _head_from_leaf(RopeNode *rope){
+    if(rope->left != nullptr || rope->right != nullptr || rope->text == nullptr)
+        return;
+    rope->left = _take_leaf(rope);
+    rope->bytes = 0;
+    rope->ascii = true;
+    rope->mapped = false;
+    rope->weight = rope->left->weight;
+    rope->lines = _leaf_lines(*(rope->left));
+    _height_set(rope);
+}
+
 
 RopeFlags::RopeFlags()
 : effects{0}
 {}
 
 RopeNode::RopeNode()
-: weight{0}, text{nullptr}, left{nullptr}, right{nullptr}
-{
-    this->flags = std::make_unique<RopeFlags>();
+: text{nullptr}, weight{0}, lines{0}, height{0}, ascii{true}, mapped{false}, bytes{0}, left{nullptr}, right{nullptr}
+{}
+
+RopeNode::~RopeNode(){
+    _leaf_text_free(this);
 }
 
 
@@ -92,14 +644,43 @@ RopeNode* RopeIteratorBFS::pop(){
     return prev;
 }
 
-RopeLeafIterator::RopeLeafIterator(RopeNode *rope, size_t start){
+RopeLeafIterator::RopeLeafIterator(RopeNode *rope, size_t start)
+: RopeLeafIterator(){
     if(rope == nullptr){
         PLOG_ERROR << "given rope is NULL, aborted.";
         return;
     }
-    //find node at index
-    localStartIndex = 0;
-    current = _rope_node_at_index_trace_right(*rope, start, &nodeStack, &localStartIndex);
+    root = rope;
+    //find node at index, stacking nodes only when moving left
+    current = rope;
+    size_t local = start;
+    bool leftMost = false;
+    while(current->left != nullptr || current->right != nullptr){
+        if(local == 0){
+            current = _left_most_path(current, this);
+            leftMost = true;
+            break;
+        }
+        if(local + 1 > current->weight){
+            if(current->right == nullptr){
+                PLOG_ERROR << "index bigger than weight but right node is null, aborted.";
+                current = nullptr;
+                return;
+            }
+            local -= current->weight;
+            current = current->right.get();
+        }else{
+            push(current);
+            current = current->left.get();
+        }
+    }
+    if(!leftMost && local + 1 > current->weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << local;
+        current = nullptr;
+        return;
+    }
+    localStartIndex = local;
+    index = start - local;
 }
 RopeNode* RopeLeafIterator::next(){
     if(!hasNext()){
@@ -107,22 +688,23 @@ RopeNode* RopeLeafIterator::next(){
         return nullptr;
     }
 
-    RopeNode *parent = nodeStack.top();
-    nodeStack.pop();
-    current = rope_left_most_node_trace(*(parent->right), &nodeStack);
+    index += current->weight;
+    if(deep){
+        current = rope_node_at_index(*root, index, nullptr);
+        return current;
+    }
+    RopeNode *parent = path[--depth];
+    current = _left_most_path(parent->right.get(), this);
     return current;
 }
 bool RopeLeafIterator::hasNext(){
-    bool has_right_child = false;
-    RopeNode *parent;
-    while(!nodeStack.empty() && !has_right_child){
-        parent = nodeStack.top();
-        nodeStack.pop();
-        has_right_child = parent->right != nullptr;
-    }
-    if(has_right_child)
-        nodeStack.push(parent);
-    return has_right_child;
+    if(current == nullptr)
+        return false;
+    if(deep)
+        return index + current->weight < rope_weight_total(*root);
+    while(depth > 0 && path[depth-1]->right == nullptr)
+        depth--;
+    return depth > 0;
 }
 RopeNode* RopeLeafIterator::pop(){
     if(!hasNext()){
@@ -134,15 +716,50 @@ RopeNode* RopeLeafIterator::pop(){
     next();
     return prev;
 }
+void RopeLeafIterator::push(RopeNode *node){
+    if(depth == ROPE_PATH_MAX){
+        deep = true;
+        return;
+    }
+    path[depth++] = node;
+}
 
 RopeLeafIteratorBack::RopeLeafIteratorBack(RopeNode *rope, size_t start){
     if(rope == nullptr){
         PLOG_ERROR << "given rope is NULL, aborted.";
         return;
     }
-    //find node at index
-    localStartIndex = 0;
-    current = rope_node_at_index_trace(*rope, start, &nodeStack, &localStartIndex);
+    root = rope;
+    //find node at index, stacking nodes only when moving right
+    current = rope;
+    size_t local = start;
+    bool leftMost = false;
+    while(current->left != nullptr || current->right != nullptr){
+        if(local == 0){
+            current = rope_left_most_node(*current);
+            leftMost = true;
+            break;
+        }
+        if(local + 1 > current->weight){
+            if(current->right == nullptr){
+                PLOG_ERROR << "index bigger than weight but right node is null, aborted.";
+                current = nullptr;
+                return;
+            }
+            push(current);
+            local -= current->weight;
+            current = current->right.get();
+        }else{
+            current = current->left.get();
+        }
+    }
+    if(!leftMost && local + 1 > current->weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << local;
+        current = nullptr;
+        return;
+    }
+    localStartIndex = local;
+    index = start - local;
 }
 RopeNode* RopeLeafIteratorBack::next(){
     if(!hasNext()){
@@ -150,24 +767,25 @@ RopeNode* RopeLeafIteratorBack::next(){
         return nullptr;
     }
 
-    RopeNode *parent = nodeStack.top();
-    nodeStack.pop();
-    current = rope_node_at_index_trace(*(parent), parent->weight - 1, &nodeStack, NULL);
+    if(deep){
+        size_t local = 0;
+        current = rope_node_at_index(*root, index - 1, &local);
+        index = index - 1 - local;
+        return current;
+    }
+    RopeNode *parent = path[--depth];
+    current = _right_most_path(parent->left.get(), this);
+    index -= current->weight;
     return current;
 }
 bool RopeLeafIteratorBack::hasNext(){
-    bool has_left_child = false;
-    RopeNode *parent;
-    RopeNode *prev=current;
-    while(!nodeStack.empty() && !(has_left_child)){
-        parent = nodeStack.top();
-        nodeStack.pop();
-        has_left_child = parent->left != nullptr && (parent->left.get() != prev);
-        prev = parent;
-    }
-    if(has_left_child)
-        nodeStack.push(parent);
-    return has_left_child;
+    if(current == nullptr)
+        return false;
+    if(deep)
+        return index > 0;
+    while(depth > 0 && path[depth-1]->left == nullptr)
+        depth--;
+    return depth > 0;
 }
 RopeNode* RopeLeafIteratorBack::pop(){
     if(!hasNext()){
@@ -191,34 +809,11 @@ size_t ustrlen(const std::string &s){
 }
 
 size_t ustrlen(const char *s){
-    size_t count = 0;
-    const char *p = s;
-    while (*p != 0){
-        if ((*p & 0xc0) != 0x80)
-            ++count;
-        ++p;
-    }
-    return count;
+    return u_count(s, std::strlen(s));
 }
 
 size_t u_index_at(const char *s, size_t count){
-    const char *p = s;
-    size_t index = 0;
-
-    while (*p != 0 && count > 0){
-        //continunation
-        if((*p & 0xc0) != 0x80)
-            --count;
-        ++p;
-        index++;
-    }
-    //don't end on continuation bit
-    while((*p & 0xc0) == 0x80 && p != 0){
-        ++p;
-        index++;
-    }
-
-    return index;
+    return u_offset(s, std::strlen(s), count);
 }
 
 bool has_flags(RopeFlags *ropeFlags, const uint8_t flags){
@@ -243,84 +838,241 @@ std::unique_ptr<RopeNode> rope_create_node(const char* text){
 /*
     creates node with the given text and flags
 */
-std::unique_ptr<RopeNode> rope_create_node(const char* text, std::bitset<8> effects){
+std::unique_ptr<RopeNode> rope_create_node(const char* text, RopeEffects effects){
     if(text == nullptr){
         PLOG_ERROR << "given text is NULL, aborted.";
         return nullptr;
     }
-    std::unique_ptr<RopeNode> node = std::make_unique<RopeNode>();
-    //add text
-    node->text = std::make_unique<char[]>(strlen(text) + 1);
-    sprintf(node->text.get(), "%s", text);
-    node->weight = ustrlen(node->text.get());
-    //flags
-    node->flags->effects = effects;
-    //cut while too long
-    RopeNode *n  = node.get();
-    while(n->weight > MAX_WEIGHT){
-        _split_node(n, std::max((n->weight / 2), n->weight-MAX_WEIGHT), n->left, n->right);
-        n = n->left.get();
-    }
-
-    return std::move(node);
+    //cut if too long
+    return _build_text(text, strlen(text), effects);
 }
 
 /*
     creates rope with the given text
 */
 std::unique_ptr<RopeNode> rope_create(const char* text){
+    return rope_create(text, 0);
+}
+
+/*
+    creates rope with the given text and flags
+*/
+std::unique_ptr<RopeNode> rope_create(const char* text, RopeEffects effects){
     if(text == nullptr){
         PLOG_ERROR << "given text is NULL, aborted.";
         return nullptr;
     }
-    //create new rope, and it's left node
-    std::unique_ptr<RopeNode> rope = std::make_unique<RopeNode>();
-    rope->left = std::make_unique<RopeNode>();
-    RopeNode *n = rope->left.get();
-    //add text to the left node
-    rope->left->text = std::make_unique<char[]>(strlen(text)+1);
-    sprintf(rope->left->text.get(), "%s", text);
-    rope->weight = rope->left->weight = ustrlen(rope->left->text.get());
-
-    //cut while too long
-    while(n->weight > MAX_WEIGHT){
-        _split_node(n, std::max((n->weight / 2), n->weight-MAX_WEIGHT), n->left, n->right);
-        n = n->left.get();
-    }
-
-    return std::move(rope);
+    return rope_build(text, strlen(text), effects);
 }
 
 /*
-    creates rope with the given text and flags
+    creates rope out of the first b_length bytes of the buffer,
+        the buffer needn't be NUL terminated;
+            linear in the buffer size, leaves are cut and the tree is built in one pass
 */
-std::unique_ptr<RopeNode> rope_create(const char* text, std::bitset<8> effects){
+std::unique_ptr<RopeNode> rope_build(const char *text, size_t b_length, RopeEffects effects){
     if(text == nullptr){
         PLOG_ERROR << "given text is NULL, aborted.";
         return nullptr;
     }
-    //create new rope, and it's left node
+    //create new rope, and it's left subtree
     std::unique_ptr<RopeNode> rope = std::make_unique<RopeNode>();
-    rope->left = std::make_unique<RopeNode>();
-    RopeNode *n = rope->left.get();
-    //add text to the left node
-    rope->left->text = std::make_unique<char[]>(strlen(text)+1);
-    sprintf(rope->left->text.get(), "%s", text);
-    rope->weight = rope->left->weight = ustrlen(rope->left->text.get());
-    //flags to the left node
-    rope->left->flags->effects = effects;
+    rope->left = _build_text(text, b_length, effects);
+    rope->weight = rope_weight_total(*(rope->left));
+    rope->lines = _rope_lines_total(*(rope->left));
+    _height_set(rope.get());
 
-    //cut while too long
-    while(n->weight > MAX_WEIGHT){
-        _split_node(n, std::max((n->weight / 2), n->weight-MAX_WEIGHT), n->left, n->right);
-        n = n->left.get();
+    return std::move(rope);
+}
+
+/*
+    cuts lines of the buffer into leaves, new line flag after each line,
+        lines longer than MAX_WEIGHT are cut in even pieces;
+            mapped leaves point into the buffer, others get a copy;
+        a blank line holds a single space, a line needs a codepoint to be drawn and for the cursor to land on
+*/
+void _build_lines(const char *text, size_t b_length, bool mapped, std::vector<std::unique_ptr<RopeNode>> &leaves){
+    const char *end = text + b_length;
+    while(text < end){
+        const char *line_end = static_cast<const char*>(memchr(text, '\n', end - text));
+        bool new_line = line_end != nullptr;
+        if(!new_line)
+            line_end = end;
+        size_t remaining = u_count(text, line_end - text);
+        size_t pieces = std::max<size_t>(1, (remaining + MAX_WEIGHT - 1) / MAX_WEIGHT);
+        for(size_t i=0;i<pieces;i++){
+            size_t weight = (remaining + (pieces - i) - 1) / (pieces - i);
+            size_t piece_length = (i+1 == pieces) ? (size_t)(line_end - text) : u_offset(text, line_end - text, weight);
+            std::unique_ptr<RopeNode> piece = std::make_unique<RopeNode>();
+            if(piece_length == 0){
+                rope_leaf_text_set(piece.get(), " ", 1);
+            }else{
+                if(mapped){
+                    piece->text = RopeText(const_cast<char*>(text));
+                    piece->mapped = true;
+                }else
+                    _leaf_text_copy(piece.get(), text, piece_length);
+                piece->bytes = (uint32_t)piece_length;
+                piece->weight = weight;
+                piece->ascii = weight == piece_length;
+            }
+            if(new_line && i+1 == pieces)
+                piece->flags.effects |= FLAG_NEW_LINE;
+            leaves.push_back(std::move(piece));
+            text += piece_length;
+            remaining -= weight;
+        }
+        text = new_line ? line_end + 1 : line_end;
     }
+}
 
-    return std::move(rope);
+/*
+    _build_lines over big buffers, parts of whole lines are cut on the workers;
+        lines are cut on their own, so the leaves are the same as the serial ones
+*/
+void _build_lines_parallel(const char *text, size_t b_length, bool mapped, std::vector<std::unique_ptr<RopeNode>> &leaves){
+    size_t parts = _parallel_parts(b_length, PARALLEL_MIN_BYTES);
+    if(parts < 2){
+        _build_lines(text, b_length, mapped, leaves);
+        return;
+    }
+    const char *end = text + b_length;
+    std::vector<const char*> starts(parts + 1);
+    starts[0] = text;
+    starts[parts] = end;
+    for(size_t k=1;k<parts;k++){
+        const char *start = std::max(starts[k-1], text + k * (b_length / parts));
+        const char *line_end = static_cast<const char*>(memchr(start, '\n', end - start));
+        starts[k] = line_end == nullptr ? end : line_end + 1;
+    }
+    std::vector<std::vector<std::unique_ptr<RopeNode>>> built(parts);
+    _parallel_for(parts, [&](size_t k){
+        _build_lines(starts[k], starts[k+1] - starts[k], mapped, built[k]);
+    });
+    size_t count = leaves.size();
+    for(const std::vector<std::unique_ptr<RopeNode>> &part : built)
+        count += part.size();
+    leaves.reserve(count);
+    for(std::vector<std::unique_ptr<RopeNode>> &part : built)
+        std::move(part.begin(), part.end(), std::back_inserter(leaves));
+}
+
+/*
+    merges collected leaves and joins them to the end of the subtree
+*/
+std::unique_ptr<RopeNode> _build_join(std::unique_ptr<RopeNode> tree, std::vector<std::unique_ptr<RopeNode>> &leaves){
+    if(leaves.empty())
+        return tree;
+    std::unique_ptr<RopeNode> merged = _merge_parallel(&leaves, 0, leaves.size()-1);
+    leaves.clear();
+    if(tree == nullptr)
+        return merged;
+    return _join(std::move(tree), std::move(merged));
 }
 
 /*
-    destroys the given rope
+    creates rope out of the file, one leaf per line;
+        the file is mapped read-only and leaves point into the mapping,
+        edits split mapped leaves into ordinary ones, the file is never written.
+    Lines and codepoints are indexed in one streaming pass,
+        pages are let go behind it, so only viewed pages stay resident.
+    Without mmap the file is read into ordinary leaves; on error returns null
+*/
+std::unique_ptr<RopeNode> rope_map_file(const char *path){
+    if(path == nullptr){
+        PLOG_ERROR << "given path is NULL, aborted.";
+        return nullptr;
+    }
+    std::vector<std::unique_ptr<RopeNode>> leaves;
+    std::unique_ptr<RopeNode> tree;
+#ifdef ROPE_MMAP
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        PLOG_ERROR << "can't open file, aborted. path : " << path;
+        return nullptr;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        PLOG_ERROR << "can't stat file, aborted. path : " << path;
+        close(fd);
+        return nullptr;
+    }
+    size_t length = (size_t)info.st_size;
+    char *begin = nullptr;
+    if(length > 0){
+        void *map = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(map == MAP_FAILED){
+            PLOG_ERROR << "can't map file, aborted. path : " << path;
+            close(fd);
+            return nullptr;
+        }
+        begin = static_cast<char*>(map);
+    }
+    close(fd);
+
+    if(begin != nullptr){
+        RopeMapping *mapping = new RopeMapping();
+        mapping->begin = begin;
+        mapping->length = length;
+        _mappings_live().fetch_add(1, std::memory_order_release);
+        madvise(begin, length, MADV_SEQUENTIAL);
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        const char *text = begin, *end = begin + length;
+        size_t released = 0;
+        while(text < end){
+            //a batch of whole lines at a time
+            const char *batch_end = text + std::min<size_t>(MAP_BUILD_BYTES, end - text);
+            const char *line_end = static_cast<const char*>(memchr(batch_end, '\n', end - batch_end));
+            batch_end = line_end == nullptr ? end : line_end + 1;
+            _build_lines_parallel(text, batch_end - text, true, leaves);
+
+            size_t mapped_leaves = 0;
+            for(const std::unique_ptr<RopeNode> &leaf : leaves){
+                if(!leaf->mapped)
+                    continue;
+                _leaf_mapping_set(leaf.get(), mapping);
+                mapped_leaves++;
+            }
+            mapping->leaves.fetch_add(mapped_leaves, std::memory_order_relaxed);
+            tree = _build_join(std::move(tree), leaves);
+            //indexed pages are clean, the kernel refaults them from the file when viewed
+            size_t done = ((size_t)(batch_end - begin) / page) * page;
+            if(done > released){
+                madvise(begin + released, done - released, MADV_DONTNEED);
+                released = done;
+            }
+            text = batch_end;
+        }
+        madvise(begin, length, MADV_NORMAL);
+        //drop the build reference, unmaps if no leaf points into the file
+        _mapping_release(mapping);
+    }
+#else
+    std::ifstream file(path, std::ios::binary);
+    if(!file){
+        PLOG_ERROR << "can't open file, aborted. path : " << path;
+        return nullptr;
+    }
+    std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    _build_lines_parallel(buffer.data(), buffer.size(), false, leaves);
+    tree = _build_join(std::move(tree), leaves);
+#endif
+
+    std::unique_ptr<RopeNode> rope = std::make_unique<RopeNode>();
+    if(tree == nullptr)
+        tree = rope_create_node("");
+    rope->left = std::move(tree);
+    rope->weight = rope_weight_total(*(rope->left));
+    rope->lines = _rope_lines_total(*(rope->left));
+    _height_set(rope.get());
+    return rope;
+}
+
+/*
+    destroys the given rope;
+        hands it to the pool garbage, nodes are reclaimed lazily,
+            unless the garbage grew too big, then it's drained right away;
+        while a file is mapped it's drained right away too, so a closed file is unmapped at once
 */
 void rope_destroy(std::unique_ptr<RopeNode> rope){
     if(rope == nullptr){
@@ -328,22 +1080,21 @@ void rope_destroy(std::unique_ptr<RopeNode> rope){
         return;
     }
 
-    std::stack<RopeNode *> nodeStack;
-    RopeNode *n, *p;
-    n = rope_left_most_node_trace(*rope, &nodeStack);
-    while(!nodeStack.empty()){
-        p = nodeStack.top();
-        nodeStack.pop();
-        if(p->left != nullptr)
-            p->left.release();
-        if(p->right != nullptr){
-            n = rope_left_most_node_trace(*(p->right), &nodeStack);
-            //if left-most node has the right child
-            nodeStack.push(n);
-        }
-    }
-    if(rope->left != nullptr)
-        rope->left.release();
+    RopePool &pool = _pool();
+    //leaves and the head hold their own weight, the other nodes on the right spine that of their left subtree
+    for(RopeNode *node = rope.get();node != nullptr;node = node->right.get())
+        pool.garbageWeight += node->weight;
+    pool.garbage.push_back(rope.release());
+    if(pool.garbageWeight > GARBAGE_MAX_WEIGHT || _mappings_live().load(std::memory_order_acquire) > 0)
+        _pool_drain(pool);
+}
+
+/*
+    frees all ropes the calling thread destroyed and didn't reclaim yet;
+        returns number of nodes freed
+*/
+size_t rope_pool_trim(){
+    return _pool_drain(_pool());
 }
 
 std::unique_ptr<RopeNode> rope_concat(std::unique_ptr<RopeNode> left, const char *text){
@@ -358,7 +1109,9 @@ std::unique_ptr<RopeNode> rope_concat(std::unique_ptr<RopeNode> left,std::unique
     std::unique_ptr<RopeNode> rope = std::make_unique<RopeNode>();
     rope->left.swap(left);
     rope->right.swap(right);
-    rope->weight = rope_weight_measure(*(rope));
+    rope->weight = rope->left != nullptr ? rope_weight_total(*(rope->left)) : 0;
+    rope->lines = rope->left != nullptr ? _rope_lines_total(*(rope->left)) : 0;
+    _height_set(rope.get());
     return std::move(rope);
 }
 
@@ -367,44 +1120,24 @@ void rope_prepend(RopeNode *rope, const char *text){
 }
 /*
     connects the given rope before the beggining;
-        consumes the ownership of the given rope
+        keeps it balanced;
+            consumes the ownership of the given rope
 */
 void rope_prepend(RopeNode *rope,std::unique_ptr<RopeNode> prope){
     if(prope == nullptr || rope == nullptr || prope->weight == 0){
         PLOG_ERROR << "given rope is NULL or empty, aborted.";
         return;
     }
-    std::stack<RopeNode*> nodeStack;
-    uint16_t prope_weight = prope->weight;
-
-    //head
-    if(rope->left == nullptr)
-        rope->weight += prope_weight;
-    
-    //get left-most leaf
-    RopeNode *left_most = rope_left_most_node_trace(*rope, &nodeStack);
-    if(left_most == nullptr)
-        return;
+    size_t prope_weight = rope_weight_total(*prope);
+    size_t prope_lines = _rope_lines_total(*prope);
+    prope = _unwrap(std::move(prope));
+    _head_from_leaf(rope);
 
-    //prepend the given rope
-    left_most->left.swap(prope);
-    left_most->weight = prope_weight;
-
-    //push text to the new right node
-    left_most->right = left_most->text==nullptr?nullptr:rope_create_node(left_most->text.get());
-    left_most->text.release();
-
-    //move flags to the new right node
-    if(left_most->right != nullptr)
-        left_most->right->flags.swap(left_most->flags);
-
-    //go up the stack changing weight
-    RopeNode *current;
-    while(!nodeStack.empty()){
-        current = nodeStack.top();
-        current->weight += prope_weight;
-        nodeStack.pop();
-    }
+    //join in front of the left side
+    rope->left = _join(std::move(prope), std::move(rope->left));
+    rope->weight += prope_weight;
+    rope->lines += prope_lines;
+    _height_set(rope);
 }
 
 void rope_append(RopeNode *rope, const char *text){
@@ -412,6 +1145,7 @@ void rope_append(RopeNode *rope, const char *text){
 }
 /*
     connects the given rope to the end;
+        keeps it balanced;
             consumes the ownership of the given rope
 
 */
@@ -420,50 +1154,20 @@ void rope_append(RopeNode *rope,std::unique_ptr<RopeNode> prope){
         PLOG_ERROR << "given rope is NULL or empty, aborted.";
         return;
     }
+    size_t prope_weight = rope_weight_total(*prope);
+    size_t prope_lines = _rope_lines_total(*prope);
+    prope = _unwrap(std::move(prope));
+    _head_from_leaf(rope);
 
-    std::stack<RopeNode*> nodeStack;
-    size_t prope_weight = _rope_weight_measure_node(*prope);
-
-    //head
-    if(rope->right == nullptr)
+    //join after the right side, if there is one, otherwise after the left side
+    if(rope->right != nullptr){
+        rope->right = _join(std::move(rope->right), std::move(prope));
+    }else{
+        rope->left = _join(std::move(rope->left), std::move(prope));
         rope->weight += prope_weight;
-
-    //go left
-    if(rope->left != nullptr){
-        rope = rope->left.get();
-    }
-
-    //get right-most leaf
-    RopeNode *right_most = rope_right_most_node_trace(*rope, &nodeStack);
-    if(right_most == nullptr)
-        return;
-
-    //append the given rope
-    if(right_most->left == nullptr && right_most->text == nullptr)
-        right_most->left.swap(prope);
-    else
-        right_most->right.swap(prope);
-
-    //push text to the new left node
-    if(right_most->text != nullptr){
-        right_most->left = rope_create_node(right_most->text.get());
-        right_most->text.release();
-        //move flags to the created node
-        right_most->left->flags.swap(right_most->flags);
-    }
-
-    //go up the stack changing weight
-    RopeNode *current, *prev=right_most;
-    while(!nodeStack.empty()){
-        current = nodeStack.top();
-        //add weight only if the previous node is current nodes right childs
-        if(current->left != nullptr &&
-            current->left.get() == prev)
-            current->weight += prope_weight;
-        nodeStack.pop();
-        prev = current;
+        rope->lines += prope_lines;
     }
-    
+    _height_set(rope);
 }
 
 void rope_insert_at(RopeNode *rope, size_t index, const char *text){
@@ -509,32 +1213,24 @@ void rope_insert_flag_at(RopeNode *rope, size_t index, size_t length, uint8_t fl
     }
 
 
+    //split so the range starts and ends on leaf boundaries
+    std::unique_ptr<RopeNode> right_side;
+    if(index > 0 && (right_side = rope_split_at(rope, index-1)) != nullptr)
+        rope_append(rope, std::move(right_side));
+    if((right_side = rope_split_at(rope, (index+length)-1)) != nullptr)
+        rope_append(rope, std::move(right_side));
+
     RopeLeafIterator litrope(rope, index);
     RopeNode *c;
     size_t i=index;
-    while((c = litrope.pop()) != nullptr && i <= (index+length)-1){
-        if(i == index && litrope.local_start_index() > 0){//first one needs to be split,
-            std::unique_ptr<RopeNode> right_side = rope_split_at(rope, index);
-            if(right_side != nullptr){// right side (left_most) gets the flag
-                RopeNode *r_left_most = rope_left_most_node(*right_side); 
-                r_left_most->flags->effects = flags;
-                rope_append(rope, std::move(right_side));
-            }
-        }else if((i+c->weight) > (index+length)-1){//last one needs to be split,
-            std::unique_ptr<RopeNode> right_side = rope_split_at(rope, (index+length)-1);
-            RopeNode *left_side = rope_node_at_index(*rope, (index+length)-1, nullptr);
-            if(left_side != nullptr){// left side gets the flag
-                left_side->flags->effects = flags;
-            }
-            if(right_side != nullptr){
-                rope_append(rope, std::move(right_side));
-            }
-            break;
-        }else{
-            c->flags->effects = flags;
-        }
+    bool new_lines_changed = false;
+    while(i < index+length && (c = litrope.pop()) != nullptr){
+        new_lines_changed |= _set_leaf_flags(c, flags);
         i += c->weight;
     }
+    //leaves gained or lost new lines, recount
+    if(new_lines_changed)
+        rope_lines_measure_set(rope);
 }
 
 /*
@@ -550,11 +1246,38 @@ void rope_delete_at(RopeNode *rope, size_t index, size_t length){
         PLOG_ERROR << "index/length combination invalid, aborted." << "index: " << index << " length: " << length;
         return;
     }
-    std::unique_ptr<RopeNode> deleted_rope = rope_split_at(rope, index);
-    std::unique_ptr<RopeNode> right_side = rope_split_at(deleted_rope.get(), length-1);
+    _head_from_leaf(rope);
+    //codepoints [begin, end) go, head left side is rope->weight long
+    size_t begin = index + 1, end = index + 1 + length;
+    size_t total = rope_weight_total(*rope);
+    size_t total_lines = _rope_lines_total(*rope);
+    size_t left_weight = rope->weight, left_lines = rope->lines;
+    size_t removed = 0;
+    if(begin < left_weight){
+        rope->left = _delete_range(std::move(rope->left), begin, std::min(end, left_weight), left_weight, left_lines, &removed);
+        rope->weight -= std::min(end, left_weight) - begin;
+        rope->lines -= removed;
+    }
+    if(end > left_weight){
+        removed = 0;
+        rope->right = _delete_range(std::move(rope->right), std::max(begin, left_weight) - left_weight, end - left_weight,
+                                        total - left_weight, total_lines - left_lines, &removed);
+    }
+    //head keeps a left side
+    if(rope->left == nullptr && rope->right != nullptr){
+        rope->weight = total - length;
+        rope->lines = _rope_lines_total(*(rope->right));
+        rope->left = std::move(rope->right);
+    }
+    _height_set(rope);
+}
 
-    if(right_side != nullptr)
-        rope_append(rope, std::move(right_side));
+/*
+    codepoints in the leaf text,
+        byte length is cached so only non ascii leaves are scanned
+*/
+size_t _leaf_weight_measure(const RopeNode &leaf){
+    return leaf.ascii ? leaf.bytes : u_count(leaf.text.get(), leaf.bytes);
 }
 
 /*
@@ -567,7 +1290,7 @@ size_t rope_weight_measure(const RopeNode &rope){
     
     //head
     if (current_node->left == nullptr && current_node->right == nullptr) {
-        return current_node->text != nullptr ? ustrlen(current_node->text.get()) : 0;
+        return current_node->text != nullptr ? _leaf_weight_measure(*current_node) : 0;
     }
 
     //go left
@@ -585,78 +1308,207 @@ size_t rope_weight_measure(const RopeNode &rope){
         
         //leaf
         if (current_node->left == nullptr && current_node->right == nullptr) {
-            total_weight += current_node->text != nullptr ? ustrlen(current_node->text.get()) : 0;
+            total_weight += current_node->text != nullptr ? _leaf_weight_measure(*current_node) : 0;
         }
 
         current_node = current_node->right.get();
     }
-
-    return total_weight;
+
+    return total_weight;
+}
+
+/*
+    go trough tree measuring and setting actual weight,
+        returns total weight
+*/
+size_t rope_weight_measure_set(RopeNode *rope) {
+    if (rope == nullptr) {
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return 0;
+    }
+
+    size_t total_weight = 0;
+    std::stack<RopeNode*> node_stack;
+    node_stack.push(rope);
+
+    while (!node_stack.empty()) {
+        RopeNode* current_node = node_stack.top();
+        node_stack.pop();
+
+        if (current_node->left == nullptr && current_node->right == nullptr) {
+            current_node->weight = current_node->text != nullptr ? _leaf_weight_measure(*current_node) : 0;
+            total_weight += current_node->weight;
+        }
+        else {
+            if (current_node->left != nullptr) {
+                node_stack.push(current_node->left.get());
+            }
+            if (current_node->right != nullptr) {
+                node_stack.push(current_node->right.get());
+            }
+        }
+    }
+
+    return rope->weight;
+}
+
+/*
+    go trough tree counting new lines in left subtrees and setting them,
+        returns total number of new lines
+*/
+size_t rope_lines_measure_set(RopeNode *rope){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return 0;
+    }
+
+    //post-order, node is visited after both of it's subtrees
+    std::stack<std::pair<RopeNode*, bool>> nodeStack;
+    std::stack<size_t> totals;
+    nodeStack.push({rope, false});
+    while(!nodeStack.empty()){
+        std::pair<RopeNode*, bool> top = nodeStack.top();
+        nodeStack.pop();
+        RopeNode *current = top.first;
+
+        if(current->left == nullptr && current->right == nullptr){
+            totals.push(_leaf_lines(*current));
+        }else if(!top.second){
+            nodeStack.push({current, true});
+            if(current->right != nullptr)
+                nodeStack.push({current->right.get(), false});
+            if(current->left != nullptr)
+                nodeStack.push({current->left.get(), false});
+        }else{
+            size_t right_lines = 0;
+            if(current->right != nullptr){
+                right_lines = totals.top();
+                totals.pop();
+            }
+            current->lines = 0;
+            if(current->left != nullptr){
+                current->lines = totals.top();
+                totals.pop();
+            }
+            totals.push(current->lines + right_lines);
+        }
+    }
+
+    return totals.top();
+}
+
+/*
+    number of new lines in the given leaf
+*/
+size_t _leaf_lines(const RopeNode &leaf){
+    return (leaf.flags.effects.to_ulong() & (uint64_t)FLAG_NEW_LINE) ? 1 : 0;
+}
+
+/*
+    sets leaf flags,
+        returns true if leaf gained or lost new line
+*/
+bool _set_leaf_flags(RopeNode *leaf, uint8_t flags){
+    size_t lines = _leaf_lines(*leaf);
+    leaf->flags.effects = flags;
+    return lines != _leaf_lines(*leaf);
+}
+
+/*
+    total number of new lines in the given subtree,
+        only follows the right spine
+*/
+size_t _rope_lines_total(const RopeNode &rope){
+    size_t total = 0;
+    const RopeNode *current = &rope;
+    while(current->left != nullptr || current->right != nullptr){
+        total += current->lines;
+        if(current->right == nullptr)
+            return total;
+        current = current->right.get();
+    }
+    return total + _leaf_lines(*current);
 }
 
 /*
-    go trough tree measuring actual weight, including starting node;
-        kinda like making a new root node and starting from there...
+    total weight of the given subtree,
+        only follows the right spine
 */
-size_t _rope_weight_measure_node(const RopeNode &rope){
-    size_t total_weight = 0;
-    std::stack<const RopeNode*> node_stack;
-    const RopeNode* current_node = &rope;
-    
-    while (current_node != nullptr || !node_stack.empty()) {
-        //find left-most
-        while (current_node != nullptr) {
-            node_stack.push(current_node);
-            current_node = current_node->left.get();
-        }
-
-        current_node = node_stack.top();
-        node_stack.pop();
-        
-        //leaf
-        if (current_node->left == nullptr && current_node->right == nullptr) {
-            total_weight += current_node->text != nullptr ? ustrlen(current_node->text.get()) : 0;
-        }
-
-        current_node = current_node->right.get();
+size_t rope_weight_total(const RopeNode &rope){
+    size_t total = 0;
+    const RopeNode *current = &rope;
+    while(current->left != nullptr || current->right != nullptr){
+        total += current->weight;
+        if(current->right == nullptr)
+            return total;
+        current = current->right.get();
     }
+    return total + current->weight;
+}
 
-    return total_weight;
+/*
+    number of new lines in the rope
+*/
+size_t rope_line_count(const RopeNode &rope){
+    return _rope_lines_total(rope);
 }
 
 /*
-    go trough tree measuring and setting actual weight,
-        returns total weight
+    returns index of the first character of the given line,
+        line starts after the new line leaf that ends the previous one;
+            on error returns rope weight
 */
-size_t rope_weight_measure_set(RopeNode *rope) {
-    if (rope == nullptr) {
-        PLOG_ERROR << "given rope is NULL, aborted.";
+size_t rope_line_to_index(const RopeNode &rope, size_t line){
+    size_t index = 0;
+    const RopeNode *current = &rope;
+    if(line == 0)
         return 0;
-    }
 
-    size_t total_weight = 0;
-    std::stack<RopeNode*> node_stack;
-    node_stack.push(rope);
+    //find leaf ending the previous line
+    while(current->left != nullptr || current->right != nullptr){
+        if(line <= current->lines && current->left != nullptr){
+            current = current->left.get();
+        }else if(current->right != nullptr){
+            line -= current->lines;
+            index += current->weight;
+            current = current->right.get();
+        }else{
+            PLOG_ERROR << "line bigger than number of lines, aborted.";
+            return index + current->weight;
+        }
+    }
 
-    while (!node_stack.empty()) {
-        RopeNode* current_node = node_stack.top();
-        node_stack.pop();
+    if(line != _leaf_lines(*current)){
+        PLOG_ERROR << "line bigger than number of lines, aborted.";
+    }
+    return index + current->weight;
+}
 
-        if (current_node->left == nullptr && current_node->right == nullptr) {
-            current_node->weight = current_node->text != nullptr ? ustrlen(current_node->text.get()) : 0;
-            total_weight += current_node->weight;
-        }
-        else {
-            if (current_node->left != nullptr) {
-                node_stack.push(current_node->left.get());
-            }
-            if (current_node->right != nullptr) {
-                node_stack.push(current_node->right.get());
-            }
+/*
+    returns line of the character at the given index;
+        on error returns number of lines
+*/
+size_t rope_index_to_line(const RopeNode &rope, size_t index){
+    size_t line = 0;
+    const RopeNode *current = &rope;
+    while(current->left != nullptr || current->right != nullptr){
+        if(index < current->weight && current->left != nullptr){
+            current = current->left.get();
+        }else if(current->right != nullptr){
+            line += current->lines;
+            index -= current->weight;
+            current = current->right.get();
+        }else{
+            PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
+            return line + current->lines;
         }
     }
 
-    return rope->weight;
+    if(index >= current->weight){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
+        return line + _leaf_lines(*current);
+    }
+    return line;
 }
 
 /*
@@ -689,7 +1541,7 @@ bool rope_has_flag_at(RopeNode &rope, size_t index, size_t length, uint8_t flags
     RopeNode *c;
     size_t i=index;
     while((c = litrope.pop()) != nullptr && i < (index+length)){
-        if(!has_flags(c->flags.get(), flags))
+        if(!has_flags(&c->flags, flags))
             return false;
         i++;
     }
@@ -758,6 +1610,79 @@ std::unique_ptr<RopeNode> _merge(std::vector<std::unique_ptr<RopeNode>> *nodeVec
     return rope_concat(_merge(nodeVector, left, mid), _merge(nodeVector, mid+1, right));
 }
 
+/*
+    _merge over big leaf ranges, the subtrees below the top levels are merged on the workers;
+        ranges are cut where _merge cuts them, a power of two of them,
+            so merging the subtrees gives back the top levels, and the tree is the serial one
+*/
+std::unique_ptr<RopeNode> _merge_parallel(std::vector<std::unique_ptr<RopeNode>> *nodeVector, size_t left, size_t right){
+    size_t parts = _parallel_parts(right - left + 1, PARALLEL_MIN_LEAVES);
+    if(parts < 2)
+        return _merge(nodeVector, left, right);
+    std::vector<std::pair<size_t, size_t>> ranges;
+    ranges.reserve(parts);
+    _merge_ranges(left, right, parts, &ranges);
+    std::vector<std::unique_ptr<RopeNode>> subtrees(ranges.size());
+    _parallel_for(ranges.size(), [&](size_t i){
+        subtrees[i] = _merge(nodeVector, ranges[i].first, ranges[i].second);
+    });
+    return _merge(&subtrees, 0, subtrees.size()-1);
+}
+
+/*
+    helper
+*/
+void _merge_ranges(size_t left, size_t right, size_t parts, std::vector<std::pair<size_t, size_t>> *ranges){
+    if(parts < 2){
+        ranges->push_back({left, right});
+        return;
+    }
+    size_t mid = left + ((right - left)/2);
+    _merge_ranges(left, mid, parts/2, ranges);
+    _merge_ranges(mid+1, right, parts/2, ranges);
+}
+
+/*
+    _harvest over big ropes, the subtrees below the top levels are harvested on the workers;
+        leaves come out in the same order
+*/
+void _harvest_parallel(std::unique_ptr<RopeNode> rope, std::vector<std::unique_ptr<RopeNode>> *nodeVector){
+    //balanced subtrees have at most 2^height leaves
+    size_t parts = rope == nullptr ? 1 : _parallel_parts(size_t(1) << std::min<size_t>(rope->height, 48), PARALLEL_MIN_LEAVES);
+    if(parts < 2){
+        _harvest(std::move(rope), nodeVector);
+        return;
+    }
+    std::vector<std::unique_ptr<RopeNode>> subtrees;
+    subtrees.reserve(parts);
+    _harvest_parts(std::move(rope), parts, &subtrees);
+    std::vector<std::vector<std::unique_ptr<RopeNode>>> harvested(subtrees.size());
+    _parallel_for(subtrees.size(), [&](size_t i){
+        _harvest(std::move(subtrees[i]), &harvested[i]);
+    });
+    size_t count = nodeVector->size();
+    for(const std::vector<std::unique_ptr<RopeNode>> &part : harvested)
+        count += part.size();
+    nodeVector->reserve(count);
+    for(std::vector<std::unique_ptr<RopeNode>> &part : harvested)
+        std::move(part.begin(), part.end(), std::back_inserter(*nodeVector));
+}
+
+/*
+    collects subtrees parts levels down, in order, destroying the nodes above them
+*/
+void _harvest_parts(std::unique_ptr<RopeNode> rope, size_t parts, std::vector<std::unique_ptr<RopeNode>> *subtrees){
+    if(parts < 2 || (rope->left == nullptr && rope->right == nullptr)){
+        subtrees->push_back(std::move(rope));
+        return;
+    }
+    if(rope->left != nullptr)
+        _harvest_parts(std::move(rope->left), parts/2, subtrees);
+    if(rope->right != nullptr)
+        _harvest_parts(std::move(rope->right), parts/2, subtrees);
+    rope_destroy(std::move(rope));
+}
+
 /*
     collect all of the leaves, and build a new tree from the bottom up,
         on error return nullptr;
@@ -770,30 +1695,484 @@ std::unique_ptr<RopeNode> rope_rebalance(std::unique_ptr<RopeNode> rope){
     }
     std::vector<std::unique_ptr<RopeNode>> nodeVector;
     //collect leaves, destroy rope
-    _harvest(std::move(rope), &nodeVector);
+    _harvest_parallel(std::move(rope), &nodeVector);
     //merge collected leaves into a new balanced rope
-    std::unique_ptr<RopeNode> left_sub = _merge(&nodeVector,0, nodeVector.size()-1);
+    std::unique_ptr<RopeNode> left_sub = _merge_parallel(&nodeVector,0, nodeVector.size()-1);
     std::unique_ptr<RopeNode> right_sub;
     return std::move(rope_concat(std::move(left_sub), std::move(right_sub)));
 }
 
+size_t rope_compact(RopeNode *rope){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return 0;
+    }
+    return rope_compact(rope, 0, rope_weight_total(*rope));
+}
+/*
+    merges adjacent leaves with the same flags, up to MAX_WEIGHT codepoints,
+        in the leaves covering the codepoint range [begin, end);
+            those leaves are cut out, merged, rebuilt balanced and joined back, O(k + log n);
+                returns the number of leaves removed
+*/
+size_t rope_compact(RopeNode *rope, size_t begin, size_t end){
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return 0;
+    }
+    size_t total = rope_weight_total(*rope);
+    end = std::min(end, total);
+    if(begin >= end)
+        return 0;
+
+    //count first, most ranges have nothing to merge and are left alone
+    RopeLeafIterator litrope(rope, begin);
+    size_t first = begin - litrope.local_start_index(), last = first;
+    size_t removed = 0, run_weight = 0;
+    RopeNode *c, *previous = nullptr;
+    while(last < end && (c = litrope.pop()) != nullptr){
+        if(previous != nullptr && _leaf_mergeable(*previous, *c, run_weight)){
+            removed++;
+            run_weight += c->weight;
+        }else{
+            run_weight = c->weight;
+        }
+        previous = c;
+        last += c->weight;
+    }
+    if(removed == 0)
+        return 0;
+
+    std::unique_ptr<RopeNode> tree = (rope->left == nullptr && rope->right == nullptr) ?
+        _take_leaf(rope) : _join(std::move(rope->left), std::move(rope->right));
+    //range is on leaf boundaries, no leaf is cut
+    std::unique_ptr<RopeNode> before, range = std::move(tree), after;
+    if(first > 0){
+        std::unique_ptr<RopeNode> rest;
+        _split(std::move(range), first - 1, before, rest);
+        range = std::move(rest);
+    }
+    if(last < total){
+        std::unique_ptr<RopeNode> middle;
+        _split(std::move(range), last - first - 1, middle, after);
+        range = std::move(middle);
+    }
+
+    std::vector<std::unique_ptr<RopeNode>> nodeVector;
+    _harvest(std::move(range), &nodeVector);
+    _compact_leaves(nodeVector);
+    range = _merge(&nodeVector, 0, nodeVector.size()-1);
+
+    tree = _join(_join(std::move(before), std::move(range)), std::move(after));
+    rope->weight = total;
+    rope->lines = _rope_lines_total(*tree);
+    rope->left = std::move(tree);
+    _height_set(rope);
+    return removed;
+}
+
+/*
+    the next leaf can join a run of run_weight codepoints ending with the given leaf;
+        same flags and the run doesn't end a line, new line of the next leaf ends the merged one
+*/
+bool _leaf_mergeable(const RopeNode &leaf, const RopeNode &next, size_t run_weight){
+    if(leaf.text == nullptr || next.text == nullptr || _leaf_lines(leaf) > 0)
+        return false;
+    return leaf.flags.effects == (next.flags.effects & ~RopeEffects(FLAG_NEW_LINE)) &&
+                run_weight + next.weight <= MAX_WEIGHT;
+}
+
+/*
+    merges runs of mergeable leaves into their first leaf,
+        text of a run is copied once
+*/
+void _compact_leaves(std::vector<std::unique_ptr<RopeNode>> &leaves){
+    size_t out = 0;
+    std::string text;
+    for(size_t i=0;i<leaves.size();){
+        size_t j = i + 1, run_weight = leaves[i]->weight;
+        while(j < leaves.size() && _leaf_mergeable(*leaves[j-1], *leaves[j], run_weight))
+            run_weight += leaves[j++]->weight;
+        if(j - i > 1){
+            text.clear();
+            for(size_t k=i;k<j;k++)
+                text.append(leaves[k]->text.get(), leaves[k]->bytes);
+            rope_leaf_text_set(leaves[i].get(), text.data(), text.size());
+            leaves[i]->flags.effects = leaves[j-1]->flags.effects;
+            for(size_t k=i+1;k<j;k++)
+                rope_destroy(std::move(leaves[k]));
+        }
+        leaves[out++] = std::move(leaves[i]);
+        i = j;
+    }
+    leaves.resize(out);
+}
+
+/*
+    counts nodes, leaves and bytes in one walk, leaves in order so flag runs can be told apart;
+        O(n) in nodes, the walk stack is the only allocation
+*/
+RopeStats rope_stats(const RopeNode &rope){
+    RopeStats stats = {};
+    std::vector<std::pair<const RopeNode*, size_t>> stack;
+    stack.reserve(64);
+    stack.push_back({&rope, 0});
+    const RopeNode *previous = nullptr;
+    while(!stack.empty()){
+        const RopeNode *node = stack.back().first;
+        size_t depth = stack.back().second;
+        stack.pop_back();
+        stats.nodes++;
+        stats.overheadBytes += _round_up(sizeof(RopeNode));
+        stats.height = std::max(stats.height, depth);
+        if(node->left != nullptr || node->right != nullptr){
+            if(node->right != nullptr)
+                stack.push_back({node->right.get(), depth + 1});
+            if(node->left != nullptr)
+                stack.push_back({node->left.get(), depth + 1});
+            continue;
+        }
+        //leaf
+        stats.leaves++;
+        stats.fill[std::min(ROPE_STATS_FILL_BUCKETS - 1, node->weight * ROPE_STATS_FILL_BUCKETS / MAX_WEIGHT)]++;
+        if(node->text == nullptr)
+            continue;
+        stats.textBytes += node->bytes;
+        if(node->mapped)
+            stats.mappedBytes += node->bytes;
+        else
+            stats.overheadBytes += _leaf_block_bytes(*node) - node->bytes;
+        if(previous == nullptr ||
+            (previous->flags.effects & ~RopeEffects(FLAG_NEW_LINE)) != (node->flags.effects & ~RopeEffects(FLAG_NEW_LINE)))
+            stats.flagRuns++;
+        previous = node;
+    }
+    return stats;
+}
+
+/*
+    size of the block holding an owned leaf text, it's class is in the header byte in front of it;
+        heap blocks don't keep their size, text, NUL and header are counted;
+            inline text is part of the node, it takes no block
+*/
+size_t _leaf_block_bytes(const RopeNode &leaf){
+    uint8_t cls = static_cast<uint8_t>(leaf.text.get()[-1]);
+    if(cls == TEXT_CLASS_INLINE)
+        return leaf.bytes;
+    if(cls == TEXT_CLASS_HEAP)
+        return leaf.bytes + 2;
+    return size_t(1) << (cls + TEXT_CLASS_MIN);
+}
+
+/*
+    helper
+*/
+int _height(const std::unique_ptr<RopeNode> &node){
+    return node != nullptr ? node->height : -1;
+}
+
+/*
+    helper
+*/
+void _height_set(RopeNode *node){
+    int height = 1 + std::max(_height(node->left), _height(node->right));
+    //saturates, only ropes put together by hand get that tall
+    node->height = std::min(height, (int)UINT8_MAX);
+}
+
+/*
+    returns the only child of the rope head, or the rope itself
+*/
+std::unique_ptr<RopeNode> _unwrap(std::unique_ptr<RopeNode> rope){
+    if(rope->left != nullptr && rope->right == nullptr && rope->text == nullptr){
+        std::unique_ptr<RopeNode> left = std::move(rope->left);
+        rope_destroy(std::move(rope));
+        return left;
+    }
+    return rope;
+}
+
+/*
+    cuts text into even leaves of at most MAX_WEIGHT codepoints on UTF-8 boundaries,
+        straight from the source buffer, and builds the balanced subtree holding them;
+            a single leaf when the text is short.
+    Big text is counted and cut in parts on the workers, each part of the leaves
+    starting from the codepoint it's first leaf starts at
+*/
+std::unique_ptr<RopeNode> _build_text(const char *text, size_t b_length, RopeEffects effects){
+    const char *end = text + b_length;
+    size_t parts = _parallel_parts(b_length, PARALLEL_MIN_BYTES);
+    if(parts < 2){
+        size_t remaining = u_count(text, b_length);
+        size_t pieces = std::max<size_t>(1, (remaining + MAX_WEIGHT - 1) / MAX_WEIGHT);
+        std::vector<std::unique_ptr<RopeNode>> nodeVector(pieces);
+        _build_pieces(text, end, 0, pieces, pieces, remaining, effects, &nodeVector);
+        return _merge(&nodeVector, 0, nodeVector.size()-1);
+    }
+
+    //parts start on codepoint starts, counts are summed up to each part start
+    std::vector<const char*> starts(parts + 1);
+    std::vector<size_t> counts(parts + 1, 0);
+    starts[0] = text;
+    starts[parts] = end;
+    for(size_t k=1;k<parts;k++){
+        const char *start = std::max(starts[k-1], text + k * (b_length / parts));
+        while(start < end && (*start & 0xC0) == 0x80)
+            start++;
+        starts[k] = start;
+    }
+    _parallel_for(parts, [&](size_t k){
+        counts[k+1] = u_count(starts[k], starts[k+1] - starts[k]);
+    });
+    for(size_t k=0;k<parts;k++)
+        counts[k+1] += counts[k];
+
+    size_t total = counts[parts];
+    size_t pieces = std::max<size_t>(1, (total + MAX_WEIGHT - 1) / MAX_WEIGHT);
+    std::vector<std::unique_ptr<RopeNode>> nodeVector(pieces);
+    _parallel_for(parts, [&](size_t k){
+        size_t first = k * pieces / parts, last = (k+1) * pieces / parts;
+        if(first == last)
+            return;
+        //codepoint the first piece starts at, the first pieces take the remainder
+        size_t index = first * (total / pieces) + std::min(first, total % pieces);
+        size_t part = std::upper_bound(counts.begin(), counts.end(), index) - counts.begin() - 1;
+        const char *from = starts[part] + u_offset(starts[part], starts[part+1] - starts[part], index - counts[part]);
+        _build_pieces(from, end, first, last, pieces, total, effects, &nodeVector);
+    });
+
+    return _merge_parallel(&nodeVector, 0, nodeVector.size()-1);
+}
+
+/*
+    cuts leaves [first, last) of the text cut in pieces even leaves holding total codepoints,
+        text is where the first of them starts
+*/
+void _build_pieces(const char *text, const char *end, size_t first, size_t last, size_t pieces, size_t total, RopeEffects effects,
+                        std::vector<std::unique_ptr<RopeNode>> *nodeVector){
+    for(size_t i=first;i<last;i++){
+        //first pieces take the remainder
+        size_t weight = total / pieces + (i < total % pieces ? 1 : 0);
+        size_t piece_length = (i+1 == pieces) ? (size_t)(end - text) : u_offset(text, end - text, weight);
+        std::unique_ptr<RopeNode> piece = std::make_unique<RopeNode>();
+        _leaf_text_copy(piece.get(), text, piece_length);
+        piece->bytes = (uint32_t)piece_length;
+        piece->weight = weight;
+        piece->ascii = weight == piece_length;
+        piece->flags.effects = effects;
+        //new line only after the last piece
+        if(i+1 < pieces)
+            piece->flags.effects &= ~RopeEffects(FLAG_NEW_LINE);
+        (*nodeVector)[i] = std::move(piece);
+        text += piece_length;
+    }
+}
+
+/*
+    helper
+*/
+void _rotate_right(std::unique_ptr<RopeNode> &node){
+    std::unique_ptr<RopeNode> pivot = std::move(node->left);
+    //node keeps only the pivot's right side on the left
+    node->weight -= pivot->weight;
+    node->lines -= pivot->lines;
+    node->left = std::move(pivot->right);
+    _height_set(node.get());
+    pivot->right = std::move(node);
+    _height_set(pivot.get());
+    node = std::move(pivot);
+}
+
 /*
     helper
 */
-void _split_flags(RopeFlags *flags, RopeFlags *left, RopeFlags *right){
-    //new line goes to the right
-    if(flags->effects.to_ulong() & (uint64_t)FLAG_NEW_LINE){
-        flags->effects ^= FLAG_NEW_LINE;
-        right->effects |= FLAG_NEW_LINE;
+void _rotate_left(std::unique_ptr<RopeNode> &node){
+    std::unique_ptr<RopeNode> pivot = std::move(node->right);
+    //pivot's left side gets the node with it's left side
+    pivot->weight += node->weight;
+    pivot->lines += node->lines;
+    node->right = std::move(pivot->left);
+    _height_set(node.get());
+    pivot->left = std::move(node);
+    _height_set(pivot.get());
+    node = std::move(pivot);
+}
+
+/*
+    rotates the node back into AVL balance, children heights differ by at most one
+*/
+void _balance(std::unique_ptr<RopeNode> &node){
+    _height_set(node.get());
+    int balance = _height(node->left) - _height(node->right);
+    if(balance > 1){
+        if(_height(node->left->left) < _height(node->left->right) && node->left->right->height > 0)
+            _rotate_left(node->left);
+        _rotate_right(node);
+    }else if(balance < -1){
+        if(_height(node->right->right) < _height(node->right->left) && node->right->left->height > 0)
+            _rotate_right(node->right);
+        _rotate_left(node);
+    }
+}
+
+/*
+    concatenates two balanced ropes into a balanced one;
+        goes down the taller one to the height of the other,
+            joins there and rotates back into balance on the way up
+*/
+std::unique_ptr<RopeNode> _join(std::unique_ptr<RopeNode> left, std::unique_ptr<RopeNode> right){
+    if(left == nullptr)
+        return right;
+    if(right == nullptr)
+        return left;
+    int left_height = left->height;
+    int right_height = right->height;
+    if(std::abs(left_height - right_height) <= 1)
+        return rope_concat(std::move(left), std::move(right));
+
+    std::vector<std::unique_ptr<RopeNode>*> path;
+    std::unique_ptr<RopeNode> *slot;
+    if(left_height > right_height){
+        //down the right spine, weights stay the same
+        slot = &left;
+        while((*slot)->height > right_height + 1 && (*slot)->right != nullptr){
+            path.push_back(slot);
+            slot = &((*slot)->right);
+        }
+        *slot = rope_concat(std::move(*slot), std::move(right));
     }else{
-        //default:
-        //remove from node
-        //move to left and right
-        uint8_t fe = flags->effects.to_ulong();
-        flags->effects ^= fe;
-        left->effects   = fe;
-        right->effects  = fe;
+        //down the left spine, left sides grow by the joined rope
+        size_t left_weight = rope_weight_total(*left);
+        size_t left_lines = _rope_lines_total(*left);
+        slot = &right;
+        while((*slot)->height > left_height + 1 && (*slot)->left != nullptr){
+            path.push_back(slot);
+            (*slot)->weight += left_weight;
+            (*slot)->lines += left_lines;
+            slot = &((*slot)->left);
+        }
+        *slot = rope_concat(std::move(left), std::move(*slot));
+    }
+
+    for(auto it=path.rbegin();it != path.rend();it++)
+        _balance(**it);
+    return left_height > right_height ? std::move(left) : std::move(right);
+}
+
+/*
+    splits the rope after the given index, both sides balanced;
+        subtrees left and right of the path are joined back together bottom up
+*/
+void _split(std::unique_ptr<RopeNode> rope, size_t index, std::unique_ptr<RopeNode> &left, std::unique_ptr<RopeNode> &right){
+    std::vector<std::unique_ptr<RopeNode>> left_sides, right_sides;
+    std::unique_ptr<RopeNode> current = std::move(rope), next;
+    while(current->left != nullptr || current->right != nullptr){
+        if(index < current->weight && current->left != nullptr){
+            if(current->right != nullptr)
+                right_sides.push_back(std::move(current->right));
+            next = std::move(current->left);
+        }else{
+            if(current->left != nullptr)
+                left_sides.push_back(std::move(current->left));
+            index -= current->weight;
+            next = std::move(current->right);
+        }
+        current = std::move(next);
+    }
+
+    //split leaf, if index is not on the end
+    if(index + 1 < current->weight)
+        _split_node(current.get(), index, left, right);
+    else
+        left = std::move(current);
+
+    for(size_t i=left_sides.size();i-- > 0;)
+        left = _join(std::move(left_sides[i]), std::move(left));
+    for(size_t i=right_sides.size();i-- > 0;)
+        right = _join(std::move(right), std::move(right_sides[i]));
+}
+
+/*
+    removes codepoints [begin, end) of the subtree in place, returns what is left of it, balanced;
+        subtrees inside the range are dropped whole, only nodes on the paths to both ends are touched;
+            total and total_lines are the subtree totals, known from the parent,
+                new lines removed are added to lines_removed
+*/
+std::unique_ptr<RopeNode> _delete_range(std::unique_ptr<RopeNode> node, size_t begin, size_t end, size_t total, size_t total_lines, size_t *lines_removed){
+    if(node == nullptr || begin >= end)
+        return node;
+    if(begin == 0 && end >= total){
+        *lines_removed += total_lines;
+        rope_destroy(std::move(node));
+        return nullptr;
     }
+    if(node->left == nullptr && node->right == nullptr){
+        *lines_removed += _cut_leaf_range(node.get(), begin, end);
+        return node;
+    }
+
+    size_t left_weight = node->weight, left_lines = node->lines;
+    size_t removed = 0;
+    if(begin < left_weight){
+        node->left = _delete_range(std::move(node->left), begin, std::min(end, left_weight), left_weight, left_lines, &removed);
+        node->weight -= std::min(end, left_weight) - begin;
+        node->lines -= removed;
+        *lines_removed += removed;
+    }
+    if(end > left_weight){
+        removed = 0;
+        node->right = _delete_range(std::move(node->right), std::max(begin, left_weight) - left_weight, end - left_weight,
+                                        total - left_weight, total_lines - left_lines, &removed);
+        *lines_removed += removed;
+    }
+
+    //a side is gone, the other takes the node's place
+    if(node->left == nullptr || node->right == nullptr){
+        std::unique_ptr<RopeNode> child = std::move(node->left != nullptr ? node->left : node->right);
+        rope_destroy(std::move(node));
+        return child;
+    }
+    if(std::abs(_height(node->left) - _height(node->right)) <= 1){
+        _height_set(node.get());
+        return node;
+    }
+    //sides shrank unevenly, join them back into balance
+    std::unique_ptr<RopeNode> left = std::move(node->left);
+    std::unique_ptr<RopeNode> right = std::move(node->right);
+    rope_destroy(std::move(node));
+    return _join(std::move(left), std::move(right));
+}
+
+/*
+    removes codepoints [begin, end) from the leaf text, the rest stays one leaf;
+        the new line goes with the last codepoint, returns 1 if it was removed
+*/
+size_t _cut_leaf_range(RopeNode *leaf, size_t begin, size_t end){
+    size_t b_begin = rope_leaf_offset(*leaf, begin);
+    size_t b_end = rope_leaf_offset(*leaf, end);
+    std::string text;
+    text.reserve(leaf->bytes - (b_end - b_begin));
+    text.append(leaf->text.get(), b_begin);
+    text.append(leaf->text.get() + b_end, leaf->bytes - b_end);
+    bool removes_end = end >= leaf->weight;
+    rope_leaf_text_set(leaf, text.data(), text.size());
+    if(removes_end && _leaf_lines(*leaf) > 0){
+        leaf->flags.effects &= ~RopeEffects(FLAG_NEW_LINE);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+    helper
+*/
+void _split_flags(RopeFlags &flags, RopeFlags &left, RopeFlags &right){
+    //remove from node, move to left and right;
+    //new line only to the right, it ends the line after the leaf
+    RopeEffects fe = flags.effects;
+    flags.effects.reset();
+    left.effects   = fe & ~RopeEffects(FLAG_NEW_LINE);
+    right.effects  = fe;
 }
 
 
@@ -806,49 +2185,28 @@ void _split_node(RopeNode *node, size_t index, std::unique_ptr<RopeNode> &left,
         PLOG_ERROR << "given node not a leaf, aborted.";
         return;
     }
-    //length - measure number of unicode characters not bytes( as with strlen)
-    size_t length = ustrlen(node->text.get());
-    //length in bytes
-    size_t b_length = strlen(node->text.get());
-    //index from character to byte,
-    //  u_index_at takes index of the character and returns starting index of the first byte of that character
-    //  because we want to also include that character index, we send index + 1
-    size_t u_index = u_index_at(node->text.get(), index+1);
-    if(u_index > 0 && u_index > index){
-        //because we sent index+a to u_index_at now we must -- so that it will place it at the end of the character we want
-        u_index--;
-    }
-
-    if(u_index >= b_length){
+    //index from character to byte, end of the character at index
+    if(index >= node->weight){
         PLOG_ERROR << "index bigger than length, aborted. index : " << index;
         return;
     }
+    size_t b_index = rope_leaf_offset(*node, index+1);
 
     //new split nodes
     left = std::make_unique<RopeNode>();
     right = std::make_unique<RopeNode>();
 
     //left, up to index, including index
-    left->weight = index+1;
-    {    
-        //split text
-        left->text = std::make_unique<char []>(u_index + 2);//+2 - one for null terminating character, and one beacuse we are starting from 0
-        snprintf(left->text.get(), u_index + 2, "%s", node->text.get());//The generated string has a length of at most n-1    
-    }                                       
-
-    //right, from index                            
-    right->weight = (length) - left->weight;
-    {
-        //split text
-        right->text = std::make_unique<char []>((b_length - u_index) + 2);//+2 - one for null terminating character, and one beacuse we are starting from 0
-        snprintf(right->text.get(), (b_length - u_index) + 2, "%s", node->text.get() + u_index + 1);
-    }
+    rope_leaf_text_set(left.get(), node->text.get(), b_index);
+    //right, from index
+    rope_leaf_text_set(right.get(), node->text.get() + b_index, node->bytes - b_index);
 
     //split flags
-    _split_flags(node->flags.get(), left->flags.get(), right->flags.get());
+    _split_flags(node->flags, left->flags, right->flags);
     //delete text from parent; set weight to left childs weight; connect left child
-    node->text.release();
+    _leaf_text_free(node);
     node->weight = left->weight;
+    node->lines = _leaf_lines(*left);
 }
 
 
@@ -862,48 +2220,32 @@ std::unique_ptr<RopeNode> rope_split_at(RopeNode *rope,size_t index){
         PLOG_ERROR << "given rope is NULL, aborted.";
         return nullptr;
     }
-    std::unique_ptr<RopeNode> new_rope = rope_create_empty();
-    std::stack<RopeNode*> nodeStack;
-    size_t local_index = 0;
-    size_t removed_weight = 0;
-
-
-    RopeNode *leaf = _rope_node_at_index_trace_right(*rope, index, &nodeStack, &local_index);
-    if(leaf==nullptr)
+    size_t total = rope_weight_total(*rope);
+    if(index >= total){
+        PLOG_ERROR << "index bigger than weight, aborted. index : " << index;
         return nullptr;
-
-    //split leaf, if index is not on the end
-    if((leaf->weight - (local_index+1)) > 0){
-        std::unique_ptr<RopeNode> split_left, split_right;
-        _split_node(leaf, local_index, split_left, split_right);
-        leaf->left.swap(split_left);
-        if(split_right != nullptr){
-            new_rope->weight = split_right->weight;
-            removed_weight = new_rope->weight;
-            new_rope->left.swap(split_right);
-        }
     }
+    //nothing on the right side
+    if(index + 1 == total)
+        return nullptr;
 
-    //backtrace nodeStack and split, changing weight
-    RopeNode *current;
-    while(!nodeStack.empty()){
-        current = nodeStack.top();
-        if(current == nullptr)
-            continue;
-
-        current->weight -= removed_weight;
-
-        if(current->right != nullptr){
-            removed_weight += _rope_weight_measure_node(*(current->right));
-            rope_append(new_rope.get(), std::move(current->right));
-        }
-
+    //single leaf becomes the head
+    std::unique_ptr<RopeNode> tree = (rope->left == nullptr && rope->right == nullptr) ?
+        _take_leaf(rope) : _join(std::move(rope->left), std::move(rope->right));
+    std::unique_ptr<RopeNode> left_side, right_side;
+    _split(std::move(tree), index, left_side, right_side);
 
-        nodeStack.pop();
-    }
+    rope->weight = rope_weight_total(*left_side);
+    rope->lines = _rope_lines_total(*left_side);
+    rope->left.swap(left_side);
+    _height_set(rope);
 
-    return new_rope->weight > 0 ? 
-        std::move(new_rope) : nullptr;
+    std::unique_ptr<RopeNode> new_rope = rope_create_empty();
+    new_rope->weight = rope_weight_total(*right_side);
+    new_rope->lines = _rope_lines_total(*right_side);
+    new_rope->left.swap(right_side);
+    _height_set(new_rope.get());
+    return std::move(new_rope);
 }
 
 /*
@@ -1051,6 +2393,31 @@ RopeNode* rope_node_at_index(RopeNode &rope,size_t index, size_t *local_index){
     return nullptr;
 }
 
+/*
+    left-most leaf below the node, pushing nodes on the way to the iterator path
+*/
+RopeNode* _left_most_path(RopeNode *node, RopeLeafIterator *iterator){
+    while(node->left != nullptr){
+        iterator->push(node);
+        node = node->left.get();
+    }
+    return node;
+}
+
+/*
+    right-most leaf below the node, pushing nodes on the way to the iterator path
+*/
+RopeNode* _right_most_path(RopeNode *node, RopeLeafIterator *iterator){
+    while(node->left != nullptr || node->right != nullptr){
+        if(node->right != nullptr){
+            iterator->push(node);
+            node = node->right.get();
+        }else
+            node = node->left.get();
+    }
+    return node;
+}
+
 /*
     returns left-most node in the given rope,
         putting nodes on the way in the stack,
@@ -1110,6 +2477,66 @@ RopeNode* rope_right_most_node(RopeNode &rope){
 
 
 
+RopeChunks::RopeChunks(RopeNode *rope, size_t begin, size_t end)
+: skip{0}, remaining{0}, done{true}{
+    if(rope == nullptr){
+        PLOG_ERROR << "given rope is NULL, aborted.";
+        return;
+    }
+    end = std::min(end, rope_weight_total(*rope));
+    if(begin >= end)
+        return;
+
+    leaves = RopeLeafIterator(rope, begin);
+    skip = leaves.local_start_index();
+    remaining = end - begin;
+    done = false;
+    advance();
+}
+
+void RopeChunks::advance(){
+    RopeNode *c;
+    while(remaining > 0 && (c = leaves.pop()) != nullptr){
+        if(c->text == nullptr || c->weight <= skip){
+            skip -= std::min(skip, c->weight);
+            continue;
+        }
+        size_t take = std::min(c->weight - skip, remaining);
+        size_t from = rope_leaf_offset(*c, skip);
+        size_t to = rope_leaf_offset(*c, skip + take);
+        chunk = std::string_view(c->text.get() + from, to - from);
+        remaining -= take;
+        skip = 0;
+        return;
+    }
+    chunk = std::string_view();
+    done = true;
+}
+
+/*
+    text in the codepoint range [begin, end) as leaf slices,
+        end is clamped to the rope weight
+*/
+RopeChunks rope_chunks(RopeNode &rope, size_t begin, size_t end){
+    return RopeChunks(&rope, begin, end);
+}
+
+/*
+    appends text in the codepoint range [begin, end) to the buffer,
+        reserved once up front, codepoints are a lower bound on bytes
+        and exact for ascii text; returns bytes copied
+*/
+size_t rope_copy_to(RopeNode &rope, size_t begin, size_t end, std::string &buffer){
+    size_t start_size = buffer.size();
+    size_t total = rope_weight_total(rope);
+    if(begin < end && begin < total)
+        buffer.reserve(start_size + std::min(end, total) - begin);
+    for(std::string_view chunk : rope_chunks(rope, begin, end))
+        buffer.append(chunk.data(), chunk.size());
+    return buffer.size() - start_size;
+}
+
+
 /*
     generates DOT for a given rope
 */
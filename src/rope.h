@@ -7,11 +7,45 @@
 #include <stack>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <bitset>
 
 
 
-inline const size_t                 MAX_WEIGHT = 512;
+/*
+    rope policy, fixed at compile time for the whole build;
+        ROPE_MAX_WEIGHT is the leaf capacity in codepoints, small leaves walk less text per edit,
+            big ones mean fewer nodes, less overhead and faster scans;
+        ROPE_FLAG_BITS the effect bits a leaf carries, flag arguments reach the first eight;
+        ROPE_INLINE_TEXT the bytes a leaf keeps inside the node, shorter text skips the text block.
+    Set trough the TERMIJA_ROPE_MAX_WEIGHT, TERMIJA_ROPE_FLAG_BITS and TERMIJA_ROPE_INLINE_TEXT cmake options,
+    bench/termija_bench_matrix compares leaf capacities.
+*/
+#ifndef ROPE_MAX_WEIGHT
+#define ROPE_MAX_WEIGHT 512
+#endif
+#ifndef ROPE_FLAG_BITS
+#define ROPE_FLAG_BITS 8
+#endif
+#ifndef ROPE_INLINE_TEXT
+#define ROPE_INLINE_TEXT 24
+#endif
+
+struct RopePolicy final{
+    static constexpr std::size_t                leafCapacity    = ROPE_MAX_WEIGHT;
+    static constexpr std::size_t                flagBits        = ROPE_FLAG_BITS;
+    static constexpr std::size_t                inlineText      = ROPE_INLINE_TEXT;
+
+    //leaf bytes are 32 bit, four per codepoint at most
+    static_assert(leafCapacity >= 1 && leafCapacity <= (1u << 28), "leaf capacity out of range");
+    //new line and invert, effects go trough to_ulong
+    static_assert(flagBits >= 2 && flagBits <= 64, "flag width out of range");
+    //header byte and NUL take two, mapped leaves keep a pointer to their mapping in it
+    static_assert(inlineText >= 2 && inlineText >= sizeof(void*) && inlineText <= 256, "inline text out of range");
+};
+
+inline const size_t                 MAX_WEIGHT = RopePolicy::leafCapacity;
+using RopeEffects                   = std::bitset<RopePolicy::flagBits>;
 
 
 //flags
@@ -20,8 +54,20 @@ inline const uint8_t                FLAG_INVERT     = 0b00000010;
 
 struct RopeNode;
 
+
+/*
+    leaf text is carved out of size-classed slabs,
+        the deleter hands the block back to its class free list;
+            mapped text never reaches it, the leaf lets go of it's mapping itself
+*/
+struct RopeTextDeleter{
+    void operator()(char *) const;
+};
+
+using RopeText = std::unique_ptr<char [], RopeTextDeleter>;
+
 struct RopeFlags final{
-    std::bitset<8>              effects;
+    RopeEffects              effects;
 
 
     RopeFlags();
@@ -31,18 +77,32 @@ struct RopeFlags final{
 };
 
 
+/*
+    leaves with short text keep it in the node, text then points into inlineText
+*/
 struct RopeNode final{
-    std::unique_ptr<char []>                    text;
+    RopeText                                    text;
     std::size_t                                 weight;
-    std::unique_ptr<RopeFlags>                  flags;
+    std::size_t                                 lines;//new lines in the left subtree, unused in leaves
+    RopeFlags                                   flags;
+    std::uint8_t                                height;//levels below the node, 0 for leaves
+    bool                                        ascii;//leaf text has no continuation bytes, codepoint index is the byte offset
+    bool                                        mapped;//leaf text points into a file mapping, not NUL terminated
+    std::uint32_t                               bytes;//leaf text length in bytes
+    char                                        inlineText[RopePolicy::inlineText];//header byte, text and NUL, leaves only; the mapping of mapped ones
 
     std::unique_ptr<RopeNode>                   left;
     std::unique_ptr<RopeNode>                   right;
 
     RopeNode();
+    ~RopeNode();
 
     RopeNode(const RopeNode&) = delete;
     RopeNode& operator=(const RopeNode&) = delete;
+
+    //nodes come from the rope pool, not from the global heap
+    static void*    operator new(std::size_t);
+    static void     operator delete(void *);
 };
 
 
@@ -71,19 +131,38 @@ public:
     RopeNode* pop() override final;
 };
 
-class RopeLeafIterator  :   public RopeIterator{
+/*
+    leaf iterators keep their path in a fixed inline array,
+        walking leaves never touches the heap and nothing is virtual;
+    balanced ropes stay far below ROPE_PATH_MAX levels,
+        a hand built deeper one is walked by index from the root instead
+*/
+inline const size_t                 ROPE_PATH_MAX = 96;
+
+class RopeLeafIterator{
 protected:
-    std::stack<RopeNode*>   nodeStack;
+    RopeNode                *current;
+    RopeNode                *root;
+    RopeNode                *path[ROPE_PATH_MAX];
+    size_t                  depth;
     size_t                  localStartIndex;
-    explicit                RopeLeafIterator() : localStartIndex{0}{}
-public:
+    size_t                  index;//start of the current leaf
+    bool                    deep;//path overflowed, walking by index
 
+    void                    push(RopeNode*);
+    friend RopeNode*        _left_most_path(RopeNode*, RopeLeafIterator*);
+    friend RopeNode*        _right_most_path(RopeNode*, RopeLeafIterator*);
+public:
+    //empty, pops nothing
+    explicit                RopeLeafIterator()
+                                : current{nullptr}, root{nullptr}, depth{0}, localStartIndex{0}, index{0}, deep{false}{}
 
     explicit RopeLeafIterator(RopeNode *rope, size_t start = 0);
 
-    RopeNode* next() override;
-    bool      hasNext() override;
-    RopeNode* pop() override;
+    RopeNode* get() const {return current;}
+    RopeNode* next();
+    bool      hasNext();
+    RopeNode* pop();
     size_t    local_start_index();
 };
 
@@ -91,9 +170,58 @@ class RopeLeafIteratorBack  :   public RopeLeafIterator{
 public:
     explicit RopeLeafIteratorBack(RopeNode *rope, size_t start = 0);
 
-    RopeNode* next() override final;
-    bool      hasNext() override final;
-    RopeNode* pop() override final;
+    RopeNode* next();
+    bool      hasNext();
+    RopeNode* pop();
+};
+
+
+/*
+    slices of leaf text covering a codepoint range, trimmed at both ends;
+        views point into the leaves and live until the rope is edited,
+        single pass, for(std::string_view chunk : rope_chunks(rope, begin, end))
+*/
+class RopeChunks{
+    RopeLeafIterator        leaves;
+    size_t                  skip;//codepoints to skip in the first leaf
+    size_t                  remaining;
+    std::string_view        chunk;
+    bool                    done;
+
+    void                    advance();
+public:
+    explicit RopeChunks(RopeNode *rope, size_t begin, size_t end);
+
+    class iterator{
+        RopeChunks          *chunks;
+    public:
+        explicit iterator(RopeChunks *chunks) : chunks{chunks}{}
+
+        std::string_view    operator*() const {return chunks->chunk;}
+        iterator&           operator++(){chunks->advance(); return *this;}
+        bool                operator!=(const iterator&) const {return !chunks->done;}
+    };
+
+    iterator begin(){return iterator(this);}
+    iterator end(){return iterator(this);}
+};
+
+
+/*
+    shape and memory of a rope, one walk over it's nodes and nothing allocated but the walk stack;
+        cheap enough to sample now and then, to decide when to compact or rebalance
+*/
+inline const size_t                 ROPE_STATS_FILL_BUCKETS = 8;
+
+struct RopeStats final{
+    std::size_t                                 nodes;//head included
+    std::size_t                                 leaves;
+    std::size_t                                 fill[ROPE_STATS_FILL_BUCKETS];//leaves by weight, in eighths of MAX_WEIGHT, full ones in the last
+    std::size_t                                 height;//measured, not the cached one
+    std::size_t                                 textBytes;//leaf text, mapped included
+    std::size_t                                 mappedBytes;//leaf text in file mappings, owned by no node
+    std::size_t                                 overheadBytes;//nodes and unused text block bytes
+    std::size_t                                 flagRuns;//runs of adjacent leaves with the same effects, new lines aside
 };
 
 
@@ -101,14 +229,21 @@ size_t                          ustrlen(const char *);
 size_t                          ustrlen(const std::string &);
 size_t                          u_index_at(const char *, size_t );
 bool                            has_flags(RopeFlags *, const uint8_t);
+RopeText                        rope_text_alloc(size_t);
+RopeText                        rope_text_copy(const char*, size_t);
+void                            rope_leaf_text_set(RopeNode*, const char*, size_t);
+size_t                          rope_leaf_offset(const RopeNode&, size_t);
 
 
 std::unique_ptr<RopeNode>       rope_create_empty();
 std::unique_ptr<RopeNode>       rope_create_node(const char*);
-std::unique_ptr<RopeNode>       rope_create_node(const char*, std::bitset<8>);
+std::unique_ptr<RopeNode>       rope_create_node(const char*, RopeEffects);
 std::unique_ptr<RopeNode>       rope_create(const char*);
-std::unique_ptr<RopeNode>       rope_create(const char*, std::bitset<8>);
+std::unique_ptr<RopeNode>       rope_create(const char*, RopeEffects);
+std::unique_ptr<RopeNode>       rope_build(const char*, size_t, RopeEffects);
+std::unique_ptr<RopeNode>       rope_map_file(const char*);
 void                            rope_destroy(std::unique_ptr<RopeNode>);
+size_t                          rope_pool_trim();
 std::unique_ptr<RopeNode>       rope_concat(std::unique_ptr<RopeNode>,const char*);
 std::unique_ptr<RopeNode>       rope_concat(std::unique_ptr<RopeNode>,std::unique_ptr<RopeNode>);
 void                            rope_prepend(RopeNode*,const char*);
@@ -121,10 +256,20 @@ void                            rope_insert_flag_at(RopeNode*, size_t, size_t, u
 void                            rope_delete_at(RopeNode*, size_t, size_t);
 size_t                          rope_weight_measure(const RopeNode&);
 size_t                          rope_weight_measure_set(RopeNode*);
+size_t                          rope_weight_total(const RopeNode&);
+size_t                          rope_lines_measure_set(RopeNode*);
+size_t                          rope_line_count(const RopeNode&);
+size_t                          rope_line_to_index(const RopeNode&, size_t);
+size_t                          rope_index_to_line(const RopeNode&, size_t);
 size_t                          rope_height_measure(const RopeNode&);
 bool                            rope_is_balanced(const RopeNode&);
 bool                            rope_has_flag_at(RopeNode&, size_t, size_t, uint8_t);
 std::unique_ptr<RopeNode>       rope_rebalance(std::unique_ptr<RopeNode>);
+void                            rope_build_threads_set(size_t);
+size_t                          rope_build_threads();
+size_t                          rope_compact(RopeNode*);
+size_t                          rope_compact(RopeNode*, size_t, size_t);
+RopeStats                       rope_stats(const RopeNode&);
 std::unique_ptr<RopeNode>       rope_split_at(RopeNode*,size_t);
 RopeNode*                       rope_node_at_index_trace(RopeNode&,size_t,std::stack<RopeNode*>*,size_t*);
 RopeNode*                       rope_node_at_index(RopeNode&,size_t,size_t*);
@@ -133,6 +278,8 @@ RopeNode*                       rope_left_most_node(RopeNode&);
 RopeNode*                       rope_right_most_node_trace(RopeNode&,std::stack<RopeNode*>*);
 RopeNode*                       rope_right_most_node(RopeNode&);
 RopeNode*                       rope_range(RopeNode&, size_t, size_t, size_t *);
+RopeChunks                      rope_chunks(RopeNode&, size_t, size_t);
+size_t                          rope_copy_to(RopeNode&, size_t, size_t, std::string&);
 std::string                     rope_dot(const RopeNode&);
 
 
@@ -0,0 +1,131 @@
+#include "search.h"
+#include "utf8.h"
+#include <plog/Log.h>
+
+
+#include <string>
+#include <string_view>
+#include <cstring>
+
+
+void                                            _find_scan(RopeNode&, size_t, std::string_view, size_t, std::vector<size_t>&);
+
+
+/*
+    first match at or after the codepoint index from,
+        SEARCH_NOT_FOUND if there is none
+*/
+size_t rope_find(RopeNode &rope, size_t from, const char *needle){
+    std::vector<size_t> matches;
+    if(rope_find_all(rope, from, needle, 1, matches) == 0)
+        return SEARCH_NOT_FOUND;
+    return matches.front();
+}
+
+/*
+    every match in the rope, matches don't overlap
+*/
+std::vector<size_t> rope_find_all(RopeNode &rope, const char *needle){
+    std::vector<size_t> matches;
+    rope_find_all(rope, 0, needle, SEARCH_NOT_FOUND, matches);
+    return matches;
+}
+
+/*
+    appends up to limit matches at or after from to matches,
+        returns the number appended
+*/
+size_t rope_find_all(RopeNode &rope, size_t from, const char *needle, size_t limit, std::vector<size_t> &matches){
+    if(needle == nullptr || *needle == '\0'){
+        PLOG_ERROR << "given needle is NULL or empty, aborted.";
+        return 0;
+    }
+    size_t start_size = matches.size();
+    if(limit > 0 && from < rope_weight_total(rope))
+        _find_scan(rope, from, std::string_view(needle), limit, matches);
+    return matches.size() - start_size;
+}
+
+
+/*
+    scans leaves from the codepoint index begin;
+        tail keeps the last needle - 1 bytes not taken by a match,
+            a match starting there is verified against the tail and the next slice
+*/
+void _find_scan(RopeNode &rope, size_t begin, std::string_view needle, size_t limit, std::vector<size_t> &matches){
+    const size_t m = needle.size();
+    std::string tail;
+    tail.reserve(m);
+    size_t found = 0;
+    RopeLeafIterator litrope(&rope, begin);
+    size_t local = litrope.local_start_index();
+    size_t leafIndex = begin - local;//codepoint index of the leaf start
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        if(c->text == nullptr || c->weight <= local){
+            local -= std::min(local, c->weight);
+            leafIndex += c->weight;
+            continue;
+        }
+        //leaves know their weight, codepoints are counted only up to matches in non ascii ones
+        size_t from = local > 0 ? rope_leaf_offset(*c, local) : 0;
+        std::string_view chunk(c->text.get() + from, c->bytes - from);
+        size_t index = leafIndex + local;//codepoint index of the slice start
+        leafIndex += c->weight;
+        local = 0;
+        //bytes of the slice taken by a match, scanning resumes after them
+        size_t skip = 0;
+        bool tailTaken = false;
+        const char *p = tail.empty() ? nullptr : (const char*)std::memchr(tail.data(), needle[0], tail.size());
+        for(;p != nullptr;p = (const char*)std::memchr(p + 1, needle[0], tail.data() + tail.size() - p - 1)){
+            //k bytes in the tail, the rest in this slice
+            size_t k = tail.data() + tail.size() - p;
+            if(chunk.size() < m - k)
+                break;
+            if(std::memcmp(p, needle.data(), k) == 0 && std::memcmp(chunk.data(), needle.data() + k, m - k) == 0){
+                matches.push_back(index - u_count(p, k));
+                if(++found >= limit)
+                    return;
+                skip = m - k;
+                tailTaken = true;
+                break;
+            }
+        }
+        //matches inside the slice, codepoints are counted up to each one
+        size_t counted = 0, countedIndex = index;
+        if(chunk.size() >= m){
+            size_t last = chunk.size() - m;
+            size_t at = skip;
+            while(at <= last){
+                const char *hit = (const char*)std::memchr(chunk.data() + at, needle[0], last - at + 1);
+                if(hit == nullptr)
+                    break;
+                at = hit - chunk.data();
+                if(std::memcmp(hit, needle.data(), m) != 0){
+                    at++;
+                    continue;
+                }
+                countedIndex += c->ascii ? at - counted : u_count(chunk.data() + counted, at - counted);
+                counted = at;
+                matches.push_back(countedIndex);
+                if(++found >= limit)
+                    return;
+                at += m;
+                skip = at;
+                tailTaken = true;
+            }
+        }
+        //tail for the next slice, only bytes no match took
+        if(m == 1)
+            continue;
+        if(chunk.size() - skip >= m - 1){
+            tail.assign(chunk.data() + chunk.size() - (m - 1), m - 1);
+            continue;
+        }
+        if(tailTaken)
+            tail.clear();
+        tail.append(chunk.data() + skip, chunk.size() - skip);
+        if(tail.size() > m - 1)
+            tail.erase(0, tail.size() - (m - 1));
+    }
+}
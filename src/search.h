@@ -0,0 +1,27 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+
+#include "rope.h"
+
+#include <cstddef>
+#include <vector>
+
+
+/*
+    literal search over rope leaves, nothing is copied out;
+    every leaf slice is scanned for the first needle byte with memchr, vectorized by the C library,
+    and candidates are verified in place. Up to needle length - 1 bytes of the previous slices
+    are kept, so matches straddling leaves are found too.
+    Matches are codepoint indices of the match start, same as insertFlagAtRange takes,
+    the match is ustrlen(needle) codepoints long.
+*/
+inline const size_t                 SEARCH_NOT_FOUND    = (size_t)-1;
+
+
+size_t                          rope_find(RopeNode&, size_t, const char *);
+std::vector<size_t>             rope_find_all(RopeNode&, const char *);
+size_t                          rope_find_all(RopeNode&, size_t, const char *, size_t, std::vector<size_t>&);
+
+
+#endif
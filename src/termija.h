@@ -2,6 +2,7 @@
 #define TERMIJA_H
 
 #include "rope.h"
+#include "attrs.h"
 #include "widget.h"
 #include "raylib.h"
 
@@ -238,6 +239,7 @@ void        tra_draw_pane_border(const Pane&);
 void        tra_draw_text(RopeNode *, uint16_t, uint16_t, uint16_t, uint16_t);
 void        tra_draw_text(RopeNode *, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, size_t);
 void        tra_draw_text(RopeNode *, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, Cursor &);
+void        tra_draw_text(RopeNode *, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, uint16_t, Cursor &, const RopeAttrs *);
 void        tra_draw_cursor(uint16_t, uint16_t, Cursor &);
 void        tra_draw_back(uint16_t , uint16_t , const Texture2D *, const Shader *);
 Texture2D   invert_font(Texture2D);
@@ -0,0 +1,175 @@
+#include "utf8.h"
+
+
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF8_X86
+#include <immintrin.h>
+#endif
+
+
+/*
+    signed compare trick;
+        continuation bytes are 0x80..0xbf, -128..-65 as signed char,
+        so every byte greater than -65 starts a codepoint
+*/
+inline const char                               _U_CONTINUATION_MAX = -65;
+
+size_t                                          _u_popcount16(uint32_t);
+
+#ifdef UTF8_X86
+size_t                                          _u_count_sse2(const char*, size_t);
+size_t                                          _u_offset_sse2(const char*, size_t, size_t);
+size_t                                          _u_count_avx2(const char*, size_t);
+size_t                                          _u_offset_avx2(const char*, size_t, size_t);
+#endif
+
+
+size_t u_count_scalar(const char *s, size_t length){
+    size_t count = 0;
+    for(size_t i=0;i<length;i++){
+        if((s[i] & 0xc0) != 0x80)
+            ++count;
+    }
+    return count;
+}
+
+size_t u_offset_scalar(const char *s, size_t length, size_t index){
+    for(size_t i=0;i<length;i++){
+        if((s[i] & 0xc0) != 0x80){
+            if(index == 0)
+                return i;
+            --index;
+        }
+    }
+    return length;
+}
+
+
+/*
+    sse2 alone has no popcnt instruction, the builtin would be a library call
+*/
+inline size_t _u_popcount16(uint32_t mask){
+    mask = mask - ((mask >> 1) & 0x5555);
+    mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+    mask = (mask + (mask >> 4)) & 0x0f0f;
+    return (mask + (mask >> 8)) & 0x1f;
+}
+
+
+#ifdef UTF8_X86
+
+/*
+    byte counters are summed 255 blocks at a time so they can't overflow,
+        then folded with sad against zero
+*/
+__attribute__((target("sse2")))
+size_t _u_count_sse2(const char *s, size_t length){
+    const __m128i threshold = _mm_set1_epi8(_U_CONTINUATION_MAX);
+    size_t count = 0, i = 0;
+    while(length - i >= 16){
+        __m128i sum = _mm_setzero_si128();
+        size_t blocks = std::min<size_t>((length - i) / 16, 255);
+        for(size_t b=0;b<blocks;b++,i+=16){
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            //true lanes are -1
+            sum = _mm_sub_epi8(sum, _mm_cmpgt_epi8(v, threshold));
+        }
+        __m128i sad = _mm_sad_epu8(sum, _mm_setzero_si128());
+        count += (size_t)_mm_cvtsi128_si32(sad) + (size_t)_mm_extract_epi16(sad, 4);
+    }
+    return count + u_count_scalar(s + i, length - i);
+}
+
+/*
+    skips whole blocks by their popcount,
+        the block holding the codepoint is resolved from its mask
+*/
+__attribute__((target("sse2")))
+size_t _u_offset_sse2(const char *s, size_t length, size_t index){
+    const __m128i threshold = _mm_set1_epi8(_U_CONTINUATION_MAX);
+    size_t i = 0;
+    while(length - i >= 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(v, threshold));
+        size_t starts = _u_popcount16(mask);
+        if(index < starts){
+            for(;index > 0;--index)
+                mask &= mask - 1;
+            return i + (size_t)__builtin_ctz(mask);
+        }
+        index -= starts;
+        i += 16;
+    }
+    return i + u_offset_scalar(s + i, length - i, index);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t _u_count_avx2(const char *s, size_t length){
+    const __m256i threshold = _mm256_set1_epi8(_U_CONTINUATION_MAX);
+    size_t count = 0, i = 0;
+    while(length - i >= 32){
+        __m256i sum = _mm256_setzero_si256();
+        size_t blocks = std::min<size_t>((length - i) / 32, 255);
+        for(size_t b=0;b<blocks;b++,i+=32){
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            sum = _mm256_sub_epi8(sum, _mm256_cmpgt_epi8(v, threshold));
+        }
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_sad_epu8(sum, _mm256_setzero_si256()));
+        count += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return count + u_count_scalar(s + i, length - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+size_t _u_offset_avx2(const char *s, size_t length, size_t index){
+    const __m256i threshold = _mm256_set1_epi8(_U_CONTINUATION_MAX);
+    size_t i = 0;
+    while(length - i >= 32){
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(v, threshold));
+        size_t starts = (size_t)__builtin_popcount(mask);
+        if(index < starts){
+            for(;index > 0;--index)
+                mask &= mask - 1;
+            return i + (size_t)__builtin_ctz(mask);
+        }
+        index -= starts;
+        i += 32;
+    }
+    return i + u_offset_scalar(s + i, length - i, index);
+}
+
+#endif
+
+
+/*
+    scalar first, best last
+*/
+std::vector<UKernel> u_kernels_available(){
+    std::vector<UKernel> kernels = {{"scalar", u_count_scalar, u_offset_scalar}};
+#ifdef UTF8_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse2"))
+        kernels.push_back({"sse2", _u_count_sse2, _u_offset_sse2});
+    if(__builtin_cpu_supports("sse2") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        kernels.push_back({"avx2", _u_count_avx2, _u_offset_avx2});
+#endif
+    return kernels;
+}
+
+const UKernel& u_kernel(){
+    static const UKernel kernel = u_kernels_available().back();
+    return kernel;
+}
+
+size_t u_count(const char *s, size_t length){
+    return u_kernel().count(s, length);
+}
+
+size_t u_offset(const char *s, size_t length, size_t index){
+    return u_kernel().offset(s, length, index);
+}
@@ -0,0 +1,32 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+
+#include <cstddef>
+#include <vector>
+
+
+/*
+    UTF-8 codepoint kernels;
+    a codepoint starts at every byte that is not a continuation byte (10xxxxxx),
+    so counting and indexing come down to classifying bytes, which the SIMD kernels do 16 or 32 at a time.
+    The best kernel the CPU supports is picked once, on first use.
+*/
+struct UKernel final{
+    const char                      *name;
+    //codepoints in the first length bytes
+    size_t                          (*count)(const char*, size_t);
+    //byte offset of the codepoint at index, length if there are fewer
+    size_t                          (*offset)(const char*, size_t, size_t);
+};
+
+
+size_t                              u_count_scalar(const char*, size_t);
+size_t                              u_offset_scalar(const char*, size_t, size_t);
+size_t                              u_count(const char*, size_t);
+size_t                              u_offset(const char*, size_t, size_t);
+const UKernel&                      u_kernel();
+std::vector<UKernel>                u_kernels_available();
+
+
+#endif
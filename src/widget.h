@@ -3,10 +3,14 @@
 
 
 #include "rope.h"
+#include "journal.h"
+#include "attrs.h"
+#include "pattern.h"
 #include "string.h"
 
 
 #include <map>
+#include <vector>
 
 namespace termija{
 
@@ -85,6 +89,7 @@ public:
     void            underline();
     void            activate(bool);
     bool            isActive() const;
+    RopeStats       getTextStats() const;
 
 };
 
@@ -123,6 +128,10 @@ public:
 /*
     Text Box Widget
 */
+//typing leaves a leaf per keystroke, text around the cursor is compacted every few inserts
+inline const uint16_t               TEXTBOX_COMPACT_EDITS   = 64;
+inline const size_t                 TEXTBOX_COMPACT_WINDOW  = 4 * MAX_WEIGHT;
+
 class TextBox : public Widget{
 private:
     uint16_t                                    widthTxt;
@@ -136,8 +145,24 @@ private:
     uint8_t                                     lineNumbersMargin=1;
     std::unique_ptr<ScrollBar>                  scrollBar;
     uint8_t                                     scrollBarMargin=1;
+    RopeJournal                                 journal;
+    RopeAttrs                                   attributes;//drawn over the text, kept in step with it's edits
+    std::unique_ptr<RopePattern>                pattern;
+    PatternSearch                               patternSearch;
+    std::vector<RopeMatch>                      patternMatches;
+    uint16_t                                    batchDepth=0;
+    std::vector<RopeEdit>                       batchEdits;//text edits of the batch, attributes and searches follow them at commit
+    uint16_t                                    editsSinceCompact=0;
+    size_t                                      compactIndex=0;
 
     void            repositionCursor();
+    void            placeCursorAfterReplay(size_t);
+    void            shiftAttributesAfterReplay(const RopeEdit&, bool);
+    void            textInserted(size_t, size_t);
+    void            textDeleted(size_t, size_t);
+    void            batchEdit(uint8_t, size_t, size_t);
+    void            restartPatternSearch();
+    void            compactAfterEdit();
     bool            cursorIsOnNewLine() const;
     bool            frameCursorIsOnNewLine() const;
     void            repositionFrameCursor();
@@ -165,8 +190,13 @@ public:
     uint16_t        getY() const;
     size_t          getCurrentIndex() const;
     size_t          getTextLength() const;
+    uint16_t        getNumberOfLines() const;
+    uint8_t         getAttributeAt(size_t) const;
     std::string     getText(size_t, size_t) const;
     std::string     getText() const;
+    size_t          findText(const char *, size_t) const;
+    std::vector<size_t>
+                    findAllText(const char *) const;
     std::pair<uint16_t, uint16_t>
                     getCursorPosition() const;
     void            insertAtCursor(const char *);
@@ -174,6 +204,9 @@ public:
     void            insertAtCursor(const char *, const uint8_t);
     void            insertLineAtCursor(const char *, const uint8_t);
     void            insertFlagAtRange(size_t, size_t, uint8_t);
+    void            addAttributeAtRange(size_t, size_t, uint8_t);
+    void            removeAttributeAtRange(size_t, size_t, uint8_t);
+    void            clearAttributes();
     void            deleteAtCursor();
     void            deleteAtRange(size_t, size_t);
     void            backspaceAtCursor();
@@ -195,6 +228,19 @@ public:
     void            displayScrollBar(bool);
     bool            isScrollBarDisplayed() const;
     void            clear();
+    bool            openFile(const char *);
+    bool            undo();
+    bool            redo();
+    void            setUndoBudget(size_t);
+    void            beginBatch();
+    void            commit();
+    bool            isInBatch() const;
+    size_t          compactText(size_t);
+    RopeStats       getTextStats() const;
+    bool            beginPatternSearch(const char *);
+    bool            stepPatternSearch(size_t);
+    const std::vector<RopeMatch>&
+                    getPatternMatches() const;
 
     RopeLeafIterator    getRopeLeafIterator();
 
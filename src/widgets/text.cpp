@@ -176,7 +176,7 @@ void Text::underline(){
     //add underline flags
     while((current = litrope.pop()) != nullptr){
         //TODO: add UNDERLINE_FLAG
-        current->flags->effects;
+        current->flags.effects;
     }
 }
 
@@ -192,6 +192,14 @@ Text::isActive() const{
     return this->_isActive;
 }
 
+/*
+    shape and memory of the text rope, see rope_stats
+*/
+RopeStats
+Text::getTextStats() const{
+    return this->text == nullptr ? RopeStats{} : rope_stats(*(this->text));
+}
+
 }
 
 
@@ -1,5 +1,7 @@
 #include "../widget.h"
 #include "../rope.h"
+#include "../search.h"
+#include "../pattern.h"
 #include "../termija.h"
 
 #include <plog/Log.h>
@@ -49,7 +51,8 @@ void TextBox::draw(const uint16_t startX,const uint16_t startY,const uint16_t te
                         this->getTextStartX(), this->getTextStartY(), 
                         std::min((uint16_t)(textWidth - textToStartWidth), this->getTextWidth()), 
                         std::min((uint16_t)(textHeight - textToStartHeight), this->getTextHeight()), 
-                        this->frameCursor);
+                        this->frameCursor,
+                        &this->attributes);
     tra_draw_cursor(startX+this->getTextStartX(), startY+this->getTextStartY(), this->cursor);
     uint16_t childX = startX + this->getX();
     uint16_t childY = startY + this->getY();
@@ -153,6 +156,22 @@ TextBox::getTextLength() const{
     return this->text->weight;
 }
 
+/*
+    lines the text takes, as of the last commit inside a batch
+*/
+uint16_t
+TextBox::getNumberOfLines() const{
+    return this->numberOfLines;
+}
+
+/*
+    attribute flags drawn over the character at index
+*/
+uint8_t
+TextBox::getAttributeAt(size_t index) const{
+    return attrs_at(this->attributes, index, nullptr);
+}
+
 
 std::string
 TextBox::getText(size_t start, size_t end) const{
@@ -162,13 +181,7 @@ TextBox::getText(size_t start, size_t end) const{
         return std::string();
 
     std::string rope_text;
-    RopeLeafIterator litrope(this->text.get(), start);
-        RopeNode *c;
-        while((c = litrope.pop()) != nullptr && ustrlen(rope_text) < (end - start)){
-            if( c->text != nullptr )
-                rope_text += c->text.get();
-        }
-
+    rope_copy_to(*(this->text), start, end, rope_text);
     return rope_text;
 }
     
@@ -177,6 +190,23 @@ TextBox::getText() const{
     return this->getText(0, this->text->weight);
 }
 
+/*
+    index of the first match at or after from, SEARCH_NOT_FOUND if none;
+        searched in place, the text is not copied out
+*/
+size_t
+TextBox::findText(const char *needle, size_t from) const{
+    return rope_find(*(this->text), from, needle);
+}
+
+/*
+    indexes of every match, each ustrlen(needle) long
+*/
+std::vector<size_t>
+TextBox::findAllText(const char *needle) const{
+    return rope_find_all(*(this->text), needle);
+}
+
 std::pair<uint16_t, uint16_t>
 TextBox::getCursorPosition() const{
     return std::pair<uint16_t, uint16_t>(this->cursor.x, this->frameCursorLine + this->cursor.y);
@@ -186,6 +216,9 @@ TextBox::getCursorPosition() const{
     positions cursor inside textbox, based on rope index, relative to the frameCursor
 */
 void TextBox::repositionCursor(){
+    //deferred until commit
+    if(this->batchDepth > 0)
+        return;
     if(this->cursor.index > this->text->weight){
         PLOG_ERROR << "invalid cursor index, set to rope end.";
         this->cursor.index = this->text->weight>0?this->text->weight-1:0;
@@ -238,7 +271,7 @@ bool TextBox::cursorIsOnNewLine() const{
         return false;
     }
     //if node is newlined, and cursor is at the end
-    return (nodeAtCursor->flags->effects.to_ulong() & (uint64_t)FLAG_NEW_LINE) &&
+    return (nodeAtCursor->flags.effects.to_ulong() & (uint64_t)FLAG_NEW_LINE) &&
             (localIndex == nodeAtCursor->weight - 1);  
 }
 
@@ -254,7 +287,7 @@ bool TextBox::frameCursorIsOnNewLine() const{
         return false;
     }
     //if node is newlined, and cursor is at the end
-    return (nodeAtCursor->flags->effects.to_ulong() & (uint64_t)FLAG_NEW_LINE) &&
+    return (nodeAtCursor->flags.effects.to_ulong() & (uint64_t)FLAG_NEW_LINE) &&
             (localIndex == nodeAtCursor->weight - 1);  
 }
 
@@ -350,6 +383,9 @@ bool TextBox::isCursorDisplayed() const{
     moves back frameCursor index so that weightUntilPrevNewLine % textWidth = 0
 */
 void TextBox::repositionFrameCursor(){
+    //deferred until commit
+    if(this->batchDepth > 0)
+        return;
     if(this->frameCursor.index >= this->text->weight){
         PLOG_ERROR << "invalid frame cursor index, set to 0.";
         this->frameCursor.index = 0;
@@ -414,6 +450,9 @@ TextBox::updateLineNumbers(){
 
 void
 TextBox::updateScrollBar(){
+    //deferred until commit
+    if(this->batchDepth > 0)
+        return;
     if(!this->isScrollBarDisplayed())
         return;
 
@@ -472,7 +511,10 @@ void TextBox::insertAtCursor(const char *text){
     //move cursor
     size_t iWeight = ustrlen(text);
     if(pWeight == this->text->weight - iWeight){
+        journal_insert(&this->journal, *(this->text), this->cursor.index, iWeight);
+        this->textInserted(this->cursor.index, iWeight);
         cursorWalkRight(iWeight);
+        this->compactAfterEdit();
     }
 
     this->countNumberOfLines();
@@ -501,7 +543,10 @@ void TextBox::insertAtCursor(const char *text, const uint8_t flags){
     //move cursor
     size_t iWeight = ustrlen(text);
     if(pWeight == this->text->weight - iWeight){
+        journal_insert(&this->journal, *(this->text), this->cursor.index, iWeight);
+        this->textInserted(this->cursor.index, iWeight);
         cursorWalkRight(iWeight);
+        this->compactAfterEdit();
     }
 
     this->countNumberOfLines();
@@ -529,7 +574,10 @@ void TextBox::insertLineAtCursor(const char *text){
     //move cursor to new line
     size_t iWeight = ustrlen(text);
     if(pWeight == this->text->weight - iWeight){
+        journal_insert(&this->journal, *(this->text), this->cursor.index, iWeight);
+        this->textInserted(this->cursor.index, iWeight);
         cursorWalkRight(iWeight);
+        this->compactAfterEdit();
     }  
 
     this->countNumberOfLines();
@@ -557,7 +605,10 @@ void TextBox::insertLineAtCursor(const char *text, const uint8_t flags){
     //move cursor to new line
     size_t iWeight = ustrlen(text);
     if(pWeight == this->text->weight - iWeight){
+        journal_insert(&this->journal, *(this->text), this->cursor.index, iWeight);
+        this->textInserted(this->cursor.index, iWeight);
         cursorWalkRight(iWeight);
+        this->compactAfterEdit();
     }
 
     this->countNumberOfLines();
@@ -568,6 +619,7 @@ void TextBox::insertFlagAtRange(size_t index, size_t length, uint8_t flags){
         PLOG_ERROR << "invalid range, aborted.";
         return;
     }
+    journal_flags(&this->journal, *(this->text), index, length, flags);
     rope_insert_flag_at(this->text.get(), index, length, flags);
 
     if(flags & FLAG_NEW_LINE){
@@ -577,6 +629,33 @@ void TextBox::insertFlagAtRange(size_t index, size_t length, uint8_t flags){
     this->countNumberOfLines();
 }
 
+/*
+    adds attribute flags over [index, index+length), without touching the text;
+        new line stays with the text, it's not an attribute
+*/
+void TextBox::addAttributeAtRange(size_t index, size_t length, uint8_t flags){
+    if((index+length) > this->text->weight || length <= 0){
+        PLOG_ERROR << "invalid range, aborted.";
+        return;
+    }
+    attrs_add(&this->attributes, index, length, flags & ~FLAG_NEW_LINE);
+}
+
+/*
+    removes attribute flags from [index, index+length)
+*/
+void TextBox::removeAttributeAtRange(size_t index, size_t length, uint8_t flags){
+    if((index+length) > this->text->weight || length <= 0){
+        PLOG_ERROR << "invalid range, aborted.";
+        return;
+    }
+    attrs_remove(&this->attributes, index, length, flags);
+}
+
+void TextBox::clearAttributes(){
+    attrs_reset(&this->attributes, this->text->weight);
+}
+
 void TextBox::deleteAtCursor(){
     if(this->cursor.index > this->text->weight && this->cursor.index != 0){
         PLOG_ERROR << "invalid cursor index, aborted.";
@@ -585,8 +664,11 @@ void TextBox::deleteAtCursor(){
     //delete at cursor
     size_t ropeIndex = this->cursor.index==this->text->weight?this->cursor.index-1:this->cursor.index;
     if(this->text->weight > 0 
-        && this->cursor.index+1 < this->text->weight)
+        && this->cursor.index+1 < this->text->weight){
+        journal_delete(&this->journal, *(this->text), ropeIndex + 1, 1);
+        this->textDeleted(ropeIndex + 1, 1);
         rope_delete_at(this->text.get(), ropeIndex, 1);
+    }
     //move back if somehow goes over
     if(this->cursor.index > this->text->weight){
         this->cursor.index = this->text->weight;//put at end
@@ -604,6 +686,10 @@ void TextBox::deleteAtRange(size_t startIndex, size_t endIndex){
         PLOG_ERROR << "invalid range, aborted.";
         return;
     }
+    if(endIndex - startIndex > 1){
+        journal_delete(&this->journal, *(this->text), startIndex + 1, (endIndex - startIndex - 1));
+        this->textDeleted(startIndex + 1, (endIndex - startIndex - 1));
+    }
     rope_delete_at(this->text.get(), startIndex, (endIndex - startIndex - 1));
     if(this->cursor.index > this->text->weight){
         this->cursor.index = this->text->weight;//put at end
@@ -626,6 +712,8 @@ void TextBox::backspaceAtCursor(){
     */
     if(this->cursor.index == 1){
         if(this->text->weight > 0){
+            journal_delete(&this->journal, *(this->text), 0, 1);
+            this->textDeleted(0, 1);
             std::unique_ptr<RopeNode> new_rope = rope_split_at(this->text.get(), 0);
             if(new_rope != nullptr)
                 std::swap(this->text, new_rope);
@@ -635,6 +723,8 @@ void TextBox::backspaceAtCursor(){
             this->cursor.index = this->cursor.x = this->cursor.y = 0;
         }
     }else if(this->cursor.index > 1){//delete at index - 2
+        journal_delete(&this->journal, *(this->text), this->cursor.index-1, 1);
+        this->textDeleted(this->cursor.index-1, 1);
         rope_delete_at(this->text.get(), this->cursor.index-2, 1);
         cursorWalkLeft(1);
     }
@@ -865,22 +955,305 @@ TextBox::clear(){
     this->cursor.index = 0;
     this->cursor.x = 0;
     this->cursor.y = 0;
+    //history
+    journal_clear(&this->journal);
+    attrs_reset(&this->attributes, 0);
+    this->batchEdits.clear();
+    this->restartPatternSearch();
+}
+
+
+/*
+    reverts the last edit, cursor goes where the edit was;
+        false if there is nothing to undo
+*/
+bool
+TextBox::undo(){
+    size_t index = 0;
+    size_t applied = this->journal.applied;
+    if(!journal_undo(&this->journal, this->text, &index))
+        return false;
+    //a batch is undone edit by edit, last first
+    while(applied-- > this->journal.applied)
+        this->shiftAttributesAfterReplay(this->journal.edits[applied], true);
+    this->placeCursorAfterReplay(index);
+    return true;
+}
+
+/*
+    applies the last undone edit again;
+        false if there is nothing to redo
+*/
+bool
+TextBox::redo(){
+    size_t index = 0;
+    size_t applied = this->journal.applied;
+    if(!journal_redo(&this->journal, this->text, &index))
+        return false;
+    for(;applied < this->journal.applied;applied++)
+        this->shiftAttributesAfterReplay(this->journal.edits[applied], false);
+    this->placeCursorAfterReplay(index);
+    return true;
+}
+
+/*
+    bytes of history kept for undo, oldest edits are dropped first
+*/
+void
+TextBox::setUndoBudget(size_t budget){
+    journal_budget_set(&this->journal, budget);
+}
+
+/*
+    starts a batch of edits;
+        edits go to the rope right away, cursor, frame cursor, line count,
+            scrollbar, attributes and searches are updated once, at the matching commit;
+        the batch is undone as one edit; batches nest
+*/
+void
+TextBox::beginBatch(){
+    if(this->batchDepth++ == 0)
+        journal_group_begin(&this->journal);
+}
+
+/*
+    ends the batch, recomputing what the edits in it left stale
+*/
+void
+TextBox::commit(){
+    if(this->batchDepth == 0){
+        PLOG_ERROR << "no batch to commit, aborted.";
+        return;
+    }
+    if(--this->batchDepth > 0)
+        return;
+
+    journal_group_end(&this->journal);
+    for(const RopeEdit &edit : this->batchEdits){
+        if(edit.kind == EDIT_INSERT)
+            attrs_text_inserted(&this->attributes, edit.index, edit.length);
+        else
+            attrs_text_deleted(&this->attributes, edit.index, edit.length);
+    }
+    if(!this->batchEdits.empty())
+        this->restartPatternSearch();
+    this->batchEdits.clear();
+    this->countNumberOfLines();
+    if(this->text->weight == 0){
+        this->frameCursor.index = this->frameCursorLine = 0;
+        this->cursor.index = this->cursor.x = this->cursor.y = 0;
+        return;
+    }
+    if(this->frameCursor.index >= this->text->weight)
+        this->frameCursor.index = this->text->weight - 1;
+    this->cursor.index = std::min(this->cursor.index, this->text->weight);
+    this->repositionFrameCursor();
+    this->repositionCursor();
+}
+
+bool
+TextBox::isInBatch() const{
+    return this->batchDepth > 0;
 }
 
+/*
+    compacts the next part of the text, for idle frames;
+        walks the whole text over repeated calls, step codepoints at a time;
+            returns the number of leaves removed
+*/
+size_t
+TextBox::compactText(size_t step){
+    size_t weight = rope_weight_total(*(this->text));
+    if(weight == 0 || step == 0)
+        return 0;
+    if(this->compactIndex >= weight)
+        this->compactIndex = 0;
+    size_t removed = rope_compact(this->text.get(), this->compactIndex, this->compactIndex + step);
+    this->compactIndex += step;
+    return removed;
+}
+
+/*
+    shape and memory of the text rope, see rope_stats;
+        sampled now and then it tells when compactText or a rebalance pays off
+*/
+RopeStats
+TextBox::getTextStats() const{
+    return rope_stats(*(this->text));
+}
+
+/*
+    amortized compaction after inserts, around the cursor where typing left small leaves
+*/
+void
+TextBox::compactAfterEdit(){
+    if(++this->editsSinceCompact < TEXTBOX_COMPACT_EDITS)
+        return;
+    this->editsSinceCompact = 0;
+    size_t begin = this->cursor.index > TEXTBOX_COMPACT_WINDOW ? this->cursor.index - TEXTBOX_COMPACT_WINDOW : 0;
+    rope_compact(this->text.get(), begin, this->cursor.index + TEXTBOX_COMPACT_WINDOW);
+}
 
+/*
+    starts searching the text for the pattern, a step per frame;
+        false if the pattern is invalid
+*/
+bool
+TextBox::beginPatternSearch(const char *pattern){
+    this->pattern = pattern_compile(pattern);
+    this->patternMatches.clear();
+    if(this->pattern == nullptr){
+        this->patternSearch = PatternSearch();
+        return false;
+    }
+    pattern_search_begin(&this->patternSearch, this->pattern.get(), 0);
+    return true;
+}
 
-void//PERFORMANCE ?
+/*
+    searches on for about budget bytes;
+        true once the whole text is searched, editing the text starts it over
+*/
+bool
+TextBox::stepPatternSearch(size_t budget){
+    return pattern_search_step(&this->patternSearch, *(this->text), budget, this->patternMatches);
+}
+
+const std::vector<RopeMatch>&
+TextBox::getPatternMatches() const{
+    return this->patternMatches;
+}
+
+/*
+    text was inserted at index, attributes and searches follow it
+*/
+void
+TextBox::textInserted(size_t index, size_t length){
+    //deferred until commit
+    if(this->batchDepth > 0){
+        this->batchEdit(EDIT_INSERT, index, length);
+        return;
+    }
+    attrs_text_inserted(&this->attributes, index, length);
+    this->restartPatternSearch();
+}
+
+/*
+    text [index, index+length) was deleted
+*/
+void
+TextBox::textDeleted(size_t index, size_t length){
+    //deferred until commit
+    if(this->batchDepth > 0){
+        this->batchEdit(EDIT_DELETE, index, length);
+        return;
+    }
+    attrs_text_deleted(&this->attributes, index, length);
+    this->restartPatternSearch();
+}
+
+/*
+    keeps a text edit for commit,
+        typing, deleting and backspacing grow the last one instead of adding more
+*/
+void
+TextBox::batchEdit(uint8_t kind, size_t index, size_t length){
+    if(!this->batchEdits.empty()){
+        RopeEdit &last = this->batchEdits.back();
+        if(last.kind == kind && kind == EDIT_INSERT && index == last.index + last.length){
+            last.length += length;
+            return;
+        }
+        if(last.kind == kind && kind == EDIT_DELETE && (index == last.index || index + length == last.index)){
+            last.index = index;
+            last.length += length;
+            return;
+        }
+    }
+    RopeEdit edit;
+    edit.kind = kind;
+    edit.flags = 0;
+    edit.index = index;
+    edit.length = length;
+    edit.joined = false;
+    this->batchEdits.push_back(std::move(edit));
+}
+
+/*
+    matches so far describe old text, the search begins again
+*/
+void
+TextBox::restartPatternSearch(){
+    if(this->pattern == nullptr)
+        return;
+    this->patternMatches.clear();
+    pattern_search_begin(&this->patternSearch, this->pattern.get(), 0);
+}
+
+/*
+    replayed text edits move the attributes and searches too, flag edits don't
+*/
+void
+TextBox::shiftAttributesAfterReplay(const RopeEdit &edit, bool undo){
+    if(edit.kind == EDIT_FLAGS)
+        return;
+    if((edit.kind == EDIT_INSERT) == undo)
+        this->textDeleted(edit.index, edit.length);
+    else
+        this->textInserted(edit.index, edit.length);
+}
+
+void
+TextBox::placeCursorAfterReplay(size_t index){
+    this->countNumberOfLines();
+    if(this->text->weight == 0){
+        this->frameCursor.index = this->frameCursorLine = 0;
+        this->cursor.index = this->cursor.x = this->cursor.y = 0;
+        return;
+    }
+    if(this->frameCursor.index >= this->text->weight)
+        this->frameCursor.index = this->text->weight - 1;
+    this->cursor.index = std::min(index, this->text->weight);
+    this->repositionFrameCursor();
+    this->repositionCursor();
+    this->findCursor();
+}
+
+
+/*
+    replaces text with the file contents,
+        the file is mapped, not read, so huge logs open instantly;
+            false if it can't be opened
+*/
+bool
+TextBox::openFile(const char *path){
+    std::unique_ptr<RopeNode> rope = rope_map_file(path);
+    if(rope == nullptr){
+        PLOG_ERROR << "can't open file, aborted.";
+        return false;
+    }
+    this->clear();
+    std::swap(this->text, rope);
+    rope_destroy(std::move(rope));
+    attrs_reset(&this->attributes, this->text->weight);
+    this->restartPatternSearch();
+    this->countNumberOfLines();
+    return true;
+}
+
+
+void
 TextBox::countNumberOfLines(){
+    //deferred until commit
+    if(this->batchDepth > 0)
+        return;
     if(this->text->weight == 0)
         return;
 
-    uint16_t lines = 0;
-    size_t currentIndex = 0;
-    while(currentIndex <= this->text->weight - 1){
-        size_t weightUntilPreviousNewLine = weight_until_next_new_line(this->text.get(), currentIndex);
-        currentIndex += weightUntilPreviousNewLine;
+    //every new lined block, and the text after the last one
+    size_t lines = rope_line_count(*(this->text));
+    if(rope_line_to_index(*(this->text), lines) < this->text->weight)
         lines++;
-    }
     this->numberOfLines = lines;
 }
 
@@ -0,0 +1,117 @@
+#include <catch2/catch_test_macros.hpp>
+#include <attrs.h>
+
+#include <vector>
+#include <random>
+
+
+/*
+    attributes of every codepoint, the way drawing reads them
+*/
+std::vector<uint8_t> attrs_flatten(const RopeAttrs &attrs){
+    std::vector<uint8_t> flat;
+    size_t run_end = 0;
+    while(flat.size() < attrs_length(attrs)){
+        uint8_t bits = attrs_at(attrs, flat.size(), &run_end);
+        flat.resize(run_end, bits);
+    }
+    return flat;
+}
+
+
+TEST_CASE( "Attributes follow text edits", "[attrs_text]" ) {
+    RopeAttrs attrs;
+    attrs_reset(&attrs, 100);
+
+    SECTION("ranges are added and removed"){
+        attrs_add(&attrs, 10, 20, 2);
+        attrs_add(&attrs, 20, 20, 4);
+        size_t run_end;
+        REQUIRE( attrs_at(attrs, 9, &run_end) == 0 );
+        REQUIRE( run_end == 10 );
+        REQUIRE( attrs_at(attrs, 15, &run_end) == 2 );
+        REQUIRE( run_end == 20 );
+        REQUIRE( attrs_at(attrs, 25, &run_end) == 6 );
+        REQUIRE( run_end == 30 );
+        REQUIRE( attrs_at(attrs, 35, &run_end) == 4 );
+        REQUIRE( run_end == 40 );
+
+        attrs_remove(&attrs, 10, 20, 2);
+        attrs_remove(&attrs, 0, 100, 4);
+        //runs with the same attributes are merged back
+        REQUIRE( attrs_run_count(attrs) == 1 );
+        REQUIRE( attrs_length(attrs) == 100 );
+    }
+
+    SECTION("edits shift later runs"){
+        attrs_add(&attrs, 50, 10, 2);
+        attrs_text_inserted(&attrs, 10, 5);
+        attrs_text_inserted(&attrs, 55, 3);
+        size_t run_end;
+        REQUIRE( attrs_at(attrs, 55, &run_end) == 0 );
+        REQUIRE( run_end == 58 );
+        REQUIRE( attrs_at(attrs, 60, &run_end) == 2 );
+        REQUIRE( run_end == 68 );
+
+        attrs_text_deleted(&attrs, 40, 20);
+        REQUIRE( attrs_length(attrs) == 88 );
+        REQUIRE( attrs_at(attrs, 40, &run_end) == 2 );
+        REQUIRE( run_end == 48 );
+        attrs_text_deleted(&attrs, 40, 8);
+        REQUIRE( attrs_run_count(attrs) == 1 );
+    }
+}
+
+TEST_CASE( "Attributes match a flat model", "[attrs_at]" ) {
+    std::mt19937 random(7);
+    RopeAttrs attrs;
+    std::vector<uint8_t> model(1000, 0);
+    attrs_reset(&attrs, model.size());
+
+    for(size_t op=0;op<5000;op++){
+        size_t index = random() % (model.size() + 1);
+        size_t length = 1 + random() % 40;
+        uint8_t bits = 1 << (random() % 4);
+        switch(random() % 4){
+        case 0:
+            attrs_text_inserted(&attrs, index, length);
+            model.insert(model.begin() + index, length, 0);
+            break;
+        case 1:
+            if(model.size() < 100)
+                break;
+            length = std::min(length, model.size() - index);
+            if(length == 0)
+                break;
+            attrs_text_deleted(&attrs, index, length);
+            model.erase(model.begin() + index, model.begin() + index + length);
+            break;
+        case 2:
+            length = std::min(length * 4, model.size() - index);
+            if(length == 0)
+                break;
+            attrs_add(&attrs, index, length, bits);
+            for(size_t i=index;i<index+length;i++)
+                model[i] |= bits;
+            break;
+        default:
+            length = std::min(length * 4, model.size() - index);
+            if(length == 0)
+                break;
+            attrs_remove(&attrs, index, length, bits);
+            for(size_t i=index;i<index+length;i++)
+                model[i] &= ~bits;
+            break;
+        }
+        if(op % 100 == 0)
+            REQUIRE( attrs_flatten(attrs) == model );
+    }
+    REQUIRE( attrs_flatten(attrs) == model );
+
+    //runs are fused only at the edges of an edit
+    size_t runs = 1;
+    for(size_t i=1;i<model.size();i++)
+        runs += model[i] != model[i-1];
+    REQUIRE( attrs_run_count(attrs) >= runs );
+    REQUIRE( attrs_run_count(attrs) < runs * 4 );
+}
@@ -0,0 +1,233 @@
+#include <catch2/catch_test_macros.hpp>
+#include <brope.h>
+
+#include <memory>
+#include <string>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <random>
+
+
+/*
+    text of the rope, trough the leaf iterator
+*/
+std::string brope_text(BRope *rope){
+    std::string text;
+    BRopeLeafIterator litrope(rope);
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr)
+        text += c->text.get();
+    return text;
+}
+
+/*
+    compares lookups against the given text,
+        new lines are the leaves flagged with FLAG_NEW_LINE
+*/
+void require_brope_matches(BRope *rope, const std::string &text){
+    REQUIRE( rope_weight_total(*rope) == text.size() );
+    REQUIRE( brope_text(rope) == text );
+
+    std::vector<size_t> line_starts = {0};
+    size_t index = 0;
+    BRopeLeafIterator litrope(rope);
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        REQUIRE( c->weight > 0 );
+        REQUIRE( c->bytes == strlen(c->text.get()) );
+        size_t local_index = 0;
+        REQUIRE( rope_node_at_index(*rope, index, &local_index) == c );
+        REQUIRE( local_index == 0 );
+        REQUIRE( rope_index_to_line(*rope, index) == line_starts.size() - 1 );
+        index += c->weight;
+        if(has_flags(&c->flags, FLAG_NEW_LINE))
+            line_starts.push_back(index);
+    }
+    REQUIRE( rope_line_count(*rope) == line_starts.size() - 1 );
+    for(size_t line=0;line<line_starts.size();line++)
+        REQUIRE( rope_line_to_index(*rope, line) == line_starts[line] );
+}
+
+
+TEST_CASE( "BRope is created", "[brope_create]" ) {
+
+    SECTION("creating rope with valid text"){
+        std::unique_ptr<BRope> rope = brope_create("some_text");
+
+        REQUIRE( rope != nullptr );
+        REQUIRE( rope->weight == 9 );
+        REQUIRE( rope->height == 1 );
+        require_brope_matches(rope.get(), "some_text");
+    }
+
+    SECTION("creating rope with text length bigger than MAX_WEIGHT"){
+        const std::string text(MAX_WEIGHT * BROPE_MAX_CHILDREN * 3, 'm');
+        std::unique_ptr<BRope> rope = brope_create(text.c_str(), FLAG_NEW_LINE);
+
+        REQUIRE( rope->height == 2 );
+        REQUIRE( rope_line_count(*rope) == 1 );
+        require_brope_matches(rope.get(), text);
+    }
+
+    SECTION("creating rope with NULL"){
+        std::unique_ptr<BRope> rope = brope_create(nullptr);
+
+        REQUIRE( rope == nullptr );
+    }
+}
+
+TEST_CASE( "BRope is edited", "[brope_insert_at]" ) {
+
+    SECTION("appends, prepends and inserts"){
+        std::unique_ptr<BRope> rope = brope_create("some_text");
+        rope_append(rope.get(), "_end");
+        rope_prepend(rope.get(), "pre_");
+        rope_insert_at(rope.get(), 8, "_in");
+        rope_insert_at(rope.get(), 4, rope_create("line", FLAG_NEW_LINE));
+
+        REQUIRE( rope_line_count(*rope) == 1 );
+        require_brope_matches(rope.get(), "pre_slineome__intext_end");
+    }
+
+    SECTION("deletes after the index"){
+        std::unique_ptr<BRope> rope = brope_create("some_text");
+        rope_append(rope.get(), "_end");
+        rope_delete_at(rope.get(), 2, 8);
+
+        require_brope_matches(rope.get(), "somnd");
+    }
+
+    SECTION("deletes up to the end"){
+        std::unique_ptr<BRope> rope = brope_create("abcdef");
+        //past the end, as in the binary rope
+        rope_delete_at(rope.get(), 3, 3);
+        require_brope_matches(rope.get(), "abcdef");
+        rope_delete_at(rope.get(), 2, 3);
+        require_brope_matches(rope.get(), "abc");
+    }
+
+    SECTION("splits"){
+        std::unique_ptr<BRope> rope = brope_create("some_text");
+        rope_append(rope.get(), rope_create("_line", FLAG_NEW_LINE));
+        rope_append(rope.get(), "_end");
+        std::unique_ptr<BRope> right = rope_split_at(rope.get(), 6);
+
+        require_brope_matches(rope.get(), "some_te");
+        require_brope_matches(right.get(), "xt_line_end");
+        REQUIRE( rope_line_count(*right) == 1 );
+        REQUIRE( rope_split_at(rope.get(), 6) == nullptr );
+    }
+
+    SECTION("inserts flags"){
+        std::unique_ptr<BRope> rope = brope_create("some_text_more_text");
+        rope_insert_flag_at(rope.get(), 4, 6, FLAG_INVERT);
+
+        REQUIRE( rope_has_flag_at(*rope, 4, 6, FLAG_INVERT) );
+        REQUIRE_FALSE( rope_has_flag_at(*rope, 0, 4, FLAG_INVERT) );
+        REQUIRE_FALSE( rope_has_flag_at(*rope, 10, 9, FLAG_INVERT) );
+        require_brope_matches(rope.get(), "some_text_more_text");
+    }
+}
+
+TEST_CASE( "BRope matches plain text after random edits", "[brope_delete_at]" ) {
+    std::mt19937 random(7);
+    std::unique_ptr<BRope> rope = brope_create("");
+    std::string text;
+
+    for(size_t op=0;op<4000;op++){
+        size_t choice = random() % 100;
+        std::string piece(1 + random() % 40, 'a' + random() % 26);
+        if(choice < 65 || text.size() < 2){
+            //insert, every few as own line
+            size_t index = text.empty() ? 0 : random() % text.size();
+            if(text.empty())
+                rope_append(rope.get(), rope_create(piece.c_str(), (op % 3 == 0) ? FLAG_NEW_LINE : 0));
+            else
+                rope_insert_at(rope.get(), index, rope_create(piece.c_str(), (op % 3 == 0) ? FLAG_NEW_LINE : 0));
+            text.insert(text.empty() ? 0 : index + 1, piece);
+        }else if(choice < 90){
+            size_t index = random() % (text.size() - 1);
+            size_t length = 1 + random() % std::min<size_t>(text.size() - index - 1, 60);
+            rope_delete_at(rope.get(), index, length);
+            text.erase(index + 1, length);
+        }else if(choice < 91){
+            size_t index = random() % text.size();
+            std::unique_ptr<BRope> right = rope_split_at(rope.get(), index);
+            if(right != nullptr){
+                REQUIRE( brope_text(right.get()) == text.substr(index + 1) );
+                text.erase(index + 1);
+            }
+        }else{
+            size_t index = random() % text.size();
+            size_t length = 1 + random() % (text.size() - index);
+            rope_insert_flag_at(rope.get(), index, length, FLAG_INVERT);
+            REQUIRE( rope_has_flag_at(*rope, index, length, FLAG_INVERT) );
+        }
+        if(op % 100 == 0)
+            require_brope_matches(rope.get(), text);
+    }
+    require_brope_matches(rope.get(), text);
+    REQUIRE( rope->height >= 2 );
+    REQUIRE( rope->height <= 5 );
+}
+
+TEST_CASE( "BRope edits match the binary rope", "[brope_delete_at]" ) {
+    std::mt19937 random(11);
+    std::unique_ptr<BRope> rope = brope_create("some_text_end");
+    std::unique_ptr<RopeNode> binary = rope_create("some_text_end");
+
+    SECTION("same index rules"){
+        std::unique_ptr<BRope> deleted = brope_create("some_text_end");
+        std::unique_ptr<RopeNode> binary_deleted = rope_create("some_text_end");
+        rope_insert_at(rope.get(), 3, "XX");
+        rope_insert_at(binary.get(), 3, "XX");
+        rope_delete_at(deleted.get(), 2, 4);
+        rope_delete_at(binary_deleted.get(), 2, 4);
+
+        std::string text;
+        rope_copy_to(*binary, 0, rope_weight_total(*binary), text);
+        REQUIRE( text == "someXX_text_end" );
+        REQUIRE( brope_text(rope.get()) == text );
+        text.clear();
+        rope_copy_to(*binary_deleted, 0, rope_weight_total(*binary_deleted), text);
+        REQUIRE( text == "somxt_end" );
+        REQUIRE( brope_text(deleted.get()) == text );
+        rope_destroy(std::move(binary_deleted));
+    }
+
+    SECTION("same random edits"){
+        for(size_t op=0;op<2000;op++){
+            size_t weight = rope_weight_total(*binary);
+            size_t choice = random() % 100;
+            if(choice < 60 || weight < 2){
+                std::string piece(1 + random() % 40, 'a' + random() % 26);
+                RopeEffects effects = (op % 3 == 0) ? FLAG_NEW_LINE : 0;
+                size_t index = random() % weight;
+                rope_insert_at(rope.get(), index, rope_create(piece.c_str(), effects));
+                rope_insert_at(binary.get(), index, rope_create(piece.c_str(), effects));
+            }else if(choice < 90){
+                size_t index = random() % (weight - 1);
+                size_t length = 1 + random() % std::min<size_t>(weight - index - 1, 60);
+                rope_delete_at(rope.get(), index, length);
+                rope_delete_at(binary.get(), index, length);
+            }else{
+                size_t index = random() % weight;
+                size_t length = 1 + random() % (weight - index);
+                rope_insert_flag_at(rope.get(), index, length, FLAG_INVERT);
+                rope_insert_flag_at(binary.get(), index, length, FLAG_INVERT);
+            }
+            if(op % 100 == 0){
+                std::string text;
+                rope_copy_to(*binary, 0, rope_weight_total(*binary), text);
+                REQUIRE( brope_text(rope.get()) == text );
+                REQUIRE( rope_line_count(*rope) == rope_line_count(*binary) );
+            }
+        }
+        std::string text;
+        rope_copy_to(*binary, 0, rope_weight_total(*binary), text);
+        require_brope_matches(rope.get(), text);
+        REQUIRE( rope_line_count(*rope) == rope_line_count(*binary) );
+    }
+    rope_destroy(std::move(binary));
+}
@@ -0,0 +1,213 @@
+#include <catch2/catch_test_macros.hpp>
+#include <journal.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+
+
+/*
+    whole rope text
+*/
+std::string journal_rope_text(RopeNode &rope){
+    std::string text;
+    rope_copy_to(rope, 0, rope_weight_total(rope), text);
+    return text;
+}
+
+/*
+    inserts text before the character at index and records it,
+        the way a text box types
+*/
+void journal_type(RopeJournal *journal, std::unique_ptr<RopeNode> &rope, size_t index, const char *text, uint8_t flags = 0){
+    if(index == 0)
+        rope_prepend(rope.get(), rope_create(text, flags));
+    else if(index == rope->weight)
+        rope_append(rope.get(), rope_create(text, flags));
+    else
+        rope_insert_at(rope.get(), index - 1, rope_create(text, flags));
+    journal_insert(journal, *rope, index, ustrlen(text));
+}
+
+/*
+    records and deletes the codepoints [index, index+length)
+*/
+void journal_erase(RopeJournal *journal, std::unique_ptr<RopeNode> &rope, size_t index, size_t length){
+    journal_delete(journal, *rope, index, length);
+    if(index > 0){
+        rope_delete_at(rope.get(), index - 1, length);
+    }else{
+        std::unique_ptr<RopeNode> right_side = rope_split_at(rope.get(), length - 1);
+        std::swap(rope, right_side);
+        if(rope == nullptr)
+            rope = rope_create_empty();
+    }
+}
+
+
+TEST_CASE( "Journal undoes and redoes edits", "[journal_undo]" ) {
+    RopeJournal journal;
+    std::unique_ptr<RopeNode> rope = rope_create_empty();
+    size_t index = 0;
+
+    SECTION("keystrokes are coalesced"){
+        const std::string typed = "some text";
+        for(size_t i=0;i<typed.size();i++)
+            journal_type(&journal, rope, i, typed.substr(i, 1).c_str());
+        journal_type(&journal, rope, typed.size(), "line", FLAG_NEW_LINE);
+        journal_type(&journal, rope, typed.size() + 4, "next");
+
+        REQUIRE( journal.edits.size() == 3 );
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( index == typed.size() + 4 );
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == typed );
+        REQUIRE( rope_line_count(*rope) == 0 );
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( rope->weight == 0 );
+        REQUIRE_FALSE( journal_undo(&journal, rope, &index) );
+
+        REQUIRE( journal_redo(&journal, rope, &index) );
+        REQUIRE( journal_redo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == "some textline" );
+        REQUIRE( rope_line_count(*rope) == 1 );
+        REQUIRE( index == typed.size() + 4 );
+    }
+
+    SECTION("backspaces are coalesced and restore new lines"){
+        journal_type(&journal, rope, 0, "first", FLAG_NEW_LINE);
+        journal_type(&journal, rope, 5, "second", FLAG_NEW_LINE);
+        journal_seal(&journal);
+        for(size_t i=11;i-- > 3;)
+            journal_erase(&journal, rope, i, 1);
+
+        REQUIRE( journal_rope_text(*rope) == "fir" );
+        //deleting a new line is never coalesced
+        REQUIRE( journal.edits.size() == 6 );
+        while(journal_undo(&journal, rope, &index) && journal.applied > 2);
+        REQUIRE( journal_rope_text(*rope) == "firstsecond" );
+        REQUIRE( rope_line_count(*rope) == 2 );
+        REQUIRE( rope_line_to_index(*rope, 1) == 5 );
+    }
+
+    SECTION("flags are restored"){
+        journal_type(&journal, rope, 0, "some_text_more_text");
+        rope_insert_flag_at(rope.get(), 5, 4, FLAG_INVERT);
+        journal_flags(&journal, *rope, 2, 10, FLAG_NEW_LINE);
+        rope_insert_flag_at(rope.get(), 2, 10, FLAG_NEW_LINE);
+
+        //every leaf in the range ends a line
+        REQUIRE( rope_line_count(*rope) == 3 );
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( rope_line_count(*rope) == 0 );
+        size_t local_index;
+        for(size_t i=2;i<12;i++){
+            bool inverted = has_flags(&rope_node_at_index(*rope, i, &local_index)->flags, FLAG_INVERT);
+            REQUIRE( inverted == (i >= 5 && i < 9) );
+        }
+        REQUIRE( journal_redo(&journal, rope, &index) );
+        REQUIRE( rope_line_count(*rope) == 3 );
+        REQUIRE( journal_rope_text(*rope) == "some_text_more_text" );
+    }
+
+    SECTION("oldest edits are dropped over budget"){
+        for(size_t i=0;i<100;i++){
+            journal_seal(&journal);
+            journal_type(&journal, rope, rope->weight, "some words");
+        }
+        journal_budget_set(&journal, journal.bytes / 2);
+
+        REQUIRE( journal.bytes <= journal.budget );
+        REQUIRE( journal.edits.size() < 60 );
+        size_t undone = 0;
+        while(journal_undo(&journal, rope, &index))
+            undone++;
+        REQUIRE( undone == journal.edits.size() );
+        REQUIRE( rope->weight == (100 - undone) * 10 );
+    }
+
+    SECTION("groups are undone and redone as one"){
+        journal_type(&journal, rope, 0, "before");
+        journal_group_begin(&journal);
+        journal_type(&journal, rope, 6, "_typed");
+        journal_group_begin(&journal);
+        journal_erase(&journal, rope, 0, 2);
+        journal_group_end(&journal);
+        journal_flags(&journal, *rope, 0, 4, FLAG_NEW_LINE);
+        rope_insert_flag_at(rope.get(), 0, 4, FLAG_NEW_LINE);
+        journal_group_end(&journal);
+        journal_type(&journal, rope, rope->weight, "_after");
+        REQUIRE( journal_rope_text(*rope) == "fore_typed_after" );
+        const size_t lines = rope_line_count(*rope);
+        REQUIRE( lines > 0 );
+
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == "fore_typed" );
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == "before" );
+        REQUIRE( rope_line_count(*rope) == 0 );
+        REQUIRE( journal_redo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == "fore_typed" );
+        REQUIRE( rope_line_count(*rope) == lines );
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( rope->weight == 0 );
+        REQUIRE_FALSE( journal_undo(&journal, rope, &index) );
+    }
+
+    SECTION("undo inside a group doesn't join the edit before it"){
+        journal_type(&journal, rope, 0, "hello");
+        journal_seal(&journal);
+        journal_type(&journal, rope, 5, "P");
+        journal_seal(&journal);
+        journal_group_begin(&journal);
+        journal_type(&journal, rope, 6, "A");
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        journal_type(&journal, rope, 6, "B");
+        journal_group_end(&journal);
+        REQUIRE( journal_rope_text(*rope) == "helloPB" );
+
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == "helloP" );
+    }
+}
+
+TEST_CASE( "Journal replays random edits both ways", "[journal_redo]" ) {
+    std::mt19937 random(5);
+    RopeJournal journal;
+    std::unique_ptr<RopeNode> rope = rope_create_empty();
+    std::vector<std::string> texts = {""};
+    size_t index = 0;
+
+    for(size_t op=0;op<1500;op++){
+        size_t weight = rope->weight;
+        if(random() % 5 == 0)
+            journal_seal(&journal);
+        if(weight < 2 || random() % 3 != 0){
+            std::string piece(1 + random() % (op % 7 == 0 ? 20 : 2), 'a' + random() % 26);
+            if(random() % 4 == 0)
+                piece += "žć";
+            journal_type(&journal, rope, random() % (weight + 1), piece.c_str(), (op % 5 == 0) ? FLAG_NEW_LINE : 0);
+        }else{
+            size_t at = random() % (weight - 1);
+            journal_erase(&journal, rope, at, 1 + random() % std::min<size_t>(weight - at, 30));
+        }
+        if(journal.applied > texts.size() - 1)
+            texts.push_back(journal_rope_text(*rope));
+        else
+            texts.back() = journal_rope_text(*rope);
+    }
+
+    for(size_t i=texts.size()-1;i-- > 0;){
+        REQUIRE( journal_undo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == texts[i] );
+        REQUIRE( index <= rope->weight );
+    }
+    REQUIRE_FALSE( journal_undo(&journal, rope, &index) );
+    for(size_t i=1;i<texts.size();i++){
+        REQUIRE( journal_redo(&journal, rope, &index) );
+        REQUIRE( journal_rope_text(*rope) == texts[i] );
+        REQUIRE( rope_weight_measure(*rope) == rope->weight );
+    }
+}
@@ -0,0 +1,189 @@
+#include <catch2/catch_test_macros.hpp>
+#include <pattern.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <regex>
+#include <random>
+
+
+namespace Catch{
+    template<>
+    struct StringMaker<RopeMatch>{
+        static std::string convert(const RopeMatch &match){
+            return "{" + std::to_string(match.index) + ", " + std::to_string(match.length) + "}";
+        }
+    };
+}
+
+/*
+    rope out of leaves, a line ends after every leaf with a trailing '|'
+*/
+std::unique_ptr<RopeNode> pattern_rope(const std::vector<std::string> &leaves){
+    std::unique_ptr<RopeNode> rope = rope_create("");
+    for(const std::string &leaf : leaves){
+        bool line = !leaf.empty() && leaf.back() == '|';
+        std::string text = line ? leaf.substr(0, leaf.size() - 1) : leaf;
+        rope_append(rope.get(), rope_create_node(text.c_str(), line ? FLAG_NEW_LINE : 0));
+    }
+    return rope;
+}
+
+/*
+    the same search done the slow way over an ASCII string;
+        earliest match end, leftmost start for it, longest end from that start, within a line
+*/
+std::vector<RopeMatch> pattern_shadow(const std::string &text, const std::vector<size_t> &line, const std::regex &re){
+    std::vector<RopeMatch> matches;
+    size_t pos = 0;
+    while(pos < text.size()){
+        size_t start = 0, end = 0;
+        bool found = false;
+        for(end=pos+1;end<=text.size() && !found;end++){
+            for(start=pos;start<end;start++){
+                if(line[start] == line[end-1] && std::regex_match(text.begin() + start, text.begin() + end, re)){
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if(!found)
+            break;
+        end--;
+        for(size_t longer=end+1;longer<=text.size() && line[longer-1] == line[start];longer++)
+            if(std::regex_match(text.begin() + start, text.begin() + longer, re))
+                end = longer;
+        matches.push_back({start, end - start});
+        pos = end;
+    }
+    return matches;
+}
+
+
+TEST_CASE( "Patterns are compiled", "[pattern_compile]" ) {
+    REQUIRE( pattern_compile("a(b|c)*d") != nullptr );
+    REQUIRE( pattern_compile("[a-z_]+\\.log$") != nullptr );
+    REQUIRE( pattern_compile("^[^ ]+ čć.") != nullptr );
+    //invalid
+    REQUIRE( pattern_compile("a(b") == nullptr );
+    REQUIRE( pattern_compile("a)b") == nullptr );
+    REQUIRE( pattern_compile("*a") == nullptr );
+    REQUIRE( pattern_compile("[abc") == nullptr );
+    REQUIRE( pattern_compile("\\q") == nullptr );
+    REQUIRE( pattern_compile("[^č]") == nullptr );
+    //matches empty text
+    REQUIRE( pattern_compile("a*") == nullptr );
+    REQUIRE( pattern_compile("a|") == nullptr );
+}
+
+TEST_CASE( "Rope is searched with patterns", "[rope_find_pattern]" ) {
+    std::unique_ptr<RopeNode> rope = pattern_rope({"err", "or: disk ", "full|", "warning: ", "disk 42 ", "čćž|", "error: fan|", "ok"});
+
+    SECTION("matches across leaves"){
+        REQUIRE( rope_find_pattern(*rope, "error: [a-z]+") == std::vector<RopeMatch>{{0, 11}, {36, 10}} );
+        REQUIRE( rope_find_pattern(*rope, "disk \\d+") == std::vector<RopeMatch>{{25, 7}} );
+        REQUIRE( rope_find_pattern(*rope, "ć.") == std::vector<RopeMatch>{{34, 2}} );
+        REQUIRE( rope_find_pattern(*rope, "missing|nothing").empty() );
+    }
+
+    SECTION("matches stay inside lines"){
+        REQUIRE( rope_find_pattern(*rope, "full.*warning").empty() );
+        REQUIRE( rope_find_pattern(*rope, "^[a-z]+") == std::vector<RopeMatch>{{0, 5}, {16, 7}, {36, 5}, {46, 2}} );
+        REQUIRE( rope_find_pattern(*rope, "[a-z]+$") == std::vector<RopeMatch>{{12, 4}, {43, 3}, {46, 2}} );
+        REQUIRE( rope_find_pattern(*rope, "^ok$") == std::vector<RopeMatch>{{46, 2}} );
+    }
+
+    SECTION("search resumes over steps"){
+        std::unique_ptr<RopePattern> pattern = pattern_compile("[a-z]+");
+        std::vector<RopeMatch> expected = rope_find_pattern(*rope, "[a-z]+");
+        std::vector<RopeMatch> matches;
+        PatternSearch search;
+        pattern_search_begin(&search, pattern.get(), 0);
+        size_t steps = 1;
+        while(!pattern_search_step(&search, *rope, 1, matches))
+            steps++;
+        REQUIRE( steps > 4 );
+        REQUIRE( matches == expected );
+        REQUIRE( pattern_search_step(&search, *rope, 1, matches) );
+    }
+}
+
+TEST_CASE( "Pattern search matches a slow search", "[pattern_search_step]" ) {
+    std::mt19937 random(13);
+    const std::vector<std::string> atoms = {"a", "b", "c", ".", "[ab]", "[^a]", "(a|bc)", "(ab|b)"};
+    size_t checked = 0;
+    for(size_t round=0;round<300;round++){
+        std::string pattern;
+        size_t length = 1 + random() % 4;
+        for(size_t i=0;i<length;i++){
+            pattern += atoms[random() % atoms.size()];
+            size_t repeat = random() % 6;
+            pattern += repeat == 0 ? "*" : repeat == 1 ? "+" : repeat == 2 ? "?" : "";
+        }
+        if(random() % 4 == 0)
+            pattern += "|" + atoms[random() % atoms.size()];
+
+        std::vector<std::string> leaves;
+        std::string text;
+        std::vector<size_t> line;
+        size_t lines = 0;
+        for(size_t l=random() % 12 + 1;l-- > 0;){
+            std::string leaf;
+            for(size_t i=random() % 6 + 1;i-- > 0;)
+                leaf += "abc "[random() % 4];
+            text += leaf;
+            line.insert(line.end(), leaf.size(), lines);
+            if(random() % 3 == 0){
+                leaf += "|";
+                lines++;
+            }
+            leaves.push_back(leaf);
+        }
+
+        std::regex re(pattern, std::regex::ECMAScript);
+        std::unique_ptr<RopePattern> compiled = pattern_compile(pattern.c_str());
+        if(compiled == nullptr){
+            REQUIRE( std::regex_match("", re) );
+            continue;
+        }
+        std::unique_ptr<RopeNode> rope = pattern_rope(leaves);
+        std::vector<RopeMatch> matches;
+        PatternSearch search;
+        pattern_search_begin(&search, compiled.get(), 0);
+        while(!pattern_search_step(&search, *rope, 1 + random() % 8, matches));
+        INFO( "pattern: " << pattern << " text: " << text );
+        REQUIRE( matches == pattern_shadow(text, line, re) );
+        checked++;
+    }
+    REQUIRE( checked > 150 );
+}
+
+TEST_CASE( "Pattern dfa cache is flushed", "[pattern_compile]" ) {
+    std::mt19937 random(17);
+    std::vector<std::string> leaves;
+    std::string text;
+    for(size_t l=0;l<400;l++){
+        std::string leaf;
+        for(size_t i=0;i<50;i++)
+            leaf += "ab"[random() % 2];
+        leaves.push_back(leaf);
+        text += leaf;
+    }
+    //an a and twelve more, the scan dfa has a state for every 13 letter suffix
+    std::string pattern = "a";
+    for(size_t i=0;i<12;i++)
+        pattern += "[ab]";
+    std::unique_ptr<RopePattern> compiled = pattern_compile(pattern.c_str());
+    std::unique_ptr<RopeNode> rope = pattern_rope(leaves);
+    std::vector<RopeMatch> matches;
+    PatternSearch search;
+    pattern_search_begin(&search, compiled.get(), 0);
+    while(!pattern_search_step(&search, *rope, 4096, matches));
+
+    std::vector<RopeMatch> expected;
+    for(size_t p = text.find('a');p != std::string::npos && p + 13 <= text.size();p = text.find('a', p + 13))
+        expected.push_back({p, 13});
+    REQUIRE( compiled->scan.flushes > 0 );
+    REQUIRE( matches == expected );
+}
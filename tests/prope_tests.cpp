@@ -0,0 +1,187 @@
+#include <catch2/catch_test_macros.hpp>
+#include <prope.h>
+
+#include <memory>
+#include <string>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <random>
+#include <set>
+
+
+/*
+    text of the version, trough the leaf iterator
+*/
+std::string prope_text(const PRope &rope){
+    std::string text;
+    PRopeLeafIterator litrope(rope);
+    const PRopeNode *c;
+    while((c = litrope.pop()) != nullptr)
+        text += c->text.get();
+    return text;
+}
+
+/*
+    compares the version against the given text,
+        new lines are the leaves flagged with FLAG_NEW_LINE
+*/
+void require_prope_matches(const PRope &rope, const std::string &text){
+    REQUIRE( rope_weight_total(rope) == text.size() );
+    REQUIRE( prope_text(rope) == text );
+    REQUIRE( rope_is_balanced(rope) );
+
+    size_t index = 0, lines = 0;
+    PRopeLeafIterator litrope(rope);
+    const PRopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        REQUIRE( c->weight > 0 );
+        REQUIRE( c->bytes == strlen(c->text.get()) );
+        size_t local_index = 1;
+        REQUIRE( rope_node_at_index(rope, index, &local_index) == c );
+        REQUIRE( local_index == 0 );
+        index += c->weight;
+        if(c->effects.to_ulong() & FLAG_NEW_LINE)
+            lines++;
+    }
+    REQUIRE( rope_line_count(rope) == lines );
+}
+
+
+TEST_CASE( "PRope is created", "[prope_create]" ) {
+
+    SECTION("creating rope with valid text"){
+        PRope rope = prope_create("some_text", FLAG_NEW_LINE);
+
+        REQUIRE( rope != nullptr );
+        REQUIRE( rope->height == 0 );
+        REQUIRE( rope_line_count(rope) == 1 );
+        require_prope_matches(rope, "some_text");
+    }
+
+    SECTION("creating rope with text length bigger than MAX_WEIGHT"){
+        const std::string text(MAX_WEIGHT * 40, 'm');
+        PRope rope = prope_create(text.c_str(), FLAG_NEW_LINE);
+
+        REQUIRE( rope_line_count(rope) == 1 );
+        REQUIRE( rope_height_measure(rope) == rope->height );
+        require_prope_matches(rope, text);
+    }
+
+    SECTION("creating rope with empty text and NULL"){
+        REQUIRE( prope_create("") == nullptr );
+        REQUIRE( prope_create(nullptr) == nullptr );
+    }
+
+    SECTION("snapshot of a mutable rope and back"){
+        std::unique_ptr<RopeNode> mutable_rope = rope_create("some_text");
+        rope_append(mutable_rope.get(), rope_create("_line", FLAG_NEW_LINE));
+        rope_append(mutable_rope.get(), "_end");
+        PRope rope = prope_snapshot(*mutable_rope);
+
+        require_prope_matches(rope, "some_text_line_end");
+        REQUIRE( rope_line_count(rope) == 1 );
+
+        std::unique_ptr<RopeNode> thawed = prope_thaw(rope);
+        std::string text;
+        rope_copy_to(*thawed, 0, rope_weight_total(*thawed), text);
+        REQUIRE( text == "some_text_line_end" );
+        REQUIRE( rope_line_count(*thawed) == 1 );
+        REQUIRE( rope_weight_measure(*thawed) == rope_weight_total(*thawed) );
+    }
+}
+
+TEST_CASE( "PRope edits leave older versions intact", "[prope_insert_at]" ) {
+
+    SECTION("inserts, deletes and splits"){
+        PRope v0 = prope_create("some_text");
+        PRope v1 = rope_insert_at(v0, 3, "_in_");
+        PRope v2 = rope_delete_at(v1, 1, 5);
+        std::pair<PRope, PRope> v3 = rope_split_at(v1, 6);
+
+        require_prope_matches(v0, "some_text");
+        require_prope_matches(v1, "some_in__text");
+        require_prope_matches(v2, "so__text");
+        require_prope_matches(v3.first, "some_in");
+        require_prope_matches(v3.second, "__text");
+        //errors return the version unchanged
+        REQUIRE( rope_delete_at(v1, 1, 12) == v1 );
+        REQUIRE( rope_insert_at(v1, 13, "x") == v1 );
+    }
+
+    SECTION("edits share untouched subtrees"){
+        const std::string text(MAX_WEIGHT * 64, 'm');
+        PRope v0 = prope_create(text.c_str());
+        PRope v1 = rope_insert_at(v0, text.size() - 2, "end");
+
+        //only leaves on the edited path are new
+        std::set<const PRopeNode*> old_leaves;
+        PRopeLeafIterator litrope(v0);
+        const PRopeNode *c;
+        while((c = litrope.pop()) != nullptr)
+            old_leaves.insert(c);
+        size_t shared = 0;
+        litrope = PRopeLeafIterator(v1);
+        while((c = litrope.pop()) != nullptr)
+            shared += old_leaves.count(c);
+        REQUIRE( shared == old_leaves.size() - 1 );
+        REQUIRE( prope_text(v0) == text );
+        REQUIRE( prope_text(v1) == text.substr(0, text.size() - 1) + "end" + "m" );
+    }
+
+    SECTION("inserts flags"){
+        PRope v0 = prope_create("some_text_more_text");
+        PRope v1 = rope_insert_flag_at(v0, 4, 6, FLAG_INVERT | FLAG_NEW_LINE);
+
+        require_prope_matches(v1, "some_text_more_text");
+        REQUIRE( rope_line_count(v1) == 1 );
+        REQUIRE( rope_line_count(v0) == 0 );
+        size_t local_index;
+        REQUIRE( rope_node_at_index(v1, 7, &local_index)->effects.to_ulong() & FLAG_INVERT );
+        REQUIRE_FALSE( rope_node_at_index(v1, 3, &local_index)->effects.to_ulong() & FLAG_INVERT );
+        REQUIRE_FALSE( rope_node_at_index(v0, 7, &local_index)->effects.to_ulong() & FLAG_INVERT );
+    }
+
+    SECTION("copies ranges"){
+        PRope rope = rope_insert_at(prope_create("漢字 some"), 2, prope_create("čćž"));
+        std::string text;
+        REQUIRE( rope_copy_to(rope, 1, 6, text) == strlen("字 čćž") );
+        REQUIRE( text == "字 čćž" );
+    }
+}
+
+TEST_CASE( "PRope versions match plain text after random edits", "[prope_delete_at]" ) {
+    std::mt19937 random(11);
+    std::vector<std::pair<PRope, std::string>> versions;
+    PRope rope;
+    std::string text;
+
+    for(size_t op=0;op<3000;op++){
+        size_t choice = random() % 100;
+        std::string piece(1 + random() % 40, 'a' + random() % 26);
+        if(choice < 65 || text.size() < 2){
+            size_t index = text.empty() ? 0 : random() % text.size();
+            rope = rope_insert_at(rope, index, prope_create(piece.c_str(), (op % 3 == 0) ? FLAG_NEW_LINE : 0));
+            text.insert(text.empty() ? 0 : index + 1, piece);
+        }else if(choice < 95){
+            size_t index = random() % (text.size() - 1);
+            size_t length = 1 + random() % std::min<size_t>(text.size() - index - 1, 60);
+            rope = rope_delete_at(rope, index, length);
+            text.erase(index + 1, length);
+        }else{
+            size_t index = random() % text.size();
+            std::pair<PRope, PRope> sides = rope_split_at(rope, index);
+            REQUIRE( prope_text(sides.second) == text.substr(index + 1) );
+            rope = rope_concat(sides.second, sides.first);
+            text = text.substr(index + 1) + text.substr(0, index + 1);
+        }
+        if(op % 100 == 0){
+            require_prope_matches(rope, text);
+            versions.push_back({rope, text});
+        }
+    }
+    //every kept version still reads as it did
+    for(auto &version : versions)
+        REQUIRE( prope_text(version.first) == version.second );
+    REQUIRE( rope->height >= 4 );
+}
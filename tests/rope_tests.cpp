@@ -4,7 +4,13 @@
 
 #include <memory>
 #include <string>
+#include <cstring>
 #include <utility>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include <random>
+#include <thread>
 
 TEST_CASE( "Rope Node is created", "[rope_create_node]" ) {
     
@@ -68,7 +74,7 @@ TEST_CASE( "Rope Node is created", "[rope_create_node]" ) {
         REQUIRE( rope->weight == 9 );
         REQUIRE( rope->text != nullptr );
         REQUIRE( strcmp(rope->text.get(), "some_text") == 0 );
-        REQUIRE( has_flags(rope->flags.get(), FLAG_INVERT) == true );
+        REQUIRE( has_flags(&rope->flags, FLAG_INVERT) == true );
     }
 }
 
@@ -111,7 +117,7 @@ TEST_CASE( "Rope is created", "[rope_create]" ) {
         REQUIRE( rope->left->weight == 9 );
         REQUIRE( rope->left->text != nullptr );
         REQUIRE( strcmp(rope->left->text.get(), "some_text") == 0 );
-        REQUIRE( has_flags(rope->left->flags.get(), FLAG_INVERT) == true );
+        REQUIRE( has_flags(&rope->left->flags, FLAG_INVERT) == true );
 
     }
     
@@ -157,6 +163,68 @@ TEST_CASE( "Rope is destroyed", "[rope_destroy]" ) {
 
         REQUIRE( rope == nullptr );
     }
+
+    SECTION("destroyed rope is reused by the pool"){
+        const size_t length = MAX_WEIGHT*3;
+        const std::string text(length, 'm');
+        for(size_t i=0;i<64;i++){
+            std::unique_ptr<RopeNode> rope = rope_create(text.c_str());
+            rope_append(rope.get(), "_post");
+            REQUIRE( rope_weight_measure(*rope) == length + 5 );
+            rope_destroy(std::move(rope));
+        }
+    }
+
+    SECTION("trim frees destroyed ropes"){
+        rope_pool_trim();
+        const std::string text(MAX_WEIGHT * 16 + 10, 'm');
+        std::unique_ptr<RopeNode> rope = rope_create(text.c_str());
+        const size_t nodes = rope_stats(*rope).nodes;
+        rope_destroy(std::move(rope));
+
+        REQUIRE( rope_pool_trim() == nodes );
+        REQUIRE( rope_pool_trim() == 0 );
+    }
+
+    SECTION("big garbage is drained on destroy"){
+        rope_pool_trim();
+        const std::string text(2 * 1024 * 1024, 'm');
+        rope_destroy(rope_create(text.c_str()));
+
+        REQUIRE( rope_pool_trim() == 0 );
+    }
+
+    SECTION("exited thread frees it's garbage"){
+        std::thread thread([](){
+            rope_destroy(rope_create(std::string(MAX_WEIGHT * 4, 'm').c_str()));
+        });
+        thread.join();
+        //the next thread adopts the retired pool, with nothing left in it's garbage
+        size_t left = 1;
+        std::thread adopter([&left](){ left = rope_pool_trim(); });
+        adopter.join();
+        REQUIRE( left == 0 );
+    }
+}
+
+TEST_CASE( "Rope text is allocated", "[rope_text_alloc]" ) {
+
+    SECTION("freed text block is reused for the same size class"){
+        char *first;
+        {
+            RopeText text = rope_text_alloc(20);
+            REQUIRE( text != nullptr );
+            first = text.get();
+        }
+        RopeText text = rope_text_alloc(24);
+        REQUIRE( text.get() == first );
+    }
+
+    SECTION("text bigger than the biggest class"){
+        RopeText text = rope_text_alloc(MAX_WEIGHT * 16);
+        REQUIRE( text != nullptr );
+        memset(text.get(), 'm', MAX_WEIGHT * 16);
+    }
 }
 
 TEST_CASE( "Rope is concatenated", "[rope_concat]" ) {
@@ -219,9 +287,9 @@ TEST_CASE( "Rope is concatenated", "[rope_concat]" ) {
             REQUIRE( c->text != nullptr );
             rope_text += c->text.get();
             if(i==0)
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
             else{
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == false );
             }
             i++;
         }
@@ -398,9 +466,9 @@ TEST_CASE( "Rope is prepended", "[rope_prepend]" ) {
             REQUIRE( c->text != nullptr );
             rope_text += c->text.get();
             if(i==2 || i==4)
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
             else{
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == false );
             }
             i++;
         }
@@ -464,6 +532,22 @@ TEST_CASE( "Rope is prepended", "[rope_prepend]" ) {
         REQUIRE( rope_text == "some_text" );
 
     }
+
+    SECTION("prepend to a bare leaf"){
+        std::unique_ptr<RopeNode> rope = rope_create_node("abc", FLAG_INVERT);
+        rope_prepend(rope.get(), rope_create_node("def"));
+
+        REQUIRE( rope->left != nullptr );
+        REQUIRE( rope_weight_total(*rope) == 6 );
+        REQUIRE( rope_weight_measure(*rope) == 6 );
+        std::string text;
+        rope_copy_to(*rope, 0, 6, text);
+        REQUIRE( text == "defabc" );
+        //the leaf keeps it's flags under the head
+        size_t local = 0;
+        REQUIRE( has_flags(&rope_node_at_index(*rope, 4, &local)->flags, FLAG_INVERT) );
+        REQUIRE_FALSE( has_flags(&rope_node_at_index(*rope, 1, &local)->flags, FLAG_INVERT) );
+    }
 }
 
 TEST_CASE( "Rope is appended", "[rope_append]" ) {
@@ -514,9 +598,9 @@ TEST_CASE( "Rope is appended", "[rope_append]" ) {
             REQUIRE( c->text != nullptr );
             rope_text += c->text.get();
             if(i==2 || i==3)
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
             else{
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == false );
             }
             i++;
         }
@@ -549,9 +633,9 @@ TEST_CASE( "Rope is appended", "[rope_append]" ) {
             REQUIRE( c->text != nullptr );
             rope_text += c->text.get();
             if(i==2 || i==3){
-                REQUIRE(has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE(has_flags(&c->flags, FLAG_INVERT) == true );
             }else{
-                REQUIRE(has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE(has_flags(&c->flags, FLAG_INVERT) == false );
             }
 
             i++;
@@ -689,6 +773,22 @@ TEST_CASE( "Rope is appended", "[rope_append]" ) {
         REQUIRE( rope_text == "some_text" );
 
     }
+
+    SECTION("append to a bare leaf"){
+        std::unique_ptr<RopeNode> rope = rope_create_node("abc", FLAG_INVERT);
+        rope_append(rope.get(), rope_create_node("def"));
+
+        REQUIRE( rope->left != nullptr );
+        REQUIRE( rope_weight_total(*rope) == 6 );
+        REQUIRE( rope_weight_measure(*rope) == 6 );
+        std::string text;
+        rope_copy_to(*rope, 0, 6, text);
+        REQUIRE( text == "abcdef" );
+        //the leaf keeps it's flags under the head
+        size_t local = 0;
+        REQUIRE( has_flags(&rope_node_at_index(*rope, 1, &local)->flags, FLAG_INVERT) );
+        REQUIRE_FALSE( has_flags(&rope_node_at_index(*rope, 4, &local)->flags, FLAG_INVERT) );
+    }
 }
 
 
@@ -766,10 +866,10 @@ TEST_CASE( "Inserted at index inside of rope", "[rope_insert_at]" ) {
             REQUIRE( c->text != nullptr );
             rope_text += c->text.get();
             if(i==3 || i==5){
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
             }
             else{
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == false );
             }
             i++;
         }
@@ -982,7 +1082,7 @@ TEST_CASE( "Delete at index inside of rope", "[rope_delete_at]" ) {
         while((c = litrope.pop()) != nullptr){
             REQUIRE( c->text != nullptr );
             rope_text += c->text.get();
-            REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+            REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
         }
         REQUIRE( rope_text == "some_text" );
     }
@@ -1008,6 +1108,126 @@ TEST_CASE( "Delete at index inside of rope", "[rope_delete_at]" ) {
     }
 }
 
+TEST_CASE( "Range delete works in place", "[rope_delete_at]" ) {
+
+    SECTION("leaves outside the range are kept"){
+        std::unique_ptr<RopeNode> rope = rope_create("");
+        for(size_t i=0;i<1000;i++)
+            rope_append(rope.get(), rope_create_node("some line", FLAG_NEW_LINE));
+        RopeNode *first = rope_left_most_node(*rope);
+        RopeNode *last = rope_right_most_node(*rope);
+        size_t height = rope_height_measure(*rope);
+        //from the middle of line 1 to the middle of line 998
+        rope_delete_at(rope.get(), 13, 997 * 9);
+
+        REQUIRE( rope_left_most_node(*rope) == first );
+        REQUIRE( rope_right_most_node(*rope) == last );
+        REQUIRE( rope_weight_total(*rope) == 1000 * 9 - 997 * 9 );
+        REQUIRE( rope_weight_measure(*rope) == rope->weight );
+        REQUIRE( rope_line_count(*rope) == 3 );
+        REQUIRE( rope_height_measure(*rope) < height );
+        std::string text;
+        rope_copy_to(*rope, 0, rope_weight_total(*rope), text);
+        REQUIRE( text == "some linesome" + std::string(" line") + "some line" );
+    }
+
+    SECTION("matches plain text after random deletes"){
+        std::mt19937 random(3);
+        std::string text;
+        std::unique_ptr<RopeNode> rope = rope_create("");
+        for(size_t i=0;i<4000;i++){
+            std::string line = "line " + std::to_string(i) + (i % 5 == 0 ? " žć" : "");
+            rope_append(rope.get(), rope_create_node(line.c_str(), (i % 3 == 0) ? FLAG_NEW_LINE : 0));
+            text += line;
+        }
+        size_t weight = ustrlen(text);
+        while(weight > 100){
+            size_t index = random() % (weight - 1);
+            size_t length = 1 + random() % std::min<size_t>(weight - index - 1, 2000);
+            rope_delete_at(rope.get(), index, length);
+            size_t b_index = u_index_at(text.c_str(), index + 1);
+            text.erase(b_index, u_index_at(text.c_str() + b_index, length));
+            weight -= length;
+
+            std::string rope_text;
+            rope_copy_to(*rope, 0, rope_weight_total(*rope), rope_text);
+            REQUIRE( rope_text == text );
+            REQUIRE( rope_weight_measure(*rope) == rope->weight );
+            size_t lines = rope_line_count(*rope);
+            REQUIRE( rope_lines_measure_set(rope.get()) == lines );
+            REQUIRE( rope_is_balanced(*(rope->left)) );
+        }
+    }
+}
+
+TEST_CASE( "Rope leaves are compacted", "[rope_compact]" ) {
+    std::unique_ptr<RopeNode> rope = rope_create("");
+    std::string text;
+    //typed a character at a time, every 100th ends a line, 350 to 449 inverted
+    for(size_t i=0;i<2000;i++){
+        char typed[2] = {(char)('a' + i % 26), 0};
+        uint8_t flags = (i % 100 == 99 ? FLAG_NEW_LINE : 0) | (i >= 350 && i < 450 ? FLAG_INVERT : 0);
+        rope_append(rope.get(), rope_create_node(typed, flags));
+        text += typed;
+    }
+    auto leaf_count = [](RopeNode *rope){
+        size_t count = 0;
+        RopeLeafIterator litrope(rope);
+        while(litrope.pop() != nullptr)
+            count++;
+        return count;
+    };
+    auto require_intact = [&](){
+        std::string rope_text;
+        rope_copy_to(*rope, 0, rope_weight_total(*rope), rope_text);
+        REQUIRE( rope_text == text );
+        REQUIRE( rope_weight_measure(*rope) == rope->weight );
+        REQUIRE( rope_line_count(*rope) == 20 );
+        REQUIRE( rope_is_balanced(*(rope->left)) );
+        for(size_t line=1;line<=20;line++)
+            REQUIRE( rope_line_to_index(*rope, line) == line * 100 );
+        size_t local_index;
+        for(size_t i=0;i<2000;i+=50)
+            REQUIRE( has_flags(&rope_node_at_index(*rope, i, &local_index)->flags, FLAG_INVERT) == (i >= 350 && i < 450) );
+    };
+
+    SECTION("a range merges only the leaves covering it"){
+        REQUIRE( rope_compact(rope.get(), 1010, 1050) == 40 - 1 );
+        REQUIRE( leaf_count(rope.get()) == 2001 - 39 );
+        REQUIRE( rope_compact(rope.get(), 1010, 1050) == 0 );
+        require_intact();
+    }
+
+    SECTION("whole rope merges up to new lines and flag changes"){
+        size_t before = leaf_count(rope.get());
+        size_t removed = rope_compact(rope.get());
+
+        //a leaf per line, two more where inverted text starts and ends mid line;
+        //18 plain lines of 100 and 4 runs of 50, more leaves each when MAX_WEIGHT is smaller
+        const size_t expected = 18 * ((100 + MAX_WEIGHT - 1) / MAX_WEIGHT) + 4 * ((50 + MAX_WEIGHT - 1) / MAX_WEIGHT);
+        REQUIRE( leaf_count(rope.get()) == expected );
+        REQUIRE( removed == before - expected );
+        require_intact();
+    }
+
+    SECTION("merged leaves stay under MAX_WEIGHT"){
+        std::unique_ptr<RopeNode> long_rope = rope_create("");
+        for(size_t i=0;i<3 * MAX_WEIGHT;i++)
+            rope_append(long_rope.get(), "x");
+        rope_compact(long_rope.get());
+
+        RopeLeafIterator litrope(long_rope.get());
+        RopeNode *c;
+        size_t leaves = 0;
+        while((c = litrope.pop()) != nullptr){
+            REQUIRE( c->weight <= MAX_WEIGHT );
+            leaves += c->weight > 0;
+        }
+        REQUIRE( leaves == 3 );
+        REQUIRE( rope_weight_total(*long_rope) == 3 * MAX_WEIGHT );
+    }
+}
+
 TEST_CASE( "Measure rope weight", "[rope_weight_measure]" ) {
 
     SECTION("measure weight of the rope"){
@@ -1169,6 +1389,21 @@ TEST_CASE( "Rope splited at index", "[rope_split_at]" ) {
 
     }
 
+    SECTION("split line keeps it's effects, new line only on the right"){
+        std::unique_ptr<RopeNode> rope = rope_create("some_text_some_more_text", FLAG_NEW_LINE | FLAG_INVERT);
+        std::unique_ptr<RopeNode> new_rope = rope_split_at(rope.get(), 10);
+
+        REQUIRE( new_rope != nullptr );
+        RopeNode *left = rope_left_most_node(*rope);
+        RopeNode *right = rope_left_most_node(*new_rope);
+        REQUIRE( has_flags(&left->flags, FLAG_INVERT) );
+        REQUIRE_FALSE( has_flags(&left->flags, FLAG_NEW_LINE) );
+        REQUIRE( has_flags(&right->flags, FLAG_INVERT) );
+        REQUIRE( has_flags(&right->flags, FLAG_NEW_LINE) );
+        REQUIRE( rope_line_count(*rope) == 0 );
+        REQUIRE( rope_line_count(*new_rope) == 1 );
+    }
+
     SECTION("splits the rope at the given index, latinica"){
         std::unique_ptr<RopeNode> rope = rope_create("šođe_tešt_some_more_text");
         std::unique_ptr<RopeNode> new_rope = rope_split_at(rope.get(), 10);
@@ -1254,11 +1489,10 @@ TEST_CASE( "Insert flags at index", "[rope_insert_flag_at]" ) {
         RopeNode *c;
         size_t i=0;
         while((c = litrope.pop()) != nullptr){
-            REQUIRE( c->flags.get() != nullptr );
             if(i>8 && i<21)
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
             else
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == false );
             
             i += c->weight;
         }
@@ -1280,11 +1514,10 @@ TEST_CASE( "Insert flags at index", "[rope_insert_flag_at]" ) {
         RopeNode *c;
         size_t i=0;
         while((c = litrope.pop()) != nullptr){
-            REQUIRE( c->flags.get() != nullptr );
             if(i>3 && i<20)
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
             else
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == false );
             
             i += c->weight;
         }
@@ -1307,15 +1540,673 @@ TEST_CASE( "Insert flags at index", "[rope_insert_flag_at]" ) {
         RopeNode *c;
         size_t i=0;
         while((c = litrope.pop()) != nullptr){
-            REQUIRE( c->flags.get() != nullptr );
             if(i>3 && i<23)
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == true );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == true );
             else
-                REQUIRE( has_flags(c->flags.get(), FLAG_INVERT) == false );
+                REQUIRE( has_flags(&c->flags, FLAG_INVERT) == false );
             
             i += c->weight;
         }
     
     }
 
-}
\ No newline at end of file
+}
+
+/*
+    compares line lookups against a plain walk over the leaves
+*/
+void require_lines_match(RopeNode *rope){
+    std::vector<size_t> line_starts = {0};
+    size_t index = 0;
+    RopeLeafIterator litrope(rope);
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        for(size_t i=0;i<c->weight;i++)
+            REQUIRE( rope_index_to_line(*rope, index + i) == line_starts.size() - 1 );
+        index += c->weight;
+        if(has_flags(&c->flags, FLAG_NEW_LINE))
+            line_starts.push_back(index);
+    }
+
+    REQUIRE( rope_line_count(*rope) == line_starts.size() - 1 );
+    for(size_t line=0;line<line_starts.size();line++)
+        REQUIRE( rope_line_to_index(*rope, line) == line_starts[line] );
+}
+
+TEST_CASE( "Rope lines are counted", "[rope_line_count]" ) {
+
+    SECTION("counts new lines of the created rope"){
+        std::unique_ptr<RopeNode> rope = rope_create("some_text", FLAG_NEW_LINE);
+
+        REQUIRE( rope_line_count(*rope) == 1 );
+        REQUIRE( rope_line_to_index(*rope, 1) == 9 );
+        REQUIRE( rope_index_to_line(*rope, 8) == 0 );
+    }
+
+    SECTION("counts new lines of the appended and prepended rope"){
+        std::unique_ptr<RopeNode> rope = rope_create("some_text");
+        rope_append(rope.get(), rope_create("_line", FLAG_NEW_LINE));
+        rope_append(rope.get(), "_iap");
+        rope_append(rope.get(), rope_create("_line", FLAG_NEW_LINE));
+        rope_prepend(rope.get(), rope_create("first", FLAG_NEW_LINE));
+        rope_prepend(rope.get(), "pre");
+
+        REQUIRE( rope_line_count(*rope) == 3 );
+        require_lines_match(rope.get());
+    }
+
+    SECTION("counts new lines of the concatenated rope"){
+        std::unique_ptr<RopeNode> left = rope_create("some", FLAG_NEW_LINE);
+        rope_append(left.get(), rope_create("_text", FLAG_NEW_LINE));
+        std::unique_ptr<RopeNode> right = rope_create("more", FLAG_NEW_LINE);
+        std::unique_ptr<RopeNode> rope = rope_concat(std::move(left), std::move(right));
+
+        REQUIRE( rope_line_count(*rope) == 3 );
+        require_lines_match(rope.get());
+    }
+
+    SECTION("empty rope has no lines"){
+        std::unique_ptr<RopeNode> rope = rope_create("");
+
+        REQUIRE( rope_line_count(*rope) == 0 );
+        REQUIRE( rope_line_to_index(*rope, 0) == 0 );
+    }
+}
+
+TEST_CASE( "Rope lines follow edits", "[rope_line_to_index]" ) {
+    std::unique_ptr<RopeNode> rope = rope_create("some_text");
+    for(size_t i=0;i<16;i++){
+        rope_append(rope.get(), "_iap");
+        rope_append(rope.get(), rope_create("_line", FLAG_NEW_LINE));
+    }
+
+    SECTION("after insert"){
+        rope_insert_at(rope.get(), 11, "inserted");
+        rope_insert_at(rope.get(), 40, rope_create("new_line", FLAG_NEW_LINE));
+
+        REQUIRE( rope_line_count(*rope) == 17 );
+        require_lines_match(rope.get());
+    }
+
+    SECTION("after delete"){
+        rope_delete_at(rope.get(), 5, 20);
+
+        require_lines_match(rope.get());
+    }
+
+    SECTION("after split"){
+        std::unique_ptr<RopeNode> right = rope_split_at(rope.get(), 30);
+
+        REQUIRE( rope_line_count(*rope) + rope_line_count(*right) == 16 );
+        require_lines_match(rope.get());
+        require_lines_match(right.get());
+    }
+
+    SECTION("after inserting new line flag"){
+        rope_insert_flag_at(rope.get(), 3, 4, FLAG_NEW_LINE);
+
+        REQUIRE( rope_line_count(*rope) == 17 );
+        require_lines_match(rope.get());
+    }
+
+    SECTION("after rebalance"){
+        rope = rope_rebalance(std::move(rope));
+
+        REQUIRE( rope_line_count(*rope) == 16 );
+        require_lines_match(rope.get());
+    }
+
+    SECTION("line past the last one is rejected"){
+        REQUIRE( rope_line_to_index(*rope, 17) == rope_weight_total(*rope) );
+        REQUIRE( rope_index_to_line(*rope, rope_weight_total(*rope)) == 16 );
+    }
+}
+
+TEST_CASE( "Rope keeps itself balanced", "[rope_height_measure]" ) {
+
+    SECTION("height stays logarithmic while appending lines"){
+        const size_t count = 1000000;
+        std::unique_ptr<RopeNode> rope = rope_create("");
+        for(size_t i=0;i<count;i++)
+            rope_append(rope.get(), rope_create_node("short line", FLAG_NEW_LINE));
+
+        REQUIRE( rope_weight_total(*rope) == count * 10 );
+        REQUIRE( rope_line_count(*rope) == count );
+        //AVL height is under 1.45*log2(count), plus the head
+        REQUIRE( rope_height_measure(*rope) <= 30 );
+        REQUIRE( rope_height_measure(*rope) == rope->height );
+        REQUIRE( rope_is_balanced(*(rope->left)) );
+        REQUIRE( rope_line_to_index(*rope, count / 2) == (count / 2) * 10 );
+        REQUIRE( rope_index_to_line(*rope, count * 10 - 1) == count - 1 );
+    }
+
+    SECTION("height stays logarithmic while prepending and inserting"){
+        const size_t count = 100000;
+        std::unique_ptr<RopeNode> rope = rope_create("some_text");
+        for(size_t i=0;i<count;i++){
+            rope_prepend(rope.get(), "pre");
+            rope_insert_at(rope.get(), rope->weight / 2, "in");
+        }
+
+        REQUIRE( rope->weight == 9 + count * 5 );
+        REQUIRE( rope_height_measure(*rope) <= 26 );
+        REQUIRE( rope_height_measure(*rope) == rope->height );
+        REQUIRE( rope_is_balanced(*(rope->left)) );
+    }
+}
+
+/*
+    cached byte length and ascii bit agree with the leaf text
+*/
+void require_leaves_measured(RopeNode *rope){
+    RopeLeafIterator litrope(rope);
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        REQUIRE( c->bytes == strlen(c->text.get()) );
+        REQUIRE( c->weight == ustrlen(c->text.get()) );
+        REQUIRE( c->ascii == (c->weight == c->bytes) );
+    }
+}
+
+TEST_CASE( "Leaves cache byte length", "[rope_leaf_text_set]" ) {
+
+    SECTION("ascii leaf"){
+        std::unique_ptr<RopeNode> node = rope_create_node("some_text");
+
+        REQUIRE( node->bytes == 9 );
+        REQUIRE( node->ascii );
+        REQUIRE( rope_leaf_offset(*node, 4) == 4 );
+        REQUIRE( rope_leaf_offset(*node, 20) == 9 );
+    }
+
+    SECTION("non ascii leaf"){
+        std::unique_ptr<RopeNode> node = rope_create_node("čćž_text");
+
+        REQUIRE( node->weight == 8 );
+        REQUIRE( node->bytes == 11 );
+        REQUIRE_FALSE( node->ascii );
+        REQUIRE( rope_leaf_offset(*node, 2) == 4 );
+        REQUIRE( rope_leaf_offset(*node, 4) == 7 );
+    }
+
+    SECTION("leaves stay measured trough edits"){
+        std::unique_ptr<RopeNode> rope = rope_create("čćž_some_text");
+        rope_append(rope.get(), "_more_text");
+        rope_insert_at(rope.get(), 5, "漢字");
+        rope_delete_at(rope.get(), 1, 3);
+        std::unique_ptr<RopeNode> right = rope_split_at(rope.get(), 6);
+        rope_append(rope.get(), std::string(MAX_WEIGHT * 2 + 3, 'm').c_str());
+
+        REQUIRE( rope_weight_measure(*rope) == rope_weight_total(*rope) );
+        require_leaves_measured(rope.get());
+        require_leaves_measured(right.get());
+    }
+
+    SECTION("short text stays inside the node"){
+        const std::string short_text(RopePolicy::inlineText - 2, 's');
+        const std::string long_text(RopePolicy::inlineText - 1, 'l');
+        std::unique_ptr<RopeNode> node = rope_create_node(short_text.c_str());
+        REQUIRE( node->text.get() == node->inlineText + 1 );
+        REQUIRE( std::string(node->text.get()) == short_text );
+
+        rope_leaf_text_set(node.get(), long_text.data(), long_text.size());
+        REQUIRE( node->text.get() != node->inlineText + 1 );
+        REQUIRE( std::string(node->text.get()) == long_text );
+
+        //cut to it's own prefix, back inside
+        rope_leaf_text_set(node.get(), node->text.get(), 3);
+        REQUIRE( node->text.get() == node->inlineText + 1 );
+        REQUIRE( std::string(node->text.get()) == "lll" );
+        rope_leaf_text_set(node.get(), node->text.get() + 1, 2);
+        REQUIRE( std::string(node->text.get()) == "ll" );
+        REQUIRE( node->bytes == 2 );
+    }
+
+    SECTION("inline leaf as the head"){
+        for(int edit=0;edit<3;edit++){
+            std::unique_ptr<RopeNode> rope = rope_create_node("abcdef");
+            REQUIRE( rope->text.get() == rope->inlineText + 1 );
+            std::string expected;
+            if(edit == 0){
+                rope_append(rope.get(), rope_create_node("line", FLAG_NEW_LINE));
+                expected = "abcdefline";
+            }else if(edit == 1){
+                rope_prepend(rope.get(), rope_create_node("line", FLAG_NEW_LINE));
+                expected = "lineabcdef";
+            }else{
+                rope_delete_at(rope.get(), 1, 2);
+                expected = "abef";
+            }
+
+            std::string out;
+            rope_copy_to(*rope, 0, rope_weight_total(*rope), out);
+            REQUIRE( out == expected );
+            REQUIRE( rope_weight_measure(*rope) == expected.size() );
+            REQUIRE( rope_line_count(*rope) == (edit < 2 ? 1 : 0) );
+            require_leaves_measured(rope.get());
+            rope_destroy(std::move(rope));
+        }
+    }
+
+    SECTION("inline leaves survive splits and compaction"){
+        std::unique_ptr<RopeNode> rope = rope_create("");
+        std::string text;
+        for(size_t i=0;i<200;i++){
+            std::string piece = "ab" + std::to_string(i);
+            rope_append(rope.get(), piece.c_str());
+            text += piece;
+        }
+        std::unique_ptr<RopeNode> right = rope_split_at(rope.get(), 100);
+        rope_delete_at(rope.get(), 10, 20);
+        text.erase(11, 20);
+        rope_compact(rope.get());
+
+        std::string out;
+        rope_copy_to(*rope, 0, rope_weight_total(*rope), out);
+        REQUIRE( out == text.substr(0, 81) );
+        out.clear();
+        rope_copy_to(*right, 0, rope_weight_total(*right), out);
+        REQUIRE( out == text.substr(81) );
+        require_leaves_measured(rope.get());
+        require_leaves_measured(right.get());
+    }
+}
+
+TEST_CASE( "Leaf iterators walk without a stack", "[RopeLeafIterator]" ) {
+
+    SECTION("forward and back over a balanced rope"){
+        std::unique_ptr<RopeNode> rope = rope_create("0");
+        for(size_t i=1;i<1000;i++)
+            rope_append(rope.get(), std::to_string(i % 10).c_str());
+
+        RopeLeafIterator litrope(rope.get(), 500);
+        REQUIRE( litrope.local_start_index() == 0 );
+        size_t count = 0;
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr){
+            REQUIRE( std::string(c->text.get()) == std::to_string((500 + count) % 10) );
+            count++;
+        }
+        REQUIRE( count == 500 );
+
+        RopeLeafIteratorBack blitrope(rope.get(), 500);
+        count = 0;
+        while((c = blitrope.pop()) != nullptr){
+            REQUIRE( std::string(c->text.get()) == std::to_string((1000 + 500 - count) % 10) );
+            count++;
+        }
+        REQUIRE( count == 501 );
+    }
+
+    SECTION("hand built rope deeper than the path"){
+        const size_t leaves = ROPE_PATH_MAX * 2;
+        std::unique_ptr<RopeNode> rope = rope_create_node("0");
+        for(size_t i=1;i<leaves;i++)
+            rope = rope_concat(std::move(rope), rope_create_node(std::to_string(i % 10).c_str()));
+        for(size_t i=0;i<leaves;i++)
+            rope = rope_concat(rope_create_node(std::to_string(i % 10).c_str()), std::move(rope));
+        REQUIRE( rope_height_measure(*rope) > ROPE_PATH_MAX );
+
+        std::string forward, back;
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr)
+            forward += c->text.get();
+        RopeLeafIteratorBack blitrope(rope.get(), rope_weight_total(*rope) - 1);
+        while((c = blitrope.pop()) != nullptr)
+            back.insert(0, c->text.get());
+
+        REQUIRE( forward.size() == leaves * 2 );
+        REQUIRE( forward == back );
+        REQUIRE( forward.substr(leaves - 3, 6) == "210012" );
+    }
+}
+
+TEST_CASE( "Rope chunks view text in range", "[rope_chunks]" ) {
+    std::unique_ptr<RopeNode> rope = rope_create("čćž_some");
+    rope_append(rope.get(), "_text");
+    rope_append(rope.get(), rope_create("_漢字", FLAG_NEW_LINE));
+    rope_append(rope.get(), "_end");
+    const std::string text = "čćž_some_text_漢字_end";
+
+    SECTION("whole rope"){
+        std::vector<std::string_view> chunks;
+        for(std::string_view chunk : rope_chunks(*rope, 0, rope_weight_total(*rope)))
+            chunks.push_back(chunk);
+
+        REQUIRE( chunks.size() == 4 );
+        REQUIRE( chunks[0] == "čćž_some" );
+        REQUIRE( chunks[2] == "_漢字" );
+    }
+
+    SECTION("trimmed at both ends"){
+        std::string joined;
+        for(std::string_view chunk : rope_chunks(*rope, 2, 15))
+            joined += chunk;
+
+        REQUIRE( joined == "ž_some_text_漢" );
+    }
+
+    SECTION("copy to buffer"){
+        for(size_t begin=0;begin<ustrlen(text);begin++){
+            for(size_t end=begin;end<=ustrlen(text)+2;end++){
+                std::string buffer = "pre";
+                size_t bytes = rope_copy_to(*rope, begin, end, buffer);
+                size_t b_begin = u_index_at(text.c_str(), begin);
+                size_t b_end = u_index_at(text.c_str(), end);
+
+                REQUIRE( buffer == "pre" + text.substr(b_begin, b_end - b_begin) );
+                REQUIRE( bytes == b_end - b_begin );
+            }
+        }
+    }
+
+    SECTION("empty and out of range"){
+        std::string buffer;
+
+        REQUIRE( rope_copy_to(*rope, 5, 5, buffer) == 0 );
+        REQUIRE( rope_copy_to(*rope, 100, 200, buffer) == 0 );
+        REQUIRE( buffer.empty() );
+    }
+}
+
+TEST_CASE( "Rope is built from a large buffer", "[rope_build]" ) {
+    std::string text;
+    for(size_t i=0;text.size()<MAX_WEIGHT * 300;i++)
+        text += (i % 7 == 0) ? "漢字čćž " : "some log text ";
+
+    SECTION("leaves are cut on codepoint boundaries"){
+        std::unique_ptr<RopeNode> rope = rope_build(text.c_str(), text.size(), FLAG_NEW_LINE);
+
+        REQUIRE( rope_weight_total(*rope) == ustrlen(text) );
+        REQUIRE( rope_line_count(*rope) == 1 );
+        REQUIRE( rope_is_balanced(*(rope->left)) );
+        std::string copy;
+        rope_copy_to(*rope, 0, rope_weight_total(*rope), copy);
+        REQUIRE( copy == text );
+
+        size_t leaves = 0, new_lines = 0;
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c, *last = nullptr;
+        while((c = litrope.pop()) != nullptr){
+            REQUIRE( c->weight <= MAX_WEIGHT );
+            REQUIRE( (c->text[0] & 0xc0) != 0x80 );
+            new_lines += has_flags(&c->flags, FLAG_NEW_LINE) ? 1 : 0;
+            last = c;
+            leaves++;
+        }
+        REQUIRE( leaves == (ustrlen(text) + MAX_WEIGHT - 1) / MAX_WEIGHT );
+        REQUIRE( new_lines == 1 );
+        REQUIRE( has_flags(&last->flags, FLAG_NEW_LINE) );
+        require_leaves_measured(rope.get());
+    }
+
+    SECTION("buffer needn't be NUL terminated"){
+        std::unique_ptr<RopeNode> rope = rope_build(text.c_str(), 13, 0);
+
+        REQUIRE( rope_weight_total(*rope) == 6 );
+        REQUIRE( std::string(rope->left->text.get()) == "漢字čćž " );
+    }
+
+    SECTION("empty buffer"){
+        std::unique_ptr<RopeNode> rope = rope_build("", 0, 0);
+
+        REQUIRE( rope != nullptr );
+        REQUIRE( rope_weight_total(*rope) == 0 );
+    }
+}
+
+/*
+    rows the rope takes when drawn width columns wide, by the rules drawing follows;
+        text wraps at the width, a new line moves down unless the row is still empty
+*/
+size_t drawn_rows(RopeNode *rope, size_t width){
+    size_t x = 0, y = 0;
+    RopeLeafIterator litrope(rope);
+    RopeNode *c;
+    while((c = litrope.pop()) != nullptr){
+        if(c->text == nullptr)
+            continue;
+        for(size_t i=0;i<c->weight;i++){
+            if(++x >= width){
+                y++;
+                x = 0;
+            }
+        }
+        if(x > 0 && has_flags(&c->flags, FLAG_NEW_LINE)){
+            x = 0;
+            y++;
+        }
+    }
+    return y + (x > 0 ? 1 : 0);
+}
+
+TEST_CASE( "Mapped blank lines are drawn", "[rope_map_file]" ) {
+    const char *path = "rope_map_file_blank_test.txt";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "ab\n\ncd\n\n\nef";
+    }
+    std::unique_ptr<RopeNode> rope = rope_map_file(path);
+    std::remove(path);
+
+    REQUIRE( rope != nullptr );
+    REQUIRE( rope_line_count(*rope) == 5 );
+    //every line starts at it's own index, blank ones on their space
+    const size_t starts[] = {0, 2, 3, 5, 6, 7};
+    for(size_t line=0;line<6;line++){
+        REQUIRE( rope_line_to_index(*rope, line) == starts[line] );
+        REQUIRE( rope_index_to_line(*rope, starts[line]) == line );
+    }
+    REQUIRE( drawn_rows(rope.get(), 80) == 6 );
+    std::string copy;
+    rope_copy_to(*rope, 0, rope_weight_total(*rope), copy);
+    REQUIRE( copy == "ab cd  ef" );
+    rope_destroy(std::move(rope));
+}
+
+TEST_CASE( "Rope is mapped from a file", "[rope_map_file]" ) {
+    const char *path = "rope_map_file_test.txt";
+    std::string long_line(MAX_WEIGHT * 2 + 10, 'l');
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "first line\n" << "čćž line\n" << "\n" << long_line << "\n" << "no new line";
+    }
+    std::unique_ptr<RopeNode> rope = rope_map_file(path);
+    std::remove(path);
+    //the blank line holds a space
+    const std::string text = "first linečćž line " + long_line + "no new line";
+
+    SECTION("leaves point into the file"){
+        REQUIRE( rope != nullptr );
+        REQUIRE( rope_weight_total(*rope) == ustrlen(text) );
+        REQUIRE( rope_line_count(*rope) == 4 );
+        REQUIRE( rope_line_to_index(*rope, 2) == 18 );
+        REQUIRE( rope_line_to_index(*rope, 3) == 19 );
+        std::string copy;
+        rope_copy_to(*rope, 0, rope_weight_total(*rope), copy);
+        REQUIRE( copy == text );
+
+        RopeLeafIterator litrope(rope.get());
+        RopeNode *c;
+        while((c = litrope.pop()) != nullptr){
+            REQUIRE( c->weight > 0 );
+            REQUIRE( c->weight <= MAX_WEIGHT );
+            if(!c->mapped)
+                REQUIRE( std::string(c->text.get()) == " " );
+        }
+    }
+
+    SECTION("edits copy mapped leaves"){
+        rope_insert_at(rope.get(), 4, "_edit");
+        rope_delete_at(rope.get(), 12, 3);
+        std::unique_ptr<RopeNode> right = rope_split_at(rope.get(), 30);
+
+        std::string copy;
+        rope_copy_to(*rope, 0, rope_weight_total(*rope), copy);
+        rope_copy_to(*right, 0, rope_weight_total(*right), copy);
+        std::string expected = text;
+        expected.insert(5, "_edit");
+        //deletes after index
+        expected.erase(u_index_at(expected.c_str(), 13), u_index_at(expected.c_str(), 16) - u_index_at(expected.c_str(), 13));
+        REQUIRE( copy == expected );
+        REQUIRE( rope_node_at_index(*rope, 5, nullptr)->mapped == false );
+        require_lines_match(rope.get());
+        rope_destroy(std::move(right));
+    }
+
+    SECTION("split mapped leaves keep the file mapped"){
+        std::unique_ptr<RopeNode> right = rope_split_at(rope.get(), 3);
+        rope_destroy(std::move(rope));
+        std::string copy;
+        rope_copy_to(*right, 0, rope_weight_total(*right), copy);
+        REQUIRE( copy == text.substr(4) );
+        rope = std::move(right);
+    }
+
+    SECTION("destroyed mapped rope is freed at once"){
+        rope_destroy(std::move(rope));
+        REQUIRE( rope_pool_trim() == 0 );
+        return;
+    }
+
+    SECTION("missing file"){
+        REQUIRE( rope_map_file("no_such_file.txt") == nullptr );
+    }
+    rope_destroy(std::move(rope));
+}
+
+TEST_CASE( "Rope stats describe shape and memory", "[rope_stats]" ) {
+
+    SECTION("single leaf"){
+        std::unique_ptr<RopeNode> rope = rope_create("some_text");
+        RopeStats stats = rope_stats(*rope);
+        REQUIRE( stats.nodes == 2 );
+        REQUIRE( stats.leaves == 1 );
+        REQUIRE( stats.height == 1 );
+        REQUIRE( stats.textBytes == 9 );
+        REQUIRE( stats.mappedBytes == 0 );
+        REQUIRE( stats.fill[std::min(ROPE_STATS_FILL_BUCKETS - 1, 9 * ROPE_STATS_FILL_BUCKETS / MAX_WEIGHT)] == 1 );
+        REQUIRE( stats.flagRuns == 1 );
+        //node blocks, short text is kept inside the leaf node, otherwise in a 16 byte text block
+        if(9 + 2 <= RopePolicy::inlineText)
+            REQUIRE( stats.overheadBytes == 2 * sizeof(RopeNode) );
+        else
+            REQUIRE( stats.overheadBytes >= 2 * sizeof(RopeNode) + 7 );
+    }
+
+    SECTION("built rope"){
+        const std::string text(MAX_WEIGHT * 16 + 10, 'm');
+        std::unique_ptr<RopeNode> rope = rope_create(text.c_str());
+        RopeStats stats = rope_stats(*rope);
+        //balanced binary tree under the head
+        REQUIRE( stats.leaves == 17 );
+        REQUIRE( stats.nodes == 2 * stats.leaves );
+        REQUIRE( stats.height == rope_height_measure(*rope) );
+        REQUIRE( stats.textBytes == text.size() );
+        size_t filled = 0;
+        for(size_t bucket : stats.fill)
+            filled += bucket;
+        REQUIRE( filled == stats.leaves );
+        REQUIRE( stats.fill[ROPE_STATS_FILL_BUCKETS - 1] == stats.leaves );
+    }
+
+    SECTION("typed leaves and flag runs"){
+        std::unique_ptr<RopeNode> rope = rope_create("");
+        for(size_t i=0;i<40;i++)
+            rope_append(rope.get(), rope_create_node("x", (i % 10 == 9) ? FLAG_NEW_LINE : 0));
+        rope_insert_flag_at(rope.get(), 5, 10, FLAG_INVERT);
+        RopeStats stats = rope_stats(*rope);
+        REQUIRE( stats.leaves == 41 );
+        REQUIRE( stats.fill[0] == 41 );
+        //plain, inverted, plain; new lines don't start runs
+        REQUIRE( stats.flagRuns == 3 );
+
+        rope_compact(rope.get());
+        RopeStats compacted = rope_stats(*rope);
+        REQUIRE( compacted.leaves < stats.leaves );
+        REQUIRE( compacted.overheadBytes < stats.overheadBytes );
+        REQUIRE( compacted.textBytes == stats.textBytes );
+        rope_destroy(std::move(rope));
+    }
+}
+
+/*
+    same shape, caches and leaf text, node by node
+*/
+bool same_tree(const RopeNode &a, const RopeNode &b){
+    if(a.weight != b.weight || a.height != b.height || a.flags.effects != b.flags.effects)
+        return false;
+    if((a.left == nullptr) != (b.left == nullptr) || (a.right == nullptr) != (b.right == nullptr))
+        return false;
+    if(a.left == nullptr && a.right == nullptr){
+        if((a.text == nullptr) != (b.text == nullptr))
+            return false;
+        return a.text == nullptr ||
+            (a.bytes == b.bytes && a.ascii == b.ascii && a.mapped == b.mapped && memcmp(a.text.get(), b.text.get(), a.bytes) == 0);
+    }
+    if(a.lines != b.lines)
+        return false;
+    return (a.left == nullptr || same_tree(*a.left, *b.left)) && (a.right == nullptr || same_tree(*a.right, *b.right));
+}
+
+TEST_CASE( "Parallel builds match serial ones", "[rope_build_threads]" ) {
+    const size_t threads = rope_build_threads();
+    //enough leaves for the build to be cut in parts
+    std::mt19937 random(11);
+    std::string text;
+    const char *words[] = {"some ", "log ", "line ", "čćž ", "漢字 ", "\n"};
+    for(size_t weight=0;weight < MAX_WEIGHT * 32768;){
+        const char *word = words[random() % 6];
+        text += word;
+        weight += ustrlen(word);
+    }
+
+    SECTION("rope_build"){
+        rope_build_threads_set(1);
+        std::unique_ptr<RopeNode> serial = rope_build(text.data(), text.size(), FLAG_INVERT);
+        rope_build_threads_set(4);
+        std::unique_ptr<RopeNode> parallel = rope_build(text.data(), text.size(), FLAG_INVERT);
+        REQUIRE( rope_weight_total(*parallel) == ustrlen(text) );
+        REQUIRE( same_tree(*serial, *parallel) );
+        rope_destroy(std::move(serial));
+        rope_destroy(std::move(parallel));
+    }
+
+    SECTION("rope_rebalance"){
+        rope_build_threads_set(1);
+        std::unique_ptr<RopeNode> serial = rope_create(text.c_str());
+        std::unique_ptr<RopeNode> parallel = rope_create(text.c_str());
+        for(size_t i=0;i<2000;i++){
+            size_t index = random() % (rope_weight_total(*serial) - 1);
+            rope_insert_at(serial.get(), index, "typed");
+            rope_insert_at(parallel.get(), index, "typed");
+        }
+        serial = rope_rebalance(std::move(serial));
+        rope_build_threads_set(4);
+        parallel = rope_rebalance(std::move(parallel));
+        REQUIRE( rope_weight_total(*parallel) == ustrlen(text) + 2000 * 5 );
+        REQUIRE( same_tree(*serial, *parallel) );
+        rope_destroy(std::move(serial));
+        rope_destroy(std::move(parallel));
+    }
+
+    SECTION("rope_map_file"){
+        const char *path = "rope_build_threads_test.txt";
+        {
+            std::ofstream file(path, std::ios::binary);
+            file << text;
+        }
+        rope_build_threads_set(1);
+        std::unique_ptr<RopeNode> serial = rope_map_file(path);
+        rope_build_threads_set(4);
+        std::unique_ptr<RopeNode> parallel = rope_map_file(path);
+        std::remove(path);
+        REQUIRE( rope_line_count(*parallel) == rope_line_count(*serial) );
+        REQUIRE( same_tree(*serial, *parallel) );
+        rope_destroy(std::move(serial));
+        rope_destroy(std::move(parallel));
+    }
+
+    rope_build_threads_set(threads);
+}
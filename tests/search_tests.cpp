@@ -0,0 +1,79 @@
+#include <catch2/catch_test_macros.hpp>
+#include <search.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+
+
+/*
+    matches in a plain string, as codepoint indices
+*/
+std::vector<size_t> search_shadow_find_all(const std::string &text, const std::string &needle){
+    std::vector<size_t> matches;
+    for(size_t p = text.find(needle);p != std::string::npos;p = text.find(needle, p + needle.size()))
+        matches.push_back(ustrlen(text.substr(0, p)));
+    return matches;
+}
+
+
+TEST_CASE( "Rope is searched", "[rope_find]" ) {
+    std::unique_ptr<RopeNode> rope = rope_create("");
+    for(const char *piece : {"some ", "te", "x", "t over ", "čć", "ž lea", "ves, some text"})
+        rope_append(rope.get(), rope_create_node(piece));
+
+    SECTION("matches inside and across leaves"){
+        REQUIRE( rope_find(*rope, 0, "some") == 0 );
+        REQUIRE( rope_find(*rope, 1, "some") == 27 );
+        REQUIRE( rope_find(*rope, 0, "text") == 5 );
+        REQUIRE( rope_find(*rope, 0, "ćž le") == 16 );
+        REQUIRE( rope_find(*rope, 0, "missing") == SEARCH_NOT_FOUND );
+        REQUIRE( rope_find(*rope, 100, "some") == SEARCH_NOT_FOUND );
+    }
+
+    SECTION("all matches, ready for flags"){
+        std::vector<size_t> matches = rope_find_all(*rope, "text");
+        REQUIRE( matches == std::vector<size_t>{5, 32} );
+        for(size_t index : matches)
+            rope_insert_flag_at(rope.get(), index, 4, FLAG_INVERT);
+        size_t local_index;
+        REQUIRE( has_flags(&rope_node_at_index(*rope, 7, &local_index)->flags, FLAG_INVERT) );
+        REQUIRE_FALSE( has_flags(&rope_node_at_index(*rope, 9, &local_index)->flags, FLAG_INVERT) );
+    }
+
+    SECTION("limit stops the scan"){
+        std::vector<size_t> matches;
+        REQUIRE( rope_find_all(*rope, 0, "e", 2, matches) == 2 );
+        REQUIRE( matches == std::vector<size_t>{3, 6} );
+    }
+}
+
+TEST_CASE( "Rope search matches a flat string", "[rope_find_all]" ) {
+    std::mt19937 random(11);
+    const std::vector<std::string> alphabet = {"a", "b", "ab", "č", "字", "\n"};
+    for(size_t round=0;round<200;round++){
+        std::unique_ptr<RopeNode> rope = rope_create("");
+        std::string text;
+        size_t leaves = 1 + random() % 60;
+        for(size_t l=0;l<leaves;l++){
+            std::string piece;
+            size_t length = 1 + random() % (round % 3 == 0 ? 200 : 4);
+            for(size_t i=0;i<length;i++)
+                piece += alphabet[random() % alphabet.size()];
+            rope_append(rope.get(), rope_create_node(piece.c_str()));
+            text += piece;
+        }
+        std::string needle;
+        size_t length = 1 + random() % 6;
+        for(size_t i=0;i<length;i++)
+            needle += alphabet[random() % (alphabet.size() - 1)];
+
+        std::vector<size_t> expected = search_shadow_find_all(text, needle);
+        REQUIRE( rope_find_all(*rope, needle.c_str()) == expected );
+        if(!expected.empty()){
+            REQUIRE( rope_find(*rope, expected.back(), needle.c_str()) == expected.back() );
+            REQUIRE( rope_find(*rope, expected.back() + ustrlen(needle), needle.c_str()) == SEARCH_NOT_FOUND );
+        }
+    }
+}
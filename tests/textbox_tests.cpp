@@ -0,0 +1,92 @@
+#include <catch2/catch_test_macros.hpp>
+#include <widget.h>
+
+#include <string>
+
+
+using termija::TextBox;
+
+TEST_CASE( "TextBox batch is applied at commit", "[TextBox::commit]" ) {
+    TextBox box(0, 0, 40, 10);
+    box.insertAtCursor("some text");
+    box.addAttributeAtRange(5, 4, FLAG_INVERT);
+    box.cursorWalkLeft(9);
+    REQUIRE( box.getCurrentIndex() == 0 );
+    REQUIRE( box.getNumberOfLines() == 1 );
+
+    SECTION("cursor, lines and attributes are updated once"){
+        box.beginBatch();
+        box.insertLineAtCursor("first");
+        box.beginBatch();
+        box.insertAtCursor("ab");
+        box.commit();
+        //still in the outer batch, nothing is updated yet
+        REQUIRE( box.isInBatch() );
+        REQUIRE( box.getNumberOfLines() == 1 );
+        REQUIRE( box.getAttributeAt(5) == FLAG_INVERT );
+        box.commit();
+
+        REQUIRE_FALSE( box.isInBatch() );
+        REQUIRE( box.getText() == "firstabsome text" );
+        REQUIRE( box.getCurrentIndex() == 7 );
+        REQUIRE( box.getCursorPosition() == std::pair<uint16_t, uint16_t>(2, 1) );
+        REQUIRE( box.getNumberOfLines() == 2 );
+        REQUIRE( box.getAttributeAt(11) == 0 );
+        for(size_t i=12;i<16;i++)
+            REQUIRE( box.getAttributeAt(i) == FLAG_INVERT );
+    }
+
+    SECTION("deletes in a batch end where unbatched ones do"){
+        TextBox plain(0, 0, 40, 10);
+        plain.insertAtCursor("some text");
+        plain.addAttributeAtRange(5, 4, FLAG_INVERT);
+        plain.cursorWalkLeft(5);
+        plain.deleteAtCursor();
+        plain.backspaceAtCursor();
+        plain.backspaceAtCursor();
+
+        box.cursorWalkRight(4);
+        box.beginBatch();
+        box.deleteAtCursor();
+        box.backspaceAtCursor();
+        box.backspaceAtCursor();
+        box.commit();
+
+        REQUIRE( box.getText() == plain.getText() );
+        REQUIRE( box.getTextLength() == 6 );
+        REQUIRE( box.getCurrentIndex() == plain.getCurrentIndex() );
+        REQUIRE( box.getCursorPosition() == plain.getCursorPosition() );
+        REQUIRE( box.getNumberOfLines() == plain.getNumberOfLines() );
+        for(size_t i=0;i<box.getTextLength();i++)
+            REQUIRE( box.getAttributeAt(i) == plain.getAttributeAt(i) );
+    }
+
+    SECTION("batch is undone as one"){
+        box.beginBatch();
+        box.insertLineAtCursor("first");
+        box.insertAtCursor("ab");
+        box.commit();
+
+        REQUIRE( box.undo() );
+        REQUIRE( box.getText() == "some text" );
+        REQUIRE( box.getNumberOfLines() == 1 );
+        REQUIRE( box.getAttributeAt(5) == FLAG_INVERT );
+        REQUIRE( box.redo() );
+        REQUIRE( box.getText() == "firstabsome text" );
+        REQUIRE( box.getAttributeAt(12) == FLAG_INVERT );
+    }
+
+    SECTION("undo inside a batch"){
+        box.cursorWalkRight(9);
+        box.insertAtCursor("P");
+        box.beginBatch();
+        box.insertAtCursor("A");
+        REQUIRE( box.undo() );
+        box.insertAtCursor("B");
+        box.commit();
+        REQUIRE( box.getText() == "some textPB" );
+
+        REQUIRE( box.undo() );
+        REQUIRE( box.getText() == "some textP" );
+    }
+}
@@ -0,0 +1,60 @@
+#include <catch2/catch_test_macros.hpp>
+#include <utf8.h>
+#include <rope.h>
+
+#include <string>
+#include <vector>
+#include <random>
+
+
+/*
+    mixes one to four byte sequences and the odd stray continuation byte
+*/
+std::string utf8_random_text(std::mt19937 &random, size_t codepoints){
+    const std::vector<std::string> pieces = {"a", "Z", " ", "\n", "č", "ž", "Ђ", "€", "漢", "😀", "\x80"};
+    std::string text;
+    for(size_t i=0;i<codepoints;i++)
+        text += pieces[random() % pieces.size()];
+    return text;
+}
+
+
+TEST_CASE( "UTF-8 kernels agree with scalar", "[u_count]" ) {
+    std::mt19937 random(11);
+    std::vector<UKernel> kernels = u_kernels_available();
+
+    REQUIRE( kernels.front().count == u_count_scalar );
+
+    SECTION("counting every length and alignment"){
+        const std::string text = utf8_random_text(random, 700);
+        for(size_t start=0;start<40;start++){
+            for(size_t length=0;start+length<=text.size();length+=(length < 100 ? 1 : 37)){
+                size_t expected = u_count_scalar(text.c_str() + start, length);
+                for(const UKernel &kernel : kernels)
+                    REQUIRE( kernel.count(text.c_str() + start, length) == expected );
+            }
+        }
+    }
+
+    SECTION("offset of every codepoint and past the end"){
+        const std::string text = utf8_random_text(random, 500);
+        size_t codepoints = u_count_scalar(text.c_str(), text.size());
+        for(size_t start : {0, 1, 3, 17}){
+            for(size_t index=0;index<=codepoints+2;index++){
+                size_t expected = u_offset_scalar(text.c_str() + start, text.size() - start, index);
+                for(const UKernel &kernel : kernels)
+                    REQUIRE( kernel.offset(text.c_str() + start, text.size() - start, index) == expected );
+            }
+        }
+    }
+
+    SECTION("ustrlen and u_index_at use the dispatched kernel"){
+        REQUIRE( ustrlen("") == 0 );
+        REQUIRE( ustrlen("čšćžđ some text 漢字") == 18 );
+        REQUIRE( u_index_at("čšćžđ some text 漢字", 5) == 10 );
+        REQUIRE( u_index_at("čšćžđ some text 漢字", 17) == 24 );
+        REQUIRE( u_index_at("čšćžđ", 10) == 10 );
+        //never ends on a continuation byte
+        REQUIRE( u_index_at("\x80\x80" "a", 0) == 2 );
+    }
+}